@@ -30,16 +30,120 @@ def freeable(struct):
 MARSH_DECLARE = "static uint32_t marshal_{0}(const {0} *obj, uint8_t *buf)"
 UNMARSH_DECLARE = "static uint32_t unmarshal_{0}(const uint8_t *buf, {0} *obj)"
 FREE_DECLARE = "static void free_{0}({0} *obj)"
+SIZE_DECLARE = "static uint32_t serialized_size_{0}(const {0} *obj)"
+CHECKED_DECLARE = "static uint32_t marshal_{0}_checked(const {0} *obj, uint8_t *buf, size_t buf_size)"
 
 MARSHAL_CALL = "tail += marshal_{0}({1}, tail);"
 UNMARSHAL_CALL = "head += unmarshal_{0}(head, {1});"
+MARSHAL_ARRAY_CALL = "tail += marshal_array({0}, {1}, tail);"
+UNMARSHAL_ARRAY_CALL = "head += unmarshal_array(head, {0}, {1});"
+MARSHAL_PACKED_ARRAY_CALL = "if (uint32_t packed = marshal_packed_array({0}, {1}, tail)) {{"
+UNMARSHAL_PACKED_ARRAY_CALL = "if (uint32_t packed = unmarshal_packed_array(head, {0}, {1})) {{"
+
+def bulk_copyable(type):
+    # arrays of generated primitives are copied at once, see prolog
+    return type.__module__ == "primitives"
+
+def embeds_structs(struct):
+    # the RPC structs refer to other structs by pointer
+    name = struct.__name__
+    return not (name.startswith("mcd_rpc_") or name.endswith(("_args", "_result")))
+
+def flat(struct):
+    # structs of primitives only can have the layout of their wire format
+    if struct.__module__ != "structs":
+        return bulk_copyable(struct)
+    for f in dataclasses.fields(struct):
+        mod = f.default
+        if mod.optional or mod.fixedLen or mod.varLen:
+            return False
+        if f.type.__module__ == "structs" and not embeds_structs(struct):
+            return False
+        if not flat(f.type):
+            return False
+    return True
+
+def wire_members(struct, prefix=""):
+    for f in dataclasses.fields(struct):
+        mod = f.default
+        name = prefix + (mod.rename if mod.rename else f.name)
+        if f.type.__module__ == "structs":
+            yield from wire_members(f.type, name + ".")
+        else:
+            yield name
+
+def layout_define(struct):
+    type = struct.__name__
+    fields = ", ".join(f"WIRE_FIELD({type}, {m})" for m in wire_members(struct))
+    print(f"DEFINE_WIRE_LAYOUT({type}, {fields})")
 
 def print_indent(indent, s):
     print(f"{' ' * indent}{s}")
 
 def prolog(structs):
-    print ("""#define DEFINE_PRIMITIVE(type) \\
-static int marshal_##type (type obj, uint8_t *buf) \\
+    print ("""/*
+ * Integers wider than a byte are sent at full width, or as unsigned LEB128
+ * varints once the compact encoding has been negotiated: the client offers it
+ * with encoding=varint in the config string of mcd_open_server and the server
+ * accepts by echoing the key in the config string of its response, which is
+ * still sent at full width. The frame header is never compacted.
+ */
+static bool compact_encoding = false;
+
+static int marshal_varint(uint64_t value, uint8_t *buf)
+{
+    int n = 0;
+    while (value >= 0x80) {
+        buf[n++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    buf[n++] = (uint8_t) value;
+    return n;
+}
+
+static int unmarshal_varint(const uint8_t *buf, uint64_t *value)
+{
+    uint64_t v = 0;
+    int n = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t b = buf[n++];
+        v |= (uint64_t) (b & 0x7f) << shift;
+        if (!(b & 0x80)) break;
+    }
+    *value = v;
+    return n;
+}
+
+static uint32_t encoded_size(size_t bytes)
+{
+    if (!compact_encoding || bytes == 1) return (uint32_t) bytes;
+    return (uint32_t) ((8 * bytes + 6) / 7);
+}
+
+template <typename T>
+using WireUint = std::conditional_t<sizeof(T) == 8, uint64_t,
+                 std::conditional_t<sizeof(T) == 4, uint32_t, uint16_t>>;
+
+template <typename T>
+static int marshal_varint_as(T obj, uint8_t *buf)
+{
+    WireUint<T> value;
+    memcpy(&value, &obj, sizeof(value));
+    return marshal_varint(value, buf);
+}
+
+template <typename T>
+static int unmarshal_varint_as(const uint8_t *buf, T *obj)
+{
+    uint64_t v;
+    int n = unmarshal_varint(buf, &v);
+    WireUint<T> value = (WireUint<T>) v;
+    memcpy(obj, &value, sizeof(value));
+    return n;
+}
+
+#define DEFINE_PRIMITIVE(type) \\
+static int marshal_fixed_##type (type obj, uint8_t *buf) \\
 { \\
     const int BYTES = sizeof(type); \\
     if (HOST_BIG_ENDIAN && BYTES > 1) \\
@@ -48,7 +152,7 @@ static int marshal_##type (type obj, uint8_t *buf) \\
     else *(type *)buf = obj; \\
     return BYTES; \\
 } \\
-static int unmarshal_##type (const uint8_t *buf, type *obj) \\
+static int unmarshal_fixed_##type (const uint8_t *buf, type *obj) \\
 { \\
     const int BYTES = sizeof(type); \\
     if (HOST_BIG_ENDIAN && BYTES > 1) \\
@@ -56,6 +160,163 @@ static int unmarshal_##type (const uint8_t *buf, type *obj) \\
             ((uint8_t *)obj)[i] = buf[BYTES-i-1]; \\
     else *obj = *(const type *)buf; \\
     return BYTES; \\
+} \\
+static int marshal_##type (type obj, uint8_t *buf) \\
+{ \\
+    if constexpr (sizeof(type) > 1) \\
+        if (compact_encoding) return marshal_varint_as(obj, buf); \\
+    return marshal_fixed_##type(obj, buf); \\
+} \\
+static int unmarshal_##type (const uint8_t *buf, type *obj) \\
+{ \\
+    if constexpr (sizeof(type) > 1) \\
+        if (compact_encoding) return unmarshal_varint_as(buf, obj); \\
+    return unmarshal_fixed_##type(buf, obj); \\
+}
+
+template <typename T>
+static uint32_t marshal_array(const T *obj, uint32_t len, uint8_t *buf)
+{
+    if constexpr (sizeof(T) > 1) {
+        if (compact_encoding) {
+            uint8_t *tail = buf;
+            for (uint32_t i = 0; i < len; i++)
+                tail += marshal_varint_as(obj[i], tail);
+            return (uint32_t) (tail - buf);
+        }
+    }
+    const uint32_t bytes = len * (uint32_t) sizeof(T);
+    if constexpr (HOST_BIG_ENDIAN && sizeof(T) > 1) {
+        const uint8_t *src = (const uint8_t *) obj;
+        for (uint32_t i = 0; i < bytes; i += sizeof(T))
+            for (uint32_t b = 0; b < sizeof(T); b++)
+                buf[i + b] = src[i + sizeof(T) - 1 - b];
+    } else if (bytes > 0) {
+        memcpy(buf, obj, bytes);
+    }
+    return bytes;
+}
+
+template <typename T>
+static uint32_t unmarshal_array(const uint8_t *buf, T *obj, uint32_t len)
+{
+    if constexpr (sizeof(T) > 1) {
+        if (compact_encoding) {
+            const uint8_t *head = buf;
+            for (uint32_t i = 0; i < len; i++)
+                head += unmarshal_varint_as(head, obj + i);
+            return (uint32_t) (head - buf);
+        }
+    }
+    const uint32_t bytes = len * (uint32_t) sizeof(T);
+    if constexpr (HOST_BIG_ENDIAN && sizeof(T) > 1) {
+        uint8_t *dst = (uint8_t *) obj;
+        for (uint32_t i = 0; i < bytes; i += sizeof(T))
+            for (uint32_t b = 0; b < sizeof(T); b++)
+                dst[i + b] = buf[i + sizeof(T) - 1 - b];
+    } else if (bytes > 0) {
+        memcpy(obj, buf, bytes);
+    }
+    return bytes;
+}
+
+/*
+ * Structs of primitives are described by the offset and size of their fields
+ * in wire order. Without padding between the fields, the struct is copied as
+ * a whole on little-endian hosts. Arrays additionally require that there is
+ * no padding at the end of the struct.
+ */
+struct WireField {
+    size_t offset;
+    size_t size;
+};
+
+template <size_t N>
+static constexpr uint32_t wire_size(const WireField (&fields)[N])
+{
+    size_t size = 0;
+    for (const WireField &f : fields) size += f.size;
+    return (uint32_t) size;
+}
+
+template <size_t N>
+static constexpr bool wire_packed(const WireField (&fields)[N])
+{
+    size_t offset = 0;
+    for (const WireField &f : fields) {
+        if (f.offset != offset) return false;
+        offset += f.size;
+    }
+    return true;
+}
+
+template <typename T>
+struct WireLayout {
+    static constexpr bool PACKED = false;
+    static constexpr bool ARRAY_PACKED = false;
+};
+
+#define WIRE_FIELD(type, member) \\
+    WireField { offsetof(type, member), sizeof(((type *)0)->member) }
+
+#define DEFINE_WIRE_LAYOUT(type, ...) \\
+template <> \\
+struct WireLayout<type> { \\
+    static constexpr WireField FIELDS[] = {__VA_ARGS__}; \\
+    static constexpr uint32_t SIZE = wire_size(FIELDS); \\
+    static constexpr bool PACKED = !HOST_BIG_ENDIAN && wire_packed(FIELDS); \\
+    static constexpr bool ARRAY_PACKED = PACKED && sizeof(type) == SIZE; \\
+};
+
+/* return 0 if the struct has to be (un)marshalled field-wise */
+template <typename T>
+static uint32_t marshal_packed(const T *obj, uint8_t *buf)
+{
+    if constexpr (WireLayout<T>::PACKED) {
+        if (!compact_encoding) {
+            memcpy(buf, obj, WireLayout<T>::SIZE);
+            return WireLayout<T>::SIZE;
+        }
+    }
+    return 0;
+}
+
+template <typename T>
+static uint32_t unmarshal_packed(const uint8_t *buf, T *obj)
+{
+    if constexpr (WireLayout<T>::PACKED) {
+        if (!compact_encoding) {
+            memcpy(obj, buf, WireLayout<T>::SIZE);
+            return WireLayout<T>::SIZE;
+        }
+    }
+    return 0;
+}
+
+template <typename T>
+static uint32_t marshal_packed_array(const T *obj, uint32_t len, uint8_t *buf)
+{
+    if constexpr (WireLayout<T>::ARRAY_PACKED) {
+        if (!compact_encoding) {
+            const uint32_t bytes = len * WireLayout<T>::SIZE;
+            if (bytes > 0) memcpy(buf, obj, bytes);
+            return bytes;
+        }
+    }
+    return 0;
+}
+
+template <typename T>
+static uint32_t unmarshal_packed_array(const uint8_t *buf, T *obj, uint32_t len)
+{
+    if constexpr (WireLayout<T>::ARRAY_PACKED) {
+        if (!compact_encoding) {
+            const uint32_t bytes = len * WireLayout<T>::SIZE;
+            if (bytes > 0) memcpy(obj, buf, bytes);
+            return bytes;
+        }
+    }
+    return 0;
 }
 """)
 
@@ -72,6 +333,11 @@ def marsh_define(struct):
     print_indent(indent, MARSH_DECLARE.format(struct.__name__))
     print_indent(indent, '{')
     indent += 4
+    if flat(struct):
+        print_indent(indent, "if (uint32_t packed = marshal_packed(obj, buf)) {")
+        print_indent(indent + 4, "return packed;")
+        print_indent(indent, "}")
+        print()
     print_indent(indent, "uint8_t *tail = buf;")
     print()
 
@@ -86,34 +352,104 @@ def marsh_define(struct):
             print_indent(indent, f"if ({mod.optional}) {{")
             indent += 4
 
-        if mod.fixedLen:
-            print_indent(indent, MARSHAL_CALL.format("uint32_t", f"(uint32_t) {mod.fixedLen}"))
-            print_indent(indent, f"for (uint32_t i = 0; i < (uint32_t) {mod.fixedLen}; i++) {{")
-            indent += 4
-        elif mod.varLen:
-            print_indent(indent, MARSHAL_CALL.format("uint32_t", f"(uint32_t) {mod.varLen}"))
-            print_indent(indent, f"for (uint32_t i = 0; i < (uint32_t) {mod.varLen}; i++) {{")
-            indent += 4
+        length = mod.fixedLen or mod.varLen
+        bulk = length and bulk_copyable(f.type)
 
-        if mod.fixedLen or mod.varLen:
-            print_indent(indent, MARSHAL_CALL.format(type, f"obj->{name}{'[i]' if isprimitive else ' + i'}"))
+        if length:
+            print_indent(indent, MARSHAL_CALL.format("uint32_t", f"(uint32_t) {length}"))
+
+        if bulk:
+            print_indent(indent, MARSHAL_ARRAY_CALL.format(f"obj->{name}", f"(uint32_t) {length}"))
+        elif length and flat(f.type):
+            print_indent(indent, MARSHAL_PACKED_ARRAY_CALL.format(f"obj->{name}", f"(uint32_t) {length}"))
+            print_indent(indent + 4, "tail += packed;")
+            print_indent(indent, "} else {")
+            print_indent(indent + 4, f"for (uint32_t i = 0; i < (uint32_t) {length}; i++) {{")
+            print_indent(indent + 8, MARSHAL_CALL.format(type, f"obj->{name} + i"))
+            print_indent(indent + 4, "}")
+            print_indent(indent, "}")
+        elif length:
+            print_indent(indent, f"for (uint32_t i = 0; i < (uint32_t) {length}; i++) {{")
+            print_indent(indent + 4, MARSHAL_CALL.format(type, f"obj->{name}{'[i]' if isprimitive else ' + i'}"))
+            print_indent(indent, "}")
         else:
             print_indent(indent, MARSHAL_CALL.format(type, f"{'' if isprimitive else '&'}obj->{name}"))
 
-        if mod.fixedLen or mod.varLen:
+        if mod.optional:
             indent -= 4
             print_indent(indent, "}")
 
+        print()
+    print_indent(indent, "return (uint32_t) (tail - buf);")
+    indent -= 4
+    print_indent(indent, '}')
+    print()
+
+def wire_size(type):
+    # mcd_bool_t is transmitted as a single byte, integers at most at full width
+    return "sizeof(uint8_t)" if type.__name__ == "mcd_bool_t" else f"encoded_size(sizeof({type.__name__}))"
+
+def size_define(struct):
+    indent = 0
+    fields = [f for f in dataclasses.fields(struct)]
+    print_indent(indent, SIZE_DECLARE.format(struct.__name__))
+    print_indent(indent, '{')
+    indent += 4
+    print_indent(indent, "uint32_t size = 0;")
+    print()
+
+    for f in fields:
+        mod = f.default
+        name = mod.rename if mod.rename else f.name
+        type = f.type.__name__
+        isprimitive = "primitive" in f.type.__module__
+
+        if mod.optional:
+            print_indent(indent, "size += sizeof(uint8_t);")
+            print_indent(indent, f"if ({mod.optional}) {{")
+            indent += 4
+
+        length = mod.fixedLen or mod.varLen
+
+        if length:
+            print_indent(indent, "size += encoded_size(sizeof(uint32_t));")
+
+        if length and isprimitive:
+            print_indent(indent, f"size += (uint32_t) {length} * {wire_size(f.type)};")
+        elif length:
+            print_indent(indent, f"for (uint32_t i = 0; i < (uint32_t) {length}; i++) {{")
+            print_indent(indent + 4, f"size += serialized_size_{type}(obj->{name} + i);")
+            print_indent(indent, "}")
+        elif isprimitive:
+            print_indent(indent, f"size += {wire_size(f.type)};")
+        else:
+            print_indent(indent, f"size += serialized_size_{type}(&obj->{name});")
+
         if mod.optional:
             indent -= 4
             print_indent(indent, "}")
 
         print()
-    print_indent(indent, "return (uint32_t) (tail - buf);")
+    print_indent(indent, "return size;")
     indent -= 4
     print_indent(indent, '}')
     print()
 
+def checked_define(struct):
+    # the marshal functions of whole messages report an overflow with 0
+    name = struct.__name__
+    print(CHECKED_DECLARE.format(name))
+    print('{')
+    print_indent(4, f"if (serialized_size_{name}(obj) > buf_size) {{")
+    print_indent(8, "return 0;")
+    print_indent(4, "}")
+    print_indent(4, f"return marshal_{name}(obj, buf);")
+    print('}')
+    print()
+
+def message(struct):
+    return struct.__name__.endswith(("_args", "_result"))
+
 def unmarsh_define(struct):
     indent = 0
     fields = [f for f in dataclasses.fields(struct)]
@@ -121,6 +457,11 @@ def unmarsh_define(struct):
     print_indent(indent, UNMARSH_DECLARE.format(struct.__name__))
     print_indent(indent, '{')
     indent += 4
+    if flat(struct):
+        print_indent(indent, "if (uint32_t packed = unmarshal_packed(buf, obj)) {")
+        print_indent(indent + 4, "return packed;")
+        print_indent(indent, "}")
+        print()
     print_indent(indent, "const uint8_t *head = buf;")
     print()
 
@@ -155,7 +496,21 @@ def unmarsh_define(struct):
             print()
 
 
-        if mod.fixedLen or mod.varLen:
+        if (mod.fixedLen or mod.varLen) and bulk_copyable(f.type):
+            print_indent(indent, UNMARSHAL_ARRAY_CALL.format(f"obj->{name}", "len"))
+            indent -= 4
+            print_indent(indent, "}")
+        elif (mod.fixedLen or mod.varLen) and flat(f.type):
+            print_indent(indent, UNMARSHAL_PACKED_ARRAY_CALL.format(f"obj->{name}", "len"))
+            print_indent(indent + 4, "head += packed;")
+            print_indent(indent, "} else {")
+            print_indent(indent + 4, f"for (uint32_t i = 0; i < len; i++) {{")
+            print_indent(indent + 8, UNMARSHAL_CALL.format(type, f"obj->{name} + i"))
+            print_indent(indent + 4, "}")
+            print_indent(indent, "}")
+            indent -= 4
+            print_indent(indent, "}")
+        elif mod.fixedLen or mod.varLen:
             print_indent(indent, f"for (uint32_t i = 0; i < len; i++) {{")
             print_indent(indent+4, UNMARSHAL_CALL.format(type, f"obj->{name} + i"))
             print_indent(indent, "}")
@@ -229,14 +584,24 @@ def generate(structs):
     for struct in structs:
         print(MARSH_DECLARE.format(struct.__name__) + ";")
         print(UNMARSH_DECLARE.format(struct.__name__) + ";")
+        print(SIZE_DECLARE.format(struct.__name__) + ";")
+        if message(struct):
+            print(CHECKED_DECLARE.format(struct.__name__) + ";")
         if (freeable(struct)):
             print(FREE_DECLARE.format(struct.__name__) + ";")
         print()
 
+    for struct in structs:
+        if flat(struct):
+            layout_define(struct)
+    print()
 
     for struct in structs:
         marsh_define(struct)
         unmarsh_define(struct)
+        size_define(struct)
+        if message(struct):
+            checked_define(struct)
         if freeable(struct):
             free_define(struct)
 
@@ -0,0 +1,173 @@
+import dataclasses
+import re
+import structs
+from main import embeds_structs, print_indent
+
+# The QMP commands the client sends, the arguments are printed as objects
+QMP_COMMANDS = [
+    "mcd_open_server",
+    "mcd_close_server",
+    "mcd_qry_systems",
+    "mcd_qry_devices",
+    "mcd_qry_cores",
+    "mcd_open_core",
+    "mcd_close_core",
+    "mcd_qry_error_info",
+    "mcd_qry_mem_spaces",
+    "mcd_qry_reg_groups",
+    "mcd_qry_reg_map",
+    "mcd_execute_txlist",
+    "mcd_qry_trig_info",
+    "mcd_qry_ctrigs",
+    "mcd_create_trig",
+    "mcd_qry_trig",
+    "mcd_remove_trig",
+    "mcd_qry_trig_state",
+    "mcd_activate_trig_set",
+    "mcd_remove_trig_set",
+    "mcd_qry_trig_set",
+    "mcd_qry_trig_set_state",
+    "mcd_run",
+    "mcd_stop",
+    "mcd_step",
+    "mcd_set_global",
+    "mcd_qry_state",
+    "mcd_qry_rst_classes",
+    "mcd_qry_rst_class_info",
+    "mcd_rst",
+]
+
+# Variants of the mcd_rpc_* choices which the client implements, the first
+# present one is sent
+VARIANTS = {
+    "mcd_rpc_trig_st": ["simple_core", "complex_core"],
+}
+
+# QEMU fills in the struct sizes itself
+OMITTED = {"struct_size"}
+
+EMIT_DECLARE = "static void emit_{0}("
+EMIT_PARAMS = ["Writer &w", "const {0} *obj)"]
+
+def declare(struct):
+    # wrapped like clang-format does
+    print("template <typename Writer>")
+    head = EMIT_DECLARE.format(struct.__name__)
+    params = [p.format(struct.__name__) for p in EMIT_PARAMS]
+    if len(head) + len(", ".join(params)) <= 80:
+        print(head + ", ".join(params))
+    elif len(head) + len(max(params, key=len)) + 1 <= 80:
+        print(head + params[0] + ",")
+        print_indent(len(head), params[1])
+    else:
+        print(head)
+        print_indent(4, ", ".join(params))
+
+def key(name):
+    return name.replace("_", "-")
+
+def c_name(f):
+    mod = f.default
+    return mod.rename if mod.rename else f.name
+
+def variant_key(type):
+    # mcd_trig_simple_core_st -> trig-simple-core
+    return key(type.__name__.removeprefix("mcd_").removesuffix("_st"))
+
+def is_struct(type):
+    return type.__module__ == "structs"
+
+def members(struct):
+    # JSON carries lengths and presence implicitly
+    fields = dataclasses.fields(struct)
+    arrays = {f.name for f in fields if f.default.varLen}
+    flags = set()
+    for f in fields:
+        if f.default.optional:
+            flags.update(re.findall(r"obj->(\w+)", f.default.optional))
+    for f in fields:
+        if f.name in OMITTED or f.name in flags:
+            continue
+        if f.name.endswith("_len") and f.name.removesuffix("_len") in arrays:
+            continue
+        yield f
+
+def dependencies(struct, found):
+    # every struct is defined before its first use
+    fields = dataclasses.fields(struct)
+    if struct.__name__ in VARIANTS:
+        fields = [f for f in fields if f.name in VARIANTS[struct.__name__]]
+    for f in fields:
+        if is_struct(f.type) and f.type not in found:
+            dependencies(f.type, found)
+    if struct not in found:
+        found.append(struct)
+
+def variant_define(struct):
+    name = struct.__name__
+    fields = {f.name: f for f in dataclasses.fields(struct)}
+    print_indent(4, "/* a choice is an object with the present variant */")
+    for i, v in enumerate(VARIANTS[name]):
+        f = fields[v]
+        print_indent(4, f"{'if' if i == 0 else '} else if'} (obj->is_{v}) {{")
+        print_indent(8, "w.begin_object(1);")
+        print_indent(8, f'w.key("{variant_key(f.type)}");')
+        print_indent(8, f"emit_{f.type.__name__}(w, obj->{v});")
+        print_indent(8, "w.end_object();")
+    print_indent(4, "} else {")
+    print_indent(8, "w.null();")
+    print_indent(4, "}")
+
+def member_define(struct, f):
+    mod = f.default
+    name = c_name(f)
+    type = f.type.__name__
+    length = mod.fixedLen or mod.varLen
+    # the args and mcd_rpc_* structs refer to other structs by pointer
+    ref = f"&obj->{name}" if embeds_structs(struct) else f"obj->{name}"
+
+    if type == "mcd_char_t":
+        print_indent(4, f"w.string(obj->{name});")
+    elif type == "mcd_bool_t":
+        print_indent(4, f"w.boolean(obj->{name});")
+    elif type == "uint8_t" and mod.varLen:
+        print_indent(4, f"w.bytes(obj->{name}, {length});")
+    elif length and not is_struct(f.type):
+        print_indent(4, f"w.array(obj->{name}, {length});")
+    elif length:
+        print_indent(4, f"w.begin_array({length});")
+        print_indent(4, f"for (uint32_t i{{0}}; i < {length}; i++) {{")
+        print_indent(8, f"emit_{type}(w, obj->{name} + i);")
+        print_indent(4, "}")
+        print_indent(4, "w.end_array();")
+    elif is_struct(f.type):
+        print_indent(4, f"emit_{type}(w, {ref});")
+    else:
+        print_indent(4, f"w.number(obj->{name});")
+
+def emit_define(struct):
+    declare(struct)
+    print("{")
+    if struct.__name__ in VARIANTS:
+        variant_define(struct)
+    else:
+        # nlohmann::json sorts the keys of objects, so do we
+        fields = sorted(members(struct), key=lambda f: key(c_name(f)))
+        print_indent(4, f"w.begin_object({len(fields)});")
+        for f in fields:
+            print_indent(4, f'w.key("{key(c_name(f))}");')
+            member_define(struct, f)
+        print_indent(4, "w.end_object();")
+    print("}")
+    print()
+
+def generate():
+    found = []
+    for command in QMP_COMMANDS:
+        dependencies(getattr(structs, command + "_args"), found)
+
+    for struct in found:
+        emit_define(struct)
+
+if __name__ == "__main__":
+    generate()
@@ -24,8 +24,14 @@ SOFTWARE.
 
 #pragma once
 
+#include <atomic>
 #include <optional>
 #include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 #include "mcd_api.h"
 
@@ -72,6 +78,9 @@ public:
 
     void grant_server_access(const mcd_core_st *core);
 
+    /* Indicates whether yield_server_request issues transactions on its own */
+    bool accesses_server() const;
+
     /* Allocates memory. The memory is owned be the caller */
     /* requires callback function for any additional transactions */
     /* might throw a mcd*/
@@ -138,6 +147,330 @@ struct RegGroup {
     }
 };
 
+/** \brief Values of a core which stay valid while the core is halted.
+ *
+ * Debuggers re-read the same registers and memory after every stop. While
+ * the core is halted, only the client changes them, so repeated reads are
+ * answered without a round trip to the server.
+ *
+ * A cache becomes valid when mcd_qry_state_f reports the core as halted. It
+ * is invalidated before the core executes, i.e. on run, step and reset.
+ * Requests affecting all cores invalidate the caches of all cores by
+ * advancing a common epoch.
+ *
+ * A read which misses the cache obtains a ticket. Its response is only stored
+ * if the values have not been dropped in the meantime, e.g. by a write which
+ * has been submitted after the read.
+ */
+class TargetCache
+{
+    /* the core has been reported halted in halted_epoch */
+    bool halted;
+    uint64_t halted_epoch;
+
+    static std::atomic<uint64_t> epoch;
+    /* tickets are unique among all caches */
+    static std::atomic<uint64_t> versions;
+
+protected:
+    /* advanced whenever the values are dropped */
+    uint64_t version;
+
+    bool valid() const;
+    void drop_values();
+    void expire_tickets();
+    virtual void clear_values() = 0;
+
+public:
+    /** \brief Number of reads answered from the cache. */
+    uint64_t hits;
+
+    /** \brief Number of cacheable reads sent to the server. */
+    uint64_t misses;
+
+    TargetCache();
+    virtual ~TargetCache() = default;
+
+    /** \brief Returns the epoch to pass to \c set_halted. */
+    static uint64_t current_epoch();
+
+    /** \brief Invalidates the caches of all cores. */
+    static void invalidate_all();
+
+    /** \brief Validates the cache once the core has been reported halted.
+     *
+     * @param since Epoch before the core state was queried. If any core might
+     *              have executed since, the cache stays invalid.
+     */
+    void set_halted(uint64_t since);
+
+    /** \brief Invalidates the cache before the core executes. */
+    void invalidate();
+};
+
+/** \brief Caches the register values of a core.
+ *
+ * The values are dropped on any write to the register memory spaces since
+ * registers might alias each other.
+ */
+class RegisterCache : public TargetCache
+{
+    struct Entry {
+        uint32_t num_bytes;
+        bool valid;
+        std::vector<uint8_t> value;
+    };
+
+    /* cacheable registers by memory space ID and address */
+    std::map<std::pair<uint32_t, uint64_t>, Entry> entries;
+
+    Entry *find(const mcd_tx_st &tx);
+    void clear_values() override;
+
+public:
+    /** \brief Replaces the cacheable registers.
+     *
+     * Registers whose reads have side effects are always read from the server.
+     */
+    void set_registers(const std::vector<mcd_register_info_st> &registers);
+
+    /** \brief Answers a read transaction from the cache.
+     *
+     * @param tx Client transaction, completed on a hit.
+     * @param ticket Nonzero on a miss if the response can be cached by
+     *               \c fill.
+     * @return Whether the transaction has been completed.
+     */
+    bool read(mcd_tx_st &tx, uint64_t &ticket);
+
+    /** \brief Stores the response to a read which missed the cache. */
+    void fill(const mcd_tx_st &tx, uint64_t ticket);
+
+    /** \brief Drops the values before a transaction writes registers. */
+    void write(const mcd_tx_st &tx);
+};
+
+/** \brief Caches the memory of a core in pages.
+ *
+ * Only program memory and physical memory are cached, the content of logical
+ * memory depends on the MMU and cache memory spaces mirror the state of the
+ * caches. Memory-mapped registers whose reads have side effects and
+ * transactions with \c MCD_TX_OPT_SIDE_EFFECTS bypass the cache.
+ *
+ * A read which misses the cache is extended to whole pages by \c fill_range,
+ * the response fills the cache. Since reading memory beyond the range of the
+ * client might have side effects, e.g. on memory-mapped peripherals, reads
+ * are only extended in program memory and in the memory spaces passed to
+ * \c set_fill_spaces. In other memory spaces, only reads of whole pages are
+ * cached. Writes drop the overlapping pages and, since
+ * memory spaces might alias each other, all pages of other memory spaces.
+ * When the capacity is exceeded, the least recently used page is evicted.
+ */
+class MemoryCache : public TargetCache
+{
+    using Key = std::pair<uint32_t, uint64_t>;
+
+    struct Page {
+        std::vector<uint8_t> data;
+        /* position in lru */
+        std::list<Key>::iterator use;
+    };
+
+    struct Space {
+        uint64_t min_addr;
+        uint64_t max_addr;
+        /* ranges of registers with read side effects */
+        std::vector<std::pair<uint64_t, uint64_t>> uncached;
+        /* reads may be extended beyond the range of the client */
+        bool fill;
+        /* reads are not extended beyond this address, since a read beyond
+         * it failed, e.g. as the memory is not mapped */
+        uint64_t fill_end;
+    };
+
+    /* cached pages by memory space ID and page address */
+    std::map<Key, Page> pages;
+    /* most recently used page first */
+    std::list<Key> lru;
+    /* cacheable memory spaces by ID */
+    std::map<uint32_t, Space> spaces;
+    /* writes to registers leave the memory unchanged */
+    std::vector<uint32_t> register_spaces;
+    /* IDs of memory spaces besides program memory whose reads are extended */
+    std::vector<uint32_t> fill_spaces;
+    uint32_t capacity;
+
+    /* range of the last cacheable read, to detect sequential reads */
+    uint32_t stream_space;
+    uint64_t stream_begin;
+    uint64_t stream_end;
+    /* pages fetched beyond a sequential read which missed the cache */
+    uint32_t read_ahead;
+
+    const Space *cacheable(const mcd_tx_st &tx) const;
+    bool pages_cacheable(const Space &space, uint64_t begin,
+                         uint64_t end) const;
+    void track(const mcd_tx_st &tx, bool miss);
+    void clear_values() override;
+
+public:
+    static constexpr uint32_t PAGE_SIZE{1024};
+    static constexpr uint32_t MAX_READ_AHEAD{32};
+
+    MemoryCache();
+
+    /** \brief Sets the maximum number of cached pages, 0 disables the cache.
+     */
+    void set_capacity(uint32_t pages);
+
+    uint32_t get_capacity() const;
+    uint32_t num_pages() const;
+
+    /** \brief Number of pages currently read ahead of sequential reads. */
+    uint32_t get_read_ahead() const;
+
+    /** \brief Sets the memory spaces whose reads may be extended to whole
+     * pages although they are no program memory.
+     *
+     * Takes effect with the next \c set_memory_spaces.
+     */
+    void set_fill_spaces(const std::vector<uint32_t> &mem_space_ids);
+
+    /** \brief Replaces the cacheable memory spaces.
+     *
+     * @param mem_spaces Memory spaces of the core, only those of cacheable
+     *                   types are kept.
+     * @param registers Registers of the core, those with read side effects
+     *                  are never cached.
+     */
+    void set_memory_spaces(const std::vector<mcd_memspace_st> &mem_spaces,
+                           const std::vector<mcd_register_info_st> &registers);
+
+    /** \brief Answers a read transaction from the cache.
+     *
+     * @param tx Client transaction, completed on a hit.
+     * @param ticket Nonzero on a miss if the response to the range of
+     *               \c fill_range can be cached by \c fill.
+     * @return Whether the transaction has been completed.
+     */
+    bool read(mcd_tx_st &tx, uint64_t &ticket);
+
+    /** \brief Extends a read which missed the cache to whole pages.
+     *
+     * Only called for reads with a ticket, i.e. reads which are either whole
+     * pages or in a memory space whose reads may be extended.
+     *
+     * If the preceding reads were sequential, the range is extended by up to
+     * \c get_read_ahead further pages, as far as they are cacheable and not
+     * cached yet.
+     *
+     * @param tx Client transaction.
+     * @param fill Receives the extended transaction, its data is not set.
+     * @param max_num_bytes Limit for the read ahead, e.g. the size of a
+     *                      transaction which fits into a packet.
+     */
+    void fill_range(const mcd_tx_st &tx, mcd_tx_st &fill,
+                    uint32_t max_num_bytes) const;
+
+    /** \brief Stores the response to a read extended by \c fill_range. */
+    void fill(const mcd_tx_st &fill, uint64_t ticket);
+
+    /** \brief Stops extending reads at a read extended by \c fill_range
+     * which failed or came back short.
+     *
+     * Further reads are not extended beyond the first page which has not
+     * been read, or, if that is unknown, beyond the pages of the client's
+     * read, and the read ahead starts over. The limit is lifted when the
+     * cache is invalidated.
+     *
+     * @param fill The failed read.
+     * @param client_end End of the range the client requested.
+     */
+    void fill_failed(const mcd_tx_st &fill, uint64_t client_end);
+
+    /** \brief Drops the pages a transaction writes. */
+    void write(const mcd_tx_st &tx);
+};
+
+/** \brief Deferred writes of a core.
+ *
+ * Patching code or restoring a context produces long runs of small writes.
+ * Writes to memory are combined with adjacent pending writes, and writes to
+ * the same bytes overwrite the pending ones, so only a few large writes are
+ * sent when the buffer is flushed.
+ *
+ * The buffer has to be flushed before any transaction which \c conflicts with
+ * the pending writes, e.g. a read of an overlapping range, and before the
+ * core executes. Transactions with side effects and chains of transactions
+ * with \c MCD_TX_OPT_ATOMIC_WITH_NEXT are never deferred.
+ */
+class WriteBuffer
+{
+    struct Run {
+        /* attributes of the writes, data is only set by take */
+        mcd_tx_st tx;
+        std::vector<uint8_t> data;
+    };
+
+    /* pending writes in the order of their first write */
+    std::vector<Run> runs;
+    /* writes to registers are only combined if they write the same bytes */
+    std::vector<uint32_t> register_spaces;
+    uint32_t capacity;
+    uint32_t size;
+
+    bool is_register_space(uint32_t mem_space_id) const;
+
+public:
+    /** \brief Number of writes which have been deferred. */
+    uint64_t deferred;
+
+    /** \brief Number of pending writes combined with a later one. */
+    uint64_t combined;
+
+    /** \brief Number of times the pending writes have been taken. */
+    uint64_t flushes;
+
+    WriteBuffer();
+
+    /** \brief Sets the maximum number of pending bytes, 0 disables the buffer.
+     */
+    void set_capacity(uint32_t bytes);
+
+    uint32_t get_capacity() const;
+    bool empty() const;
+
+    /** \brief Sets the memory spaces of the core to tell registers apart. */
+    void set_memory_spaces(const std::vector<mcd_memspace_st> &mem_spaces);
+
+    /** \brief Whether a transaction may be deferred.
+     *
+     * @param tx Client transaction.
+     * @param chained Whether the preceding transaction has the option
+     *                \c MCD_TX_OPT_ATOMIC_WITH_NEXT.
+     */
+    bool deferrable(const mcd_tx_st &tx, bool chained) const;
+
+    /** \brief Whether the pending writes have to be sent before a transaction.
+     *
+     * This is the case if the transaction accesses bytes which are written
+     * by the pending writes or might alias them, or if the transaction is a
+     * write which cannot be added to the pending ones.
+     */
+    bool conflicts(const mcd_tx_st &tx, bool chained) const;
+
+    /** \brief Defers a write which is \c deferrable and does not conflict. */
+    void add(const mcd_tx_st &tx);
+
+    /** \brief Moves the pending writes out of the buffer.
+     *
+     * @param tx Receives one write per run of pending bytes.
+     * @param data Receives the data the writes refer to.
+     */
+    void take(std::vector<mcd_tx_st> &tx,
+              std::vector<std::vector<uint8_t>> &data);
+};
+
 class Core
 {
     bool updated;
@@ -169,6 +502,24 @@ public:
     /** \brief Core UID as provided by the server */
     const uint32_t core_uid;
 
+    /** \brief Serializes the API calls on the core. */
+    std::recursive_mutex access;
+
+    /** \brief Register values of the client's view, guarded by \c access. */
+    RegisterCache register_cache;
+
+    /** \brief Memory of the client's view, guarded by \c access. */
+    MemoryCache memory_cache;
+
+    /** \brief Writes not yet sent to the server, guarded by \c access. */
+    WriteBuffer write_buffer;
+
+    /** \brief Validates the caches, see \c TargetCache::set_halted. */
+    void set_halted(uint64_t since);
+
+    /** \brief Invalidates the caches before the core executes. */
+    void invalidate_caches();
+
     /**
      * \brief Initializes a new \c Core instance.
      *
@@ -213,4 +564,8 @@ public:
 
     mcd_return_et convert_address_to_server(mcd_addr_st &addr,
                                             mcd_error_info_st &error) const;
+
+    /** \brief Returns the client's memory space with the given ID, if any.
+     */
+    const mcd_memspace_st *find_memory_space(uint32_t mem_space_id) const;
 };
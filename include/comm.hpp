@@ -24,7 +24,16 @@ SOFTWARE.
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "mcd_api.h"
 #include "mcd_rpc.h"
@@ -44,6 +53,7 @@ SOFTWARE.
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <unistd.h>
 #define SOCKET int
 #define ISVALIDSOCKET(s) ((s) >= 0)
@@ -56,6 +66,7 @@ SOFTWARE.
 #define LOCALHOST "127.0.0.1"
 #define MCD_DEFAULT_TCP_PORT 1235
 #define MCD_MAX_PACKET_LENGTH 65535
+#define MCD_DEFAULT_TIMEOUT_MILLISECONDS 5000
 
 /**
  * \brief Custom MCD exception type with error info encoded as
@@ -67,41 +78,550 @@ struct mcd_exception : public std::exception {
     const char *what();
 };
 
-/** \brief Provides a communication channel with the MCD server.
+/**
+ * \brief Connection settings as encoded in the \c config_string of
+ * \c mcd_open_server_f.
+ *
+ * The expected format is <tt>[<address>] [<key>=<value> ...]</tt> where the
+ * address is either <tt><hostname>:<port></tt> for a TCP connection or
+ * <tt>unix:<path></tt> for a UNIX domain socket. The following keys are
+ * supported:
+ * - \c window: Maximum number of requests sent to the server before the
+ *   response to the first one is awaited (default: 1).
+ * - \c transport: \c socket to exchange the messages over the connection
+ *   (default) or \c shm to exchange them through shared memory, which is set
+ *   up over a UNIX domain socket (Linux only).
+ * - \c timeout: Time in milliseconds to wait for a response (default: 5000).
+ * - \c cache: Number of memory pages cached per core while the core is
+ *   halted (default: 0, i.e. memory is not cached).
+ * - \c cache_fill: Comma-separated IDs of memory spaces besides program
+ *   memory whose reads may be extended to whole pages by the memory cache
+ *   (default: none).
+ * - \c write_buffer: Maximum number of bytes of deferred writes per core
+ *   (default: 0, i.e. writes are sent immediately).
  */
-class MCDServer
+struct MCDServerConfig {
+    std::string host{LOCALHOST};
+    int port{MCD_DEFAULT_TCP_PORT};
+    /* path of a UNIX domain socket, used instead of host and port if set */
+    std::string socket_path{};
+    uint32_t window{1};
+    /* exchange messages through shared memory instead of the socket */
+    bool shared_memory{false};
+    uint32_t timeout_ms{MCD_DEFAULT_TIMEOUT_MILLISECONDS};
+    /* pages of the memory cache of every core */
+    uint32_t cache_pages{0};
+    /* memory spaces whose reads the memory cache may extend */
+    std::vector<uint32_t> cache_fill{};
+    /* bytes of the write buffer of every core */
+    uint32_t write_buffer{0};
+
+    /**
+     * \brief Parses a \c config_string.
+     *
+     * @param config_string Configuration string passed by the client.
+     * @param config Parsed settings on success.
+     * @param error Error information in case of failure.
+     *
+     * @returns Return code as defined in MCD API.
+     */
+    static mcd_return_et Parse(const std::string &config_string,
+                               MCDServerConfig &config,
+                               mcd_error_info_st &error);
+};
+
+/**
+ * \brief Byte stream between client stub and MCD server.
+ *
+ * The message framing is done by \c MCDServer on top of the transport, so
+ * every protocol works with every transport.
+ */
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    /**
+     * \brief Establishes the connection, replacing a lost one.
+     *
+     * @param error Error information in case of failure.
+     *
+     * @returns Return code as defined in MCD API.
+     */
+    virtual mcd_return_et connect(mcd_error_info_st &error) = 0;
+
+    /**
+     * \brief Checks whether the connection is established.
+     */
+    virtual bool is_connected() const = 0;
+
+    /**
+     * \brief Drops the connection, e.g. when the byte stream is out of sync.
+     *
+     * The next call of \c connect establishes a new connection.
+     */
+    virtual void disconnect() = 0;
+
+    /**
+     * \brief Sends all bytes of a message.
+     *
+     * @param data Message to be sent.
+     * @param len Message length in bytes.
+     * @param error Error information in case of failure.
+     *
+     * @returns Return code as defined in MCD API.
+     */
+    virtual mcd_return_et send(const char *data, uint32_t len,
+                               mcd_error_info_st &error) = 0;
+
+    /**
+     * \brief Receives the bytes which are available without blocking.
+     *
+     * Called by the I/O thread when one of the \c wait_handles is readable,
+     * which does not guarantee that bytes are available.
+     *
+     * @param data Destination of the received bytes.
+     * @param capacity Maximum number of bytes to be received.
+     * @param num_bytes Number of bytes received on success, might be 0.
+     * @param error Error information in case of failure.
+     *
+     * @returns Return code as defined in MCD API.
+     */
+    virtual mcd_return_et receive(char *data, uint32_t capacity,
+                                  uint32_t &num_bytes,
+                                  mcd_error_info_st &error) = 0;
+
+    /**
+     * \brief Handles which become readable when bytes might be available or
+     * the connection has been closed.
+     */
+    virtual std::vector<SOCKET> wait_handles() const = 0;
+
+    /**
+     * \brief Announces that the I/O thread is about to block on the
+     * \c wait_handles.
+     *
+     * @param response_pending Whether a response is awaited, the transport
+     * may poll for it briefly before the I/O thread blocks.
+     *
+     * @returns \c false if bytes are available already, the I/O thread does
+     * not block then.
+     */
+    virtual bool prepare_wait(bool /*response_pending*/)
+    {
+        return true;
+    }
+
+    /**
+     * \brief Announces that the I/O thread does not block anymore.
+     */
+    virtual void finish_wait() {}
+};
+
+/**
+ * \brief Transport over a TCP connection or a UNIX domain socket.
+ */
+class SocketTransport : public Transport
 {
 #if defined(WIN32)
     static int winsock_connections;
 #endif
-    MCDServer(const std::string &host, int port);
-    mcd_return_et connect_to_target(mcd_error_info_st &error);
-    std::string host;
-    int port;
+    const MCDServerConfig config;
     SOCKET socket_fd;
-    bool connected;
-    char buf[MCD_MAX_PACKET_LENGTH];
+    /* cleared by the I/O thread when the server closes the connection */
+    std::atomic<bool> connected;
+
+    mcd_return_et create_socket(mcd_error_info_st &error);
+    mcd_return_et connect_tcp(mcd_error_info_st &error);
+    mcd_return_et connect_unix(mcd_error_info_st &error);
+
+public:
+    /**
+     * \brief Prepares a connection, see \c connect.
+     *
+     * @throws \c mcd_exception
+     *
+     * @param config Connection settings, see \c MCDServerConfig.
+     */
+    SocketTransport(const MCDServerConfig &config);
+
+    SocketTransport(SocketTransport &) = delete;
+    SocketTransport &operator=(SocketTransport &other) = delete;
+
+    /**
+     * \brief Closes the connection.
+     */
+    ~SocketTransport();
+
+    /**
+     * \brief Underlying socket, valid while connected.
+     */
+    SOCKET native_handle() const
+    {
+        return this->socket_fd;
+    }
+
+    mcd_return_et connect(mcd_error_info_st &error) override;
+    bool is_connected() const override;
+    void disconnect() override;
+    mcd_return_et send(const char *data, uint32_t len,
+                       mcd_error_info_st &error) override;
+    mcd_return_et receive(char *data, uint32_t capacity, uint32_t &num_bytes,
+                          mcd_error_info_st &error) override;
+    std::vector<SOCKET> wait_handles() const override;
+};
+
+#if defined(__linux__)
+struct ShmChannel;
+
+/**
+ * \brief Transport through ring buffers in shared memory.
+ *
+ * The shared memory is handed to the server over a UNIX domain socket, see
+ * \c shm_ring.hpp. The socket is kept open to detect a terminated server.
+ */
+class ShmTransport : public Transport
+{
+    SocketTransport control;
+    const uint32_t timeout_ms;
+    int memfd;
+    int request_event_fd;
+    int response_event_fd;
+    ShmChannel *channel;
+    /* cleared by the I/O thread when the server closes the connection */
+    std::atomic<bool> connected;
+
+    mcd_return_et handshake(mcd_error_info_st &error);
+
+public:
+    /**
+     * \brief Prepares a connection, see \c connect.
+     *
+     * @throws \c mcd_exception
+     *
+     * @param config Connection settings, see \c MCDServerConfig.
+     */
+    ShmTransport(const MCDServerConfig &config);
+
+    ShmTransport(ShmTransport &) = delete;
+    ShmTransport &operator=(ShmTransport &other) = delete;
+
+    /**
+     * \brief Closes the connection and releases the shared memory.
+     */
+    ~ShmTransport();
+
+    mcd_return_et connect(mcd_error_info_st &error) override;
+    bool is_connected() const override;
+    void disconnect() override;
+    mcd_return_et send(const char *data, uint32_t len,
+                       mcd_error_info_st &error) override;
+    mcd_return_et receive(char *data, uint32_t capacity, uint32_t &num_bytes,
+                          mcd_error_info_st &error) override;
+    std::vector<SOCKET> wait_handles() const override;
+    bool prepare_wait(bool response_pending) override;
+    void finish_wait() override;
+};
+#endif
+
+/**
+ * \brief Receives and frames the messages of a connection in the background.
+ *
+ * The thread blocks on the \c wait_handles of the transport (with \c epoll
+ * on Linux) and cuts the received byte stream into messages as soon as they
+ * arrive. Every message is dispatched to the request with the same request
+ * ID, so several callers can wait for their responses at the same time and
+ * marshalling the next request overlaps with waiting for the response to the
+ * previous one. Messages without an ID are no responses: they are classified
+ * by \c classify_message, events are queued for \c next_event and anything
+ * else, e.g. a greeting, is dropped.
+ *
+ * A thread serves a single connection: it is stopped before the transport is
+ * disconnected and started again after a new connection has been established.
+ */
+class IoThread
+{
+    /* result of extract_message */
+    enum class Framing {
+        /* no complete message staged */
+        INCOMPLETE,
+        MESSAGE,
+        /* an overlong message has been dropped, the stream continues */
+        DISCARDED,
+        /* the stream cannot be resynchronized */
+        BROKEN,
+    };
+
+    /* result of classify_message */
+    enum class MessageKind {
+        /* the result of a request, carries its ID */
+        REPLY,
+        /* the result of the oldest waiting request, carries no ID */
+        ORDERED_REPLY,
+        /* the failure of a request, carries its ID */
+        FAILURE,
+        /* an asynchronous notification, carries no ID */
+        EVENT,
+        /* anything else, e.g. a greeting */
+        UNKNOWN,
+    };
+
+    struct Completion {
+        std::vector<char> message;
+        mcd_return_et return_status;
+        mcd_error_info_st error;
+    };
+
+    /* announced requests in the order they have been sent */
+    struct Request {
+        uint32_t request_id;
+        bool completed;
+        Completion completion;
+    };
+
+    Transport &transport;
+    std::thread thread;
+    std::atomic<bool> stop_requested;
+#if defined(__linux__)
+    int wake_fd;
+#endif
+
+    /* shared between I/O thread and caller */
+    std::mutex mutex;
+    std::condition_variable completed;
+    std::deque<Request> requests;
+    /* message buffers for reuse */
+    std::vector<std::vector<char>> spare;
+    /* received events in their order, the oldest are dropped when full */
+    std::deque<std::vector<char>> events;
+    /* cleared when the connection failed, reason in failure */
+    std::atomic<bool> alive;
+    mcd_error_info_st failure;
+
+    /*
+     * Owned by the I/O thread: received bytes which have not been framed yet
+     * are staged in rx_buf[rx_begin, rx_end). It holds at least two
+     * maximum-sized packets such that a complete packet always fits after the
+     * framed bytes have been discarded.
+     */
+    std::vector<char> rx_buf;
+    uint32_t rx_begin;
+    uint32_t rx_end;
+    /* number of staged bytes already searched for a message delimiter */
+    uint32_t rx_scanned;
+    /* the remainder of an overlong message is being discarded */
+    bool rx_overflow;
+
+    void run();
+
+    /**
+     * \brief Blocks until one of the \c wait_handles is readable or a stop
+     * has been requested.
+     */
+    void wait_readable(const std::vector<SOCKET> &handles, int epoll_fd);
+
+    /**
+     * \brief Appends the bytes available on the transport to \c rx_buf.
+     */
+    mcd_return_et receive_bytes(mcd_error_info_st &error);
+
+    /**
+     * \brief Cuts the next message from the staged bytes.
+     *
+     * Implemented by the protocol, e.g. length-prefixed frames for RPC and
+     * lines for QMP. A message handed to \c MCDServer::msg_buf must not
+     * exceed \c MCD_MAX_PACKET_LENGTH bytes.
+     *
+     * @param message Complete message in case of \c Framing::MESSAGE.
+     * @param error Error information in case of \c Framing::DISCARDED or
+     * \c Framing::BROKEN.
+     */
+    Framing extract_message(std::vector<char> &message,
+                            mcd_error_info_st &error);
+
+    /**
+     * \brief Tells replies from events without parsing the message.
+     *
+     * Implemented by the protocol like \c extract_message.
+     *
+     * @param request_id ID of the request in case of \c MessageKind::REPLY
+     * and \c MessageKind::FAILURE.
+     */
+    static MessageKind classify_message(const std::vector<char> &message,
+                                        uint32_t &request_id);
+
+    std::vector<char> take_buffer();
+    std::deque<Request>::iterator find_request(uint32_t request_id);
+    bool response_pending();
+    void complete(std::vector<char> &&message, mcd_return_et return_status,
+                  const mcd_error_info_st &error);
+    void fail(const mcd_error_info_st &error);
+    void wake();
+
+public:
+    /**
+     * @throws \c mcd_exception
+     *
+     * @param transport Connection to be served, must outlive the thread.
+     */
+    IoThread(Transport &transport);
+
+    IoThread(IoThread &) = delete;
+    IoThread &operator=(IoThread &other) = delete;
+
+    /**
+     * \brief Stops the thread.
+     */
+    ~IoThread();
+
+    /**
+     * \brief Starts serving the connected transport with an empty state.
+     */
+    void start();
+
+    /**
+     * \brief Stops the thread and waits for it.
+     */
+    void stop();
+
+    /**
+     * \brief Checks whether the connection is still usable.
+     */
+    bool is_alive() const
+    {
+        return this->alive;
+    }
+
+    /**
+     * \brief Announces a request such that its response can be dispatched.
+     *
+     * Has to be called before the request is sent.
+     *
+     * @param request_id ID carried by the request and its response.
+     */
+    void expect(uint32_t request_id);
+
+    /**
+     * \brief Waits for the response to a request.
+     *
+     * Responses received before the connection failed are handed out before
+     * the failure is reported. If the timeout expires, the connection is
+     * considered failed since the server does not respond anymore. The
+     * request is done afterwards in any case.
+     *
+     * @param request_id ID of an announced request, see \c expect.
+     * @param dst Destination of the message, at least
+     * \c MCD_MAX_PACKET_LENGTH bytes.
+     * @param timeout Maximum time to wait.
+     * @param error Error information in case of failure.
+     *
+     * @returns Return code as defined in MCD API.
+     */
+    mcd_return_et next_message(uint32_t request_id, char *dst,
+                               std::chrono::milliseconds timeout,
+                               mcd_error_info_st &error);
+
+    /**
+     * \brief Takes the oldest event received on the connection.
+     *
+     * Events are queued apart from the responses, so they are never parsed
+     * as the result of a request.
+     *
+     * @param event Receives the message, its previous buffer is reused.
+     *
+     * @returns \c false if no event is queued.
+     */
+    bool next_event(std::vector<char> &event);
+};
+
+/** \brief Provides a communication channel with the MCD server.
+ */
+class MCDServer
+{
+    MCDServer(const MCDServerConfig &config);
+    MCDServerConfig config;
+    std::unique_ptr<Transport> transport;
+    /* declared after transport such that it is stopped first */
+    std::unique_ptr<IoThread> io;
+    /* serializes sending and reconnecting */
+    std::mutex send_mutex;
+    std::atomic<uint32_t> request_ids;
 
 public:
     uint32_t server_uid;
-    char *const msg_buf;
 
     /**
-     * \brief Initializes a new TCP connection to a MCD server.
+     * \brief Buffer for the messages of the calling thread.
+     *
+     * Every thread marshals its requests and unmarshals its responses in a
+     * buffer of its own, so threads can wait for responses concurrently.
+     */
+    static char *msg_buf();
+
+    /**
+     * \brief Initializes a new connection to a MCD server.
      *
      * @throws \c mcd_exception
      *
-     * @param host Host name of the server socket.
-     * @param port TCP port number of the server socket.
+     * @param config Connection settings, see \c MCDServerConfig.
      */
-    static MCDServer Open(const std::string &host, int port);
+    static MCDServer Open(const MCDServerConfig &config);
 
     /**
      * \brief Checks whether the server is currently in the "connected" state.
      */
     bool is_connected()
     {
-        return this->connected;
+        return this->transport && this->transport->is_connected() &&
+               this->io && this->io->is_alive();
+    }
+
+    /**
+     * \brief Maximum number of requests which may be pending at a time.
+     *
+     * A caller with independent requests can send up to this many before it
+     * has to receive the response to the first one.
+     */
+    uint32_t window() const
+    {
+        return this->config.window;
+    }
+
+    /**
+     * \brief Capacity of the memory cache of every core in pages.
+     */
+    uint32_t cache_pages() const
+    {
+        return this->config.cache_pages;
+    }
+
+    /**
+     * \brief Memory spaces whose reads the memory cache may extend to whole
+     * pages in addition to program memory.
+     */
+    const std::vector<uint32_t> &cache_fill() const
+    {
+        return this->config.cache_fill;
+    }
+
+    /**
+     * \brief Capacity of the write buffer of every core in bytes.
+     */
+    uint32_t write_buffer() const
+    {
+        return this->config.write_buffer;
+    }
+
+    /**
+     * \brief Provides the ID for the next request.
+     *
+     * The ID is marshalled into the request and echoed by the server in the
+     * response, which allows several requests to be pending on the connection
+     * at the same time.
+     */
+    uint32_t new_request_id()
+    {
+        return this->request_ids++;
     }
 
     /**
@@ -112,36 +632,53 @@ public:
      *
      * @throws \c mcd_exception
      *
+     * @param request_id ID marshalled into the message, see
+     * \c new_request_id.
      * @param len Message length in bytes.
      * @param error Error information in case of failure.
      *
      * @returns Return code as defined in MCD API.
      */
-    mcd_return_et send_message(uint32_t len, mcd_error_info_st &error);
+    mcd_return_et send_message(uint32_t request_id, uint32_t len,
+                               mcd_error_info_st &error);
 
     /**
-     * \brief Receives messages from the server.
+     * \brief Receives the response to a request from the server.
      *
-     * On success, the messages will be at the beginning of msg_buf.
+     * On success, the message will be at the beginning of msg_buf. Messages
+     * are received by the I/O thread, this call waits until the response is
+     * complete or the configured timeout expires. Responses to the requests
+     * of other threads are handed to them, so the order in which the
+     * responses arrive does not matter.
      *
      * When using a protocol like QMP, the server might also send messages that
-     * are not sent as a response to a RPC request. For that reason, the
-     * constraint that one request message precedes exactly one response message
-     * does not hold anymore.
+     * are not sent as a response to a RPC request. Events are queued for
+     * \c next_event, other messages are dropped.
      *
+     * @param request_id ID of a request sent by \c send_message.
      * @param error Error information in case of failure.
      *
      * @returns Return code as defined in MCD API.
      */
-    mcd_return_et receive_messages(mcd_error_info_st &error);
+    mcd_return_et receive_messages(uint32_t request_id,
+                                   mcd_error_info_st &error);
+
+    /**
+     * \brief Takes the oldest event the server has sent.
+     *
+     * @param event Receives the message, see \c IoThread::next_event.
+     *
+     * @returns \c false if no event is queued.
+     */
+    bool next_event(std::vector<char> &event)
+    {
+        return this->io->next_event(event);
+    }
 
     MCDServer(MCDServer &) = delete;
     MCDServer &operator=(MCDServer &other) = delete;
     MCDServer(MCDServer &&);
     MCDServer &operator=(MCDServer &&other);
 
-    /**
-     * \brief Closes the TCP connection.
-     */
-    ~MCDServer();
+    ~MCDServer() = default;
 };
@@ -610,13 +610,81 @@ typedef struct {
     uint32_t trace_data_len;
 } mcd_read_trace_result;
 
+/*
+ * Marshalling of requests
+ *
+ * serialized_size_*_args returns the exact number of bytes the request
+ * occupies in the message buffer, or an upper bound with the compact integer
+ * encoding. The marshal functions return 0 if the request does not fit into
+ * buf_size bytes.
+ */
 uint32_t marshal_mcd_exit(char *buf, size_t buf_size);
 
-#define DECLARE_MARSHAL(function)                                     \
-    uint32_t marshal_##function##_args(function##_args const *args,   \
-                                       char *buf, size_t buf_size);   \
-    mcd_return_et unmarshal_##function##_result(                      \
-        char const *buf, function##_result *res,                      \
+/*
+ * Integer encoding
+ *
+ * Integers are sent at full width by default. With encoding=varint in the
+ * config string of mcd_open_server_f, the client offers a compact encoding
+ * (LEB128) which is used once the server echoes the key in its response.
+ * select_compact_encoding overrides the negotiated encoding, e.g. to compare
+ * both encodings without a server.
+ */
+void select_compact_encoding(bool compact);
+
+/*
+ * Request IDs
+ *
+ * With dispatch=id in the config string of mcd_open_server_f, the client
+ * offers a request ID in the header of every request, which the server copies
+ * into its response. It is used once the server echoes the key, otherwise the
+ * header carries no ID and the responses are matched in the order of the
+ * requests. Returns whether the request IDs have been negotiated.
+ */
+bool rpc_request_ids(void);
+
+/*
+ * Binary frames of the QMP protocol
+ *
+ * With format=cbor or format=msgpack, messages are not delimited by '\n' but
+ * preceded by a header: a marker byte which cannot start a JSON line, followed
+ * by the length of the payload and the request ID as little endian uint32.
+ * The marker names the format of the payload and whether the request ID is
+ * valid, events carry none.
+ */
+#define QMP_FRAME_CBOR 0xf8
+#define QMP_FRAME_MSGPACK 0xfa
+#define QMP_FRAME_HAS_ID 0x01
+#define QMP_FRAME_FORMAT_MASK 0xfe
+#define QMP_FRAME_HEADER_SIZE 9
+
+static inline bool qmp_frame_marker(uint8_t marker)
+{
+    return (marker & QMP_FRAME_FORMAT_MASK) == QMP_FRAME_CBOR ||
+           (marker & QMP_FRAME_FORMAT_MASK) == QMP_FRAME_MSGPACK;
+}
+
+static inline uint32_t qmp_frame_get_u32(const char *p)
+{
+    return (uint32_t)(uint8_t)p[0] | (uint32_t)(uint8_t)p[1] << 8 |
+           (uint32_t)(uint8_t)p[2] << 16 | (uint32_t)(uint8_t)p[3] << 24;
+}
+
+static inline void qmp_frame_put_u32(char *p, uint32_t value)
+{
+    p[0] = (char)value;
+    p[1] = (char)(value >> 8);
+    p[2] = (char)(value >> 16);
+    p[3] = (char)(value >> 24);
+}
+
+#define DECLARE_MARSHAL(function)                                           \
+    uint32_t serialized_size_##function##_args(function##_args const *args, \
+                                               uint32_t request_id);        \
+    uint32_t marshal_##function##_args(function##_args const *args,         \
+                                       uint32_t request_id,                 \
+                                       char *buf, size_t buf_size);         \
+    mcd_return_et unmarshal_##function##_result(                            \
+        char const *buf, function##_result *res,                            \
         mcd_error_info_st *error_info);
 
 DECLARE_MARSHAL(mcd_open_server)
@@ -651,4 +719,23 @@ DECLARE_MARSHAL(mcd_qry_rst_classes)
 DECLARE_MARSHAL(mcd_qry_rst_class_info)
 DECLARE_MARSHAL(mcd_rst)
 
+/*
+ * Size bounds for packing transaction lists
+ *
+ * mcd_execute_txlist_f packs as many transactions into one request as fit into
+ * a single packet. Since the server sends the transactions back, the bounds
+ * hold for both the request and its response.
+ */
+uint32_t marshal_mcd_execute_txlist_bound(void);
+uint32_t marshal_mcd_tx_st_bound(const mcd_tx_st *tx);
+
+/*
+ * Size bounds for paging register maps
+ *
+ * mcd_qry_reg_map_f queries as many registers at once as their descriptions
+ * fit into a single response packet.
+ */
+uint32_t unmarshal_mcd_qry_reg_map_bound(void);
+uint32_t unmarshal_mcd_register_info_st_bound(void);
+
 #endif /* MCD_RPC_H */
\ No newline at end of file
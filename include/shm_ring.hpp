@@ -0,0 +1,271 @@
+/*
+MIT License
+
+Copyright (c) 2025 Lauterbach GmbH
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+/*
+ * Shared memory transport
+ *
+ * Client stub and server exchange their messages through a pair of ring
+ * buffers in a memfd. The client creates the memfd and one eventfd per ring
+ * and passes them to the server over a UNIX domain socket:
+ *
+ * Client                                  Server
+ *      | -- mcd_shm_handshake_st + fds --> |
+ *      | <------ uint32_t status --------- |     0 on success
+ *      |                                   |
+ *      | ====== requests ring =========>   |
+ *      | <===== responses ring ==========  |
+ *
+ * The socket stays open such that either side notices when the other one
+ * terminates. The byte streams in the rings are framed exactly like the ones
+ * on a socket.
+ *
+ * A consumer spins for a short while before it blocks on the eventfd of its
+ * ring. The producer only signals the eventfd if the consumer announced to be
+ * blocking, so a round trip between two busy peers needs no system call.
+ */
+
+#if defined(__linux__)
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#define MCD_SHM_MAGIC "MCDSHM01"
+#define MCD_SHM_RING_CAPACITY (1u << 20)
+#define MCD_SHM_SPIN_MICROSECONDS 50
+
+/**
+ * \brief Handshake message of the shared memory transport.
+ *
+ * The memfd, the eventfd of the requests ring and the eventfd of the
+ * responses ring are attached in this order as \c SCM_RIGHTS.
+ */
+struct mcd_shm_handshake_st {
+    char magic[8];
+    uint32_t size;
+    uint32_t ring_capacity;
+};
+
+/**
+ * \brief Single-producer single-consumer byte ring.
+ *
+ * \c head and \c tail are free-running counters, the number of buffered bytes
+ * is their difference.
+ */
+struct ShmRing {
+    alignas(64) std::atomic<uint32_t> head;
+    alignas(64) std::atomic<uint32_t> tail;
+    /* the consumer is blocked (or about to block) on its eventfd */
+    alignas(64) std::atomic<uint32_t> waiting;
+    alignas(64) char data[MCD_SHM_RING_CAPACITY];
+
+    uint32_t available() const
+    {
+        return tail.load(std::memory_order_acquire) -
+               head.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Appends as many bytes as there is space for.
+     *
+     * @returns Number of bytes appended.
+     */
+    uint32_t write(const char *src, uint32_t len)
+    {
+        uint32_t t{tail.load(std::memory_order_relaxed)};
+        uint32_t space{MCD_SHM_RING_CAPACITY -
+                       (t - head.load(std::memory_order_acquire))};
+        if (len > space) {
+            len = space;
+        }
+
+        uint32_t offset{t % MCD_SHM_RING_CAPACITY};
+        uint32_t first{MCD_SHM_RING_CAPACITY - offset};
+        if (first > len) {
+            first = len;
+        }
+        memcpy(data + offset, src, first);
+        memcpy(data, src + first, len - first);
+
+        /* sequentially consistent to order it before the load of waiting */
+        tail.store(t + len, std::memory_order_seq_cst);
+        return len;
+    }
+
+    /**
+     * \brief Removes up to \c capacity bytes.
+     *
+     * @returns Number of bytes removed.
+     */
+    uint32_t read(char *dst, uint32_t capacity)
+    {
+        uint32_t h{head.load(std::memory_order_relaxed)};
+        uint32_t len{tail.load(std::memory_order_acquire) - h};
+        if (len > capacity) {
+            len = capacity;
+        }
+
+        uint32_t offset{h % MCD_SHM_RING_CAPACITY};
+        uint32_t first{MCD_SHM_RING_CAPACITY - offset};
+        if (first > len) {
+            first = len;
+        }
+        memcpy(dst, data + offset, first);
+        memcpy(dst + first, data, len - first);
+
+        head.store(h + len, std::memory_order_release);
+        return len;
+    }
+
+    /**
+     * \brief Wakes up the consumer if it is blocked.
+     */
+    void notify(int event_fd)
+    {
+        if (waiting.load(std::memory_order_seq_cst)) {
+            uint64_t one{1};
+            (void)!::write(event_fd, &one, sizeof(one));
+        }
+    }
+
+    /**
+     * \brief Spins for a short while until bytes are available.
+     *
+     * Only worthwhile if bytes are expected soon, e.g. a response.
+     *
+     * @returns \c true if bytes are available.
+     */
+    bool spin() const
+    {
+        /* spinning on a single CPU would only delay the producer */
+        static const bool multi_cpu{sysconf(_SC_NPROCESSORS_ONLN) > 1};
+        if (!multi_cpu) {
+            return available() > 0;
+        }
+
+        auto spin_end{std::chrono::steady_clock::now() +
+                      std::chrono::microseconds(MCD_SHM_SPIN_MICROSECONDS)};
+        while (available() == 0) {
+            if (std::chrono::steady_clock::now() > spin_end) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * \brief Announces that the consumer blocks on the eventfd.
+     *
+     * @returns \c false if bytes are available, the consumer must not block
+     * then.
+     */
+    bool prepare_wait()
+    {
+        waiting.store(1, std::memory_order_seq_cst);
+        if (tail.load(std::memory_order_seq_cst) !=
+            head.load(std::memory_order_relaxed)) {
+            waiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * \brief Announces that the consumer does not block anymore.
+     */
+    void finish_wait()
+    {
+        waiting.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Waits until bytes are available.
+     *
+     * @param event_fd Eventfd signalled by the producer.
+     * @param peer_fd Socket to the peer, the wait ends if it gets closed.
+     * @param timeout_ms Timeout in milliseconds, or -1 to wait forever.
+     *
+     * @returns 1 if bytes are available, 0 on timeout, -1 if the peer is gone.
+     */
+    int wait(int event_fd, int peer_fd, int timeout_ms)
+    {
+        if (spin()) {
+            return 1;
+        }
+
+        auto deadline{std::chrono::steady_clock::now() +
+                      std::chrono::milliseconds(timeout_ms)};
+        while (prepare_wait()) {
+            int remaining_ms{-1};
+            if (timeout_ms >= 0) {
+                remaining_ms = (int)std::chrono::duration_cast<
+                                   std::chrono::milliseconds>(
+                                   deadline - std::chrono::steady_clock::now())
+                                   .count();
+                if (remaining_ms <= 0) {
+                    finish_wait();
+                    return 0;
+                }
+            }
+
+            struct pollfd fds[2]{
+                {.fd{event_fd}, .events{POLLIN}, .revents{0}},
+                {.fd{peer_fd}, .events{POLLIN}, .revents{0}},
+            };
+            poll(fds, 2, remaining_ms);
+            finish_wait();
+
+            if (fds[0].revents & POLLIN) {
+                uint64_t count;
+                (void)!::read(event_fd, &count, sizeof(count));
+            }
+
+            if (fds[1].revents) {
+                /* the peer never sends on the socket, so it has been closed */
+                return available() ? 1 : -1;
+            }
+        }
+
+        return 1;
+    }
+};
+
+/**
+ * \brief Layout of the shared memory.
+ */
+struct ShmChannel {
+    /* client to server */
+    ShmRing requests;
+    /* server to client */
+    ShmRing responses;
+};
+
+#endif
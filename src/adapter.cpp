@@ -22,6 +22,9 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <algorithm>
+#include <cstring>
+
 #include "adapter.hpp"
 
 const mcd_error_info_st MCD_ERROR_INVALID_NULL_PARAM{
@@ -53,6 +56,8 @@ void TxAdapter::grant_server_access(const mcd_core_st *core)
     };
 }
 
+bool TxAdapter::accesses_server() const { return requires_server_access; }
+
 void TxAdapter::free_server_request(mcd_txlist_st &&server_request)
 {
     for (uint32_t i = 0; i < server_request.num_tx; i++) {
@@ -188,6 +193,597 @@ MemorySpace &MemorySpace::operator=(MemorySpace &&other)
 
 TxAdapter *MemorySpace::get_tx_adapter() const { return tx_adapter; }
 
+std::atomic<uint64_t> TargetCache::epoch{1};
+std::atomic<uint64_t> TargetCache::versions{1};
+
+TargetCache::TargetCache()
+    : halted{false}, halted_epoch{0}, version{versions++}, hits{0}, misses{0}
+{
+}
+
+uint64_t TargetCache::current_epoch() { return epoch.load(); }
+
+void TargetCache::invalidate_all() { epoch++; }
+
+bool TargetCache::valid() const
+{
+    return this->halted && this->halted_epoch == epoch.load();
+}
+
+void TargetCache::drop_values()
+{
+    this->clear_values();
+    this->expire_tickets();
+}
+
+void TargetCache::expire_tickets() { this->version = versions++; }
+
+void TargetCache::set_halted(uint64_t since)
+{
+    if (since != epoch.load()) {
+        /* a core might have executed while the state was queried */
+        this->invalidate();
+        return;
+    }
+
+    if (!this->valid()) {
+        this->drop_values();
+    }
+    this->halted = true;
+    this->halted_epoch = since;
+}
+
+void TargetCache::invalidate()
+{
+    this->halted = false;
+    this->drop_values();
+}
+
+void RegisterCache::set_registers(
+    const std::vector<mcd_register_info_st> &registers)
+{
+    this->entries.clear();
+    this->invalidate();
+    for (const mcd_register_info_st &r : registers) {
+        if (r.has_side_effects_read || r.regsize == 0) {
+            continue;
+        }
+        this->entries[{r.addr.mem_space_id, r.addr.address}] = {
+            .num_bytes{(r.regsize + 7) / 8},
+            .valid{false},
+            .value{},
+        };
+    }
+}
+
+void RegisterCache::clear_values()
+{
+    for (auto &[key, entry] : this->entries) {
+        entry.valid = false;
+    }
+}
+
+RegisterCache::Entry *RegisterCache::find(const mcd_tx_st &tx)
+{
+    auto it{this->entries.find({tx.addr.mem_space_id, tx.addr.address})};
+    if (it == this->entries.end() || it->second.num_bytes != tx.num_bytes) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+bool RegisterCache::read(mcd_tx_st &tx, uint64_t &ticket)
+{
+    ticket = 0;
+    if (tx.access_type != MCD_TX_AT_R ||
+        (tx.options & MCD_TX_OPT_SIDE_EFFECTS) || !this->valid()) {
+        return false;
+    }
+
+    Entry *entry{this->find(tx)};
+    if (!entry) {
+        return false;
+    }
+
+    if (!entry->valid) {
+        this->misses++;
+        ticket = this->version;
+        return false;
+    }
+
+    memcpy(tx.data, entry->value.data(), tx.num_bytes);
+    tx.num_bytes_ok = tx.num_bytes;
+    this->hits++;
+    return true;
+}
+
+void RegisterCache::fill(const mcd_tx_st &tx, uint64_t ticket)
+{
+    if (ticket != this->version || !this->valid() ||
+        tx.num_bytes_ok != tx.num_bytes) {
+        return;
+    }
+
+    Entry *entry{this->find(tx)};
+    if (entry) {
+        entry->value.assign(tx.data, tx.data + tx.num_bytes);
+        entry->valid = true;
+    }
+}
+
+void RegisterCache::write(const mcd_tx_st &tx)
+{
+    if (tx.access_type == MCD_TX_AT_R) {
+        return;
+    }
+
+    /* registers might alias each other, e.g. as parts of a wider register */
+    auto it{this->entries.lower_bound({tx.addr.mem_space_id, 0})};
+    if (it != this->entries.end() &&
+        it->first.first == tx.addr.mem_space_id) {
+        this->drop_values();
+    }
+}
+
+MemoryCache::MemoryCache()
+    : capacity{0}, stream_space{0}, stream_begin{0}, stream_end{0},
+      read_ahead{0}
+{
+}
+
+void MemoryCache::set_capacity(uint32_t pages)
+{
+    this->capacity = pages;
+    this->drop_values();
+}
+
+uint32_t MemoryCache::get_capacity() const { return this->capacity; }
+
+uint32_t MemoryCache::num_pages() const { return (uint32_t)this->pages.size(); }
+
+uint32_t MemoryCache::get_read_ahead() const { return this->read_ahead; }
+
+void MemoryCache::set_fill_spaces(const std::vector<uint32_t> &mem_space_ids)
+{
+    this->fill_spaces = mem_space_ids;
+}
+
+void MemoryCache::set_memory_spaces(
+    const std::vector<mcd_memspace_st> &mem_spaces,
+    const std::vector<mcd_register_info_st> &registers)
+{
+    this->spaces.clear();
+    this->register_spaces.clear();
+    this->stream_end = 0;
+    this->read_ahead = 0;
+    this->invalidate();
+
+    for (const mcd_memspace_st &ms : mem_spaces) {
+        const uint32_t type{ms.mem_type};
+        if (type & MCD_MEM_SPACE_IS_REGISTERS) {
+            this->register_spaces.push_back(ms.mem_space_id);
+            continue;
+        }
+        if (!(type & (MCD_MEM_SPACE_IS_PROGRAM | MCD_MEM_SPACE_IS_PHYSICAL)) ||
+            (type & (MCD_MEM_SPACE_IS_CACHE | MCD_MEM_SPACE_IS_LOGICAL |
+                     MCD_MEM_SPACE_IS_VIRTUAL | MCD_MEM_SPACE_IS_REGISTERS))) {
+            continue;
+        }
+        this->spaces[ms.mem_space_id] = {
+            .min_addr{ms.min_addr},
+            .max_addr{ms.max_addr},
+            .uncached{},
+            .fill{(type & MCD_MEM_SPACE_IS_PROGRAM) ||
+                  std::find(this->fill_spaces.begin(), this->fill_spaces.end(),
+                            ms.mem_space_id) != this->fill_spaces.end()},
+            .fill_end{UINT64_MAX},
+        };
+    }
+
+    for (const mcd_register_info_st &r : registers) {
+        auto it{this->spaces.find(r.addr.mem_space_id)};
+        if (it != this->spaces.end() && r.has_side_effects_read) {
+            it->second.uncached.push_back(
+                {r.addr.address, r.addr.address + (r.regsize + 7) / 8});
+        }
+    }
+}
+
+void MemoryCache::clear_values()
+{
+    this->pages.clear();
+    this->lru.clear();
+    for (auto &[id, space] : this->spaces) {
+        space.fill_end = UINT64_MAX;
+    }
+}
+
+const MemoryCache::Space *MemoryCache::cacheable(const mcd_tx_st &tx) const
+{
+    if (this->capacity == 0 || tx.access_type != MCD_TX_AT_R ||
+        tx.num_bytes == 0 ||
+        (tx.options & (MCD_TX_OPT_SIDE_EFFECTS | MCD_TX_OPT_NOINCREMENT)) ||
+        (tx.access_width > 1 && PAGE_SIZE % tx.access_width != 0)) {
+        return nullptr;
+    }
+
+    auto it{this->spaces.find(tx.addr.mem_space_id)};
+    return it != this->spaces.end() ? &it->second : nullptr;
+}
+
+/* Checks whether the pages of [begin, end) lie within the memory space */
+bool MemoryCache::pages_cacheable(const Space &space, uint64_t begin,
+                                  uint64_t end) const
+{
+    if (begin < space.min_addr ||
+        (space.max_addr != 0 && end - 1 > space.max_addr)) {
+        return false;
+    }
+    for (const auto &[from, to] : space.uncached) {
+        if (from < end && begin < to) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * A read is sequential if it starts within or up to a page after the last
+ * one, e.g. a memory view being scrolled or a section being scanned. Every
+ * sequential read which still misses the cache doubles the read ahead,
+ * every other miss halves it.
+ */
+void MemoryCache::track(const mcd_tx_st &tx, bool miss)
+{
+    const uint64_t begin{tx.addr.address};
+    const bool sequential{tx.addr.mem_space_id == this->stream_space &&
+                          this->stream_end != 0 &&
+                          begin >= this->stream_begin &&
+                          begin <= this->stream_end + PAGE_SIZE};
+
+    if (miss && sequential) {
+        this->read_ahead =
+            std::clamp(this->read_ahead * 2, (uint32_t)1, MAX_READ_AHEAD);
+    } else if (miss) {
+        this->read_ahead /= 2;
+    }
+
+    this->stream_space = tx.addr.mem_space_id;
+    this->stream_begin = begin;
+    this->stream_end = begin + tx.num_bytes;
+}
+
+bool MemoryCache::read(mcd_tx_st &tx, uint64_t &ticket)
+{
+    ticket = 0;
+    const Space *space{this->cacheable(tx)};
+    if (!space || !this->valid()) {
+        return false;
+    }
+
+    const uint64_t begin{tx.addr.address};
+    const uint64_t end{begin + tx.num_bytes};
+    const uint64_t first{begin - begin % PAGE_SIZE};
+    const uint64_t last{end + (PAGE_SIZE - end % PAGE_SIZE) % PAGE_SIZE};
+    if (end < begin || !this->pages_cacheable(*space, first, last)) {
+        return false;
+    }
+
+    /* all pages have to be present */
+    for (uint64_t page{first}; page < end; page += PAGE_SIZE) {
+        if (!this->pages.contains({tx.addr.mem_space_id, page})) {
+            this->track(tx, true);
+            this->misses++;
+            if ((space->fill && last <= space->fill_end) ||
+                (begin == first && end == last)) {
+                ticket = this->version;
+            }
+            return false;
+        }
+    }
+    this->track(tx, false);
+
+    for (uint64_t page{first}; page < end; page += PAGE_SIZE) {
+        Page &p{this->pages.at({tx.addr.mem_space_id, page})};
+        this->lru.splice(this->lru.begin(), this->lru, p.use);
+
+        const uint64_t from{begin > page ? begin : page};
+        const uint64_t to{end < page + PAGE_SIZE ? end : page + PAGE_SIZE};
+        memcpy(tx.data + (from - begin), p.data.data() + (from - page),
+               to - from);
+    }
+
+    tx.num_bytes_ok = tx.num_bytes;
+    this->hits++;
+    return true;
+}
+
+void MemoryCache::fill_range(const mcd_tx_st &tx, mcd_tx_st &fill,
+                             uint32_t max_num_bytes) const
+{
+    const uint64_t begin{tx.addr.address};
+    const uint64_t end{begin + tx.num_bytes};
+    const uint64_t first{begin - begin % PAGE_SIZE};
+    uint64_t last{end + (PAGE_SIZE - end % PAGE_SIZE) % PAGE_SIZE};
+
+    /* read ahead while the pages stay cacheable and are not cached yet */
+    const Space *space{this->cacheable(tx)};
+    uint64_t limit{std::min<uint64_t>(max_num_bytes,
+                                      (uint64_t)this->capacity * PAGE_SIZE)};
+    limit -= limit % PAGE_SIZE;
+    for (uint32_t i{0}; space && space->fill && i < this->read_ahead; i++) {
+        if (last + PAGE_SIZE < last || last + PAGE_SIZE - first > limit ||
+            last + PAGE_SIZE > space->fill_end ||
+            !this->pages_cacheable(*space, last, last + PAGE_SIZE) ||
+            this->pages.contains({tx.addr.mem_space_id, last})) {
+            break;
+        }
+        last += PAGE_SIZE;
+    }
+
+    fill = tx;
+    fill.addr.address = first;
+    fill.num_bytes = (uint32_t)(last - first);
+    fill.num_bytes_ok = 0;
+}
+
+void MemoryCache::fill(const mcd_tx_st &fill, uint64_t ticket)
+{
+    if (ticket != this->version || !this->valid() ||
+        fill.num_bytes_ok != fill.num_bytes ||
+        fill.num_bytes / PAGE_SIZE > this->capacity) {
+        return;
+    }
+
+    for (uint32_t offset = 0; offset < fill.num_bytes; offset += PAGE_SIZE) {
+        const Key key{fill.addr.mem_space_id, fill.addr.address + offset};
+        auto [it, inserted]{this->pages.try_emplace(key)};
+        Page &p{it->second};
+        if (inserted) {
+            this->lru.push_front(key);
+            p.use = this->lru.begin();
+        } else {
+            this->lru.splice(this->lru.begin(), this->lru, p.use);
+        }
+        p.data.assign(fill.data + offset, fill.data + offset + PAGE_SIZE);
+    }
+
+    while (this->pages.size() > this->capacity) {
+        this->pages.erase(this->lru.back());
+        this->lru.pop_back();
+    }
+}
+
+void MemoryCache::fill_failed(const mcd_tx_st &fill, uint64_t client_end)
+{
+    auto it{this->spaces.find(fill.addr.mem_space_id)};
+    if (it == this->spaces.end()) {
+        return;
+    }
+
+    /* without a partial transfer, blame the pages read ahead first */
+    uint64_t end{fill.addr.address + fill.num_bytes_ok -
+                 fill.num_bytes_ok % PAGE_SIZE};
+    const uint64_t client_last{client_end +
+                               (PAGE_SIZE - client_end % PAGE_SIZE) %
+                                   PAGE_SIZE};
+    if (end < client_last &&
+        fill.addr.address + fill.num_bytes > client_last) {
+        end = client_last;
+    }
+
+    Space &space{it->second};
+    space.fill_end = std::min(space.fill_end, end);
+    this->read_ahead = 0;
+}
+
+void MemoryCache::write(const mcd_tx_st &tx)
+{
+    if (tx.access_type == MCD_TX_AT_R ||
+        std::find(this->register_spaces.begin(), this->register_spaces.end(),
+                  tx.addr.mem_space_id) != this->register_spaces.end()) {
+        return;
+    }
+
+    /* writes through other memory spaces might alias the cached memory */
+    if (!this->spaces.contains(tx.addr.mem_space_id) ||
+        (tx.options & MCD_TX_OPT_NOINCREMENT)) {
+        this->drop_values();
+        return;
+    }
+
+    const uint64_t begin{tx.addr.address};
+    const uint64_t end{begin + tx.num_bytes};
+    for (auto it{this->pages.begin()}; it != this->pages.end();) {
+        const auto &[id, page]{it->first};
+        if (id != tx.addr.mem_space_id ||
+            (page < end && begin < page + PAGE_SIZE)) {
+            this->lru.erase(it->second.use);
+            it = this->pages.erase(it);
+        } else {
+            it++;
+        }
+    }
+    this->expire_tickets();
+}
+
+WriteBuffer::WriteBuffer()
+    : capacity{0}, size{0}, deferred{0}, combined{0}, flushes{0}
+{
+}
+
+void WriteBuffer::set_capacity(uint32_t bytes) { this->capacity = bytes; }
+
+uint32_t WriteBuffer::get_capacity() const { return this->capacity; }
+
+bool WriteBuffer::empty() const { return this->runs.empty(); }
+
+void WriteBuffer::set_memory_spaces(
+    const std::vector<mcd_memspace_st> &mem_spaces)
+{
+    this->register_spaces.clear();
+    for (const mcd_memspace_st &ms : mem_spaces) {
+        if (ms.mem_type & MCD_MEM_SPACE_IS_REGISTERS) {
+            this->register_spaces.push_back(ms.mem_space_id);
+        }
+    }
+}
+
+bool WriteBuffer::is_register_space(uint32_t mem_space_id) const
+{
+    return std::find(this->register_spaces.begin(),
+                     this->register_spaces.end(),
+                     mem_space_id) != this->register_spaces.end();
+}
+
+/* Whether the writes of a and b can be combined */
+static bool same_write_attributes(const mcd_tx_st &a, const mcd_tx_st &b)
+{
+    return a.addr.mem_space_id == b.addr.mem_space_id &&
+           a.addr.addr_space_id == b.addr.addr_space_id &&
+           a.addr.addr_space_type == b.addr.addr_space_type &&
+           a.options == b.options && a.access_width == b.access_width &&
+           a.core_mode == b.core_mode;
+}
+
+bool WriteBuffer::deferrable(const mcd_tx_st &tx, bool chained) const
+{
+    const uint64_t end{tx.addr.address + tx.num_bytes};
+    return this->capacity > 0 && tx.access_type == MCD_TX_AT_W &&
+           tx.num_bytes > 0 && tx.num_bytes <= this->capacity &&
+           end > tx.addr.address && !chained &&
+           !(tx.options & (MCD_TX_OPT_SIDE_EFFECTS | MCD_TX_OPT_NOINCREMENT |
+                           MCD_TX_OPT_ATOMIC_WITH_NEXT)) &&
+           (tx.access_width <= 1 || tx.num_bytes % tx.access_width == 0);
+}
+
+bool WriteBuffer::conflicts(const mcd_tx_st &tx, bool chained) const
+{
+    if (this->runs.empty()) {
+        return false;
+    }
+
+    /* the pending writes must not be reordered with an atomic chain */
+    const bool write{tx.access_type != MCD_TX_AT_R};
+    if ((tx.options &
+         (MCD_TX_OPT_SIDE_EFFECTS | MCD_TX_OPT_ATOMIC_WITH_NEXT)) ||
+        chained ||
+        (write && (!this->deferrable(tx, chained) ||
+                   tx.num_bytes > this->capacity - this->size))) {
+        return true;
+    }
+
+    const bool registers{this->is_register_space(tx.addr.mem_space_id)};
+    const uint64_t begin{tx.addr.address};
+    const uint64_t end{begin + tx.num_bytes};
+    for (const Run &r : this->runs) {
+        const uint64_t r_begin{r.tx.addr.address};
+        const uint64_t r_end{r_begin + r.data.size()};
+
+        if (r.tx.addr.mem_space_id != tx.addr.mem_space_id) {
+            /* different memory spaces might alias the same memory */
+            if (!registers &&
+                !this->is_register_space(r.tx.addr.mem_space_id)) {
+                return true;
+            }
+            continue;
+        }
+
+        const bool overlap{begin < r_end && r_begin < end};
+        const bool touches{begin <= r_end && r_begin <= end};
+        const uint64_t distance{begin > r_begin ? begin - r_begin
+                                                : r_begin - begin};
+        if (!write) {
+            if (overlap) {
+                return true;
+            }
+        } else if (!same_write_attributes(tx, r.tx)) {
+            if (touches) {
+                return true;
+            }
+        } else if (registers) {
+            /* registers might be written as a whole only */
+            if (overlap && (begin != r_begin || end != r_end)) {
+                return true;
+            }
+        } else if (touches && tx.access_width > 1 &&
+                   distance % tx.access_width != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void WriteBuffer::add(const mcd_tx_st &tx)
+{
+    const bool registers{this->is_register_space(tx.addr.mem_space_id)};
+    uint64_t begin{tx.addr.address};
+    uint64_t end{begin + tx.num_bytes};
+    std::vector<uint8_t> data(tx.data, tx.data + tx.num_bytes);
+
+    /*
+     * Absorb the pending runs which the write overlaps or extends. They do
+     * not touch each other, and the write is newer than all of them.
+     */
+    size_t position{this->runs.size()};
+    for (size_t i = 0; i < this->runs.size();) {
+        Run &r{this->runs[i]};
+        const uint64_t r_begin{r.tx.addr.address};
+        const uint64_t r_end{r_begin + r.data.size()};
+        const bool touches{registers ? begin == r_begin && end == r_end
+                                     : begin <= r_end && r_begin <= end};
+        if (!same_write_attributes(tx, r.tx) || !touches) {
+            i++;
+            continue;
+        }
+
+        const uint64_t new_begin{std::min(begin, r_begin)};
+        const uint64_t new_end{std::max(end, r_end)};
+        std::vector<uint8_t> merged(new_end - new_begin);
+        std::copy(r.data.begin(), r.data.end(),
+                  merged.begin() + (r_begin - new_begin));
+        std::copy(data.begin(), data.end(),
+                  merged.begin() + (begin - new_begin));
+        begin = new_begin;
+        end = new_end;
+        data = std::move(merged);
+
+        this->size -= (uint32_t)r.data.size();
+        this->combined++;
+        position = std::min(position, i);
+        this->runs.erase(this->runs.begin() + i);
+    }
+
+    Run run{.tx{tx}, .data{std::move(data)}};
+    run.tx.addr.address = begin;
+    run.tx.data = nullptr;
+    run.tx.num_bytes = (uint32_t)(end - begin);
+    run.tx.num_bytes_ok = 0;
+    this->size += run.tx.num_bytes;
+    this->runs.insert(this->runs.begin() + position, std::move(run));
+    this->deferred++;
+}
+
+void WriteBuffer::take(std::vector<mcd_tx_st> &tx,
+                       std::vector<std::vector<uint8_t>> &data)
+{
+    tx.clear();
+    data.clear();
+    if (this->runs.empty()) {
+        return;
+    }
+
+    data.reserve(this->runs.size());
+    for (Run &r : this->runs) {
+        data.push_back(std::move(r.data));
+        tx.push_back(r.tx);
+        tx.back().data = data.back().data();
+    }
+    this->runs.clear();
+    this->size = 0;
+    this->flushes++;
+}
+
 Core::Core(const mcd_core_con_info_st &info, uint32_t core_uid)
     : info{info}, core_uid{core_uid}, updated{false}
 {
@@ -259,12 +855,38 @@ mcd_return_et Core::update_core_database(mcd_error_info_st &mcd_error)
         return mcd_error.return_status;
     }
 
+    std::vector<mcd_register_info_st> registers;
+    for (const RegGroup &rg : this->client_register_groups) {
+        registers.insert(registers.end(), rg.registers.begin(),
+                         rg.registers.end());
+    }
+    this->register_cache.set_registers(registers);
+
+    std::vector<mcd_memspace_st> mem_spaces;
+    for (const MemorySpace &ms : this->client_memory_spaces) {
+        mem_spaces.push_back(ms.info);
+    }
+    this->memory_cache.set_memory_spaces(mem_spaces, registers);
+    this->write_buffer.set_memory_spaces(mem_spaces);
+
     this->updated = true;
     return MCD_RET_ACT_NONE;
 }
 
 bool Core::core_database_updated() const { return this->updated; }
 
+void Core::set_halted(uint64_t since)
+{
+    this->register_cache.set_halted(since);
+    this->memory_cache.set_halted(since);
+}
+
+void Core::invalidate_caches()
+{
+    this->register_cache.invalidate();
+    this->memory_cache.invalidate();
+}
+
 mcd_return_et Core::query_mem_spaces(uint32_t start_index,
                                      uint32_t *num_mem_spaces,
                                      mcd_memspace_st *mem_spaces,
@@ -452,4 +1074,16 @@ mcd_return_et Core::convert_address_to_server(mcd_addr_st &addr,
     if (tx_adapter) {
         return tx_adapter->convert_address_to_server(addr, error);
     }
-}
\ No newline at end of file
+
+    return MCD_RET_ACT_NONE;
+}
+
+const mcd_memspace_st *Core::find_memory_space(uint32_t mem_space_id) const
+{
+    for (const MemorySpace &ms : this->client_memory_spaces) {
+        if (ms.info.mem_space_id == mem_space_id) {
+            return &ms.info;
+        }
+    }
+    return nullptr;
+}
@@ -22,6 +22,9 @@
  * SOFTWARE.
  */
 
+#include <cstring>
+#include <sstream>
+
 #include "comm.hpp"
 
 mcd_exception::mcd_exception(const mcd_error_info_st &error_info)
@@ -31,15 +34,187 @@ mcd_exception::mcd_exception(const mcd_error_info_st &error_info)
 
 const char *mcd_exception::what() { return error_info.error_str; }
 
+static mcd_return_et config_string_error(const char *error_str,
+                                         mcd_error_info_st &error)
+{
+    error = {
+        .return_status{MCD_RET_ACT_HANDLE_ERROR},
+        .error_code{MCD_ERR_PARAM},
+        .error_events{MCD_ERR_EVT_NONE},
+        .error_str{""},
+    };
+    snprintf(error.error_str, MCD_INFO_STR_LEN,
+             "ill-formed config_string, %s", error_str);
+    return error.return_status;
+}
+
+mcd_return_et MCDServerConfig::Parse(const std::string &config_string,
+                                     MCDServerConfig &config,
+                                     mcd_error_info_st &error)
+{
+    MCDServerConfig c{};
+    bool has_address{false};
+
+    std::istringstream tokens{config_string};
+    std::string token;
+    while (tokens >> token) {
+        size_t i{token.find_first_of('=')};
+        if (i == std::string::npos && token.starts_with("unix:")) {
+            /* expected format: unix:<path> */
+            if (has_address || token.size() == 5) {
+                return config_string_error("expected: unix:<path>", error);
+            }
+            c.socket_path = token.substr(5);
+            has_address = true;
+            continue;
+        } else if (i == std::string::npos) {
+            /* expected format: <hostname>:<port> */
+            i = token.find_first_of(':');
+            if (has_address || i == 0 || i == std::string::npos ||
+                i != token.find_last_of(':')) {
+                return config_string_error("expected: <hostname>:<port>",
+                                           error);
+            }
+            c.host = {token, 0, i};
+            try {
+                c.port = std::stoi(token.substr(i + 1));
+            } catch (std::exception const &) {
+                return config_string_error("expected: <hostname>:<port>",
+                                           error);
+            }
+            has_address = true;
+            continue;
+        }
+
+        std::string key{token, 0, i};
+        std::string value{token, i + 1, std::string::npos};
+        if (key == "window") {
+            unsigned long window;
+            try {
+                window = std::stoul(value);
+            } catch (std::exception const &) {
+                window = 0;
+            }
+            if (window == 0 || window > UINT32_MAX) {
+                return config_string_error("expected: window=<n> with n > 0",
+                                           error);
+            }
+            c.window = (uint32_t)window;
+        } else if (key == "transport") {
+            if (value != "socket" && value != "shm") {
+                return config_string_error(
+                    "expected: transport=socket or transport=shm", error);
+            }
+            c.shared_memory = value == "shm";
+        } else if (key == "timeout") {
+            unsigned long timeout_ms;
+            try {
+                timeout_ms = std::stoul(value);
+            } catch (std::exception const &) {
+                timeout_ms = 0;
+            }
+            if (timeout_ms == 0 || timeout_ms > INT32_MAX) {
+                return config_string_error(
+                    "expected: timeout=<milliseconds> with milliseconds > 0",
+                    error);
+            }
+            c.timeout_ms = (uint32_t)timeout_ms;
+        } else if (key == "cache") {
+            unsigned long cache_pages;
+            try {
+                cache_pages = std::stoul(value);
+            } catch (std::exception const &) {
+                cache_pages = UINT32_MAX + 1ul;
+            }
+            if (cache_pages > UINT32_MAX) {
+                return config_string_error("expected: cache=<pages>", error);
+            }
+            c.cache_pages = (uint32_t)cache_pages;
+        } else if (key == "cache_fill") {
+            std::istringstream ids{value};
+            std::string id;
+            c.cache_fill.clear();
+            while (std::getline(ids, id, ',')) {
+                unsigned long mem_space_id;
+                try {
+                    mem_space_id = std::stoul(id);
+                } catch (std::exception const &) {
+                    mem_space_id = UINT32_MAX + 1ul;
+                }
+                if (mem_space_id > UINT32_MAX) {
+                    return config_string_error(
+                        "expected: cache_fill=<mem space id>[,<id>...]",
+                        error);
+                }
+                c.cache_fill.push_back((uint32_t)mem_space_id);
+            }
+        } else if (key == "write_buffer") {
+            unsigned long write_buffer;
+            try {
+                write_buffer = std::stoul(value);
+            } catch (std::exception const &) {
+                write_buffer = UINT32_MAX + 1ul;
+            }
+            if (write_buffer > UINT32_MAX) {
+                return config_string_error("expected: write_buffer=<bytes>",
+                                           error);
+            }
+            c.write_buffer = (uint32_t)write_buffer;
+        } else if (key == "encoding") {
+            /* negotiated with the server by the RPC marshalling */
+            if (value != "fixed" && value != "varint") {
+                return config_string_error(
+                    "expected: encoding=fixed or encoding=varint", error);
+            }
+        } else if (key == "dispatch") {
+            /* negotiated with the server by the RPC marshalling */
+            if (value != "order" && value != "id") {
+                return config_string_error(
+                    "expected: dispatch=order or dispatch=id", error);
+            }
+        } else if (key == "data") {
+            /* negotiated with the server by the QMP marshalling */
+            if (value != "array" && value != "hex" && value != "base64") {
+                return config_string_error(
+                    "expected: data=array, data=hex or data=base64", error);
+            }
+        } else if (key == "format") {
+            /* negotiated with the server by the QMP marshalling */
+            if (value != "json" && value != "cbor" && value != "msgpack") {
+                return config_string_error(
+                    "expected: format=json, format=cbor or format=msgpack",
+                    error);
+            }
+        } else {
+            return config_string_error("unknown key", error);
+        }
+    }
+
+#if defined(__linux__)
+    /* the shared memory is passed to the server as file descriptor */
+    if (c.shared_memory && c.socket_path.empty()) {
+        return config_string_error("transport=shm requires unix:<path>",
+                                   error);
+    }
+#else
+    if (c.shared_memory) {
+        return config_string_error("transport=shm is not supported", error);
+    }
+#endif
+
+    config = c;
+    return MCD_RET_ACT_NONE;
+}
+
 #if defined(WIN32)
-int MCDServer::winsock_connections{0};
+int SocketTransport::winsock_connections{0};
 #endif
 
-MCDServer::MCDServer(const std::string &host, int port)
-    : host{host}, port{port}, msg_buf{buf}
+SocketTransport::SocketTransport(const MCDServerConfig &config)
+    : config{config}, socket_fd{0}, connected{false}
 {
 #if defined(WIN32)
-    if (MCDServer::winsock_connections == 0) {
+    if (SocketTransport::winsock_connections == 0) {
         WSADATA d;
         if (WSAStartup(MAKEWORD(2, 2), &d)) {
             throw mcd_exception{mcd_error_info_st{
@@ -50,80 +225,95 @@ MCDServer::MCDServer(const std::string &host, int port)
             }};
         }
     }
+    SocketTransport::winsock_connections++;
 #endif
+}
 
-    this->socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (!ISVALIDSOCKET(this->socket_fd)) {
+SocketTransport::~SocketTransport()
+{
+    this->disconnect();
 #if defined(WIN32)
-        if (MCDServer::winsock_connections == 0) {
-            WSACleanup();
-        }
+    winsock_connections--;
+    if (SocketTransport::winsock_connections <= 0) {
+        SocketTransport::winsock_connections = 0;
+        WSACleanup();
+    }
+#endif
+}
+
+mcd_return_et SocketTransport::create_socket(mcd_error_info_st &error)
+{
+#if defined(WIN32)
+    if (!this->config.socket_path.empty()) {
+        this->socket_fd = 0;
+        error = {
+            .return_status{MCD_RET_ACT_HANDLE_ERROR},
+            .error_code{MCD_ERR_CONNECTION},
+            .error_events{MCD_ERR_EVT_NONE},
+            .error_str{"UNIX domain sockets are not supported"},
+        };
+        return error.return_status;
+    }
+    this->socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+#else
+    this->socket_fd =
+        socket(this->config.socket_path.empty() ? AF_INET : AF_UNIX,
+               SOCK_STREAM, 0);
 #endif
-        throw mcd_exception{mcd_error_info_st{
+    if (!ISVALIDSOCKET(this->socket_fd)) {
+        this->socket_fd = 0;
+        error = {
             .return_status{MCD_RET_ACT_HANDLE_ERROR},
             .error_code{MCD_ERR_CONNECTION},
             .error_events{MCD_ERR_EVT_NONE},
             .error_str{"socket creation failed"},
-        }};
+        };
+        return error.return_status;
     }
 
-#if defined(WIN32)
-    MCDServer::winsock_connections++;
-#endif
+    return MCD_RET_ACT_NONE;
 }
 
-MCDServer::MCDServer(MCDServer &&other)
-    : msg_buf{this->buf},
-      socket_fd{other.socket_fd},
-      connected{other.connected},
-      host{other.host},
-      port{other.port}
-{
-    other.socket_fd = 0;
-    other.connected = false;
-}
+bool SocketTransport::is_connected() const { return this->connected; }
 
-MCDServer::~MCDServer()
+void SocketTransport::disconnect()
 {
     if (this->socket_fd) {
         shutdown(this->socket_fd, SHUTDOWN_ALL);
         CLOSESOCKET(this->socket_fd);
-#if defined(WIN32)
-        winsock_connections--;
-        if (MCDServer::winsock_connections <= 0) {
-            MCDServer::winsock_connections = 0;
-            WSACleanup();
-        }
-#endif
+        this->socket_fd = 0;
     }
+    this->connected = false;
 }
 
-MCDServer &MCDServer::operator=(MCDServer &&other)
+mcd_return_et SocketTransport::connect(mcd_error_info_st &error)
 {
-    socket_fd = other.socket_fd;
-    connected = other.connected;
-    host = other.host;
-    port = other.port;
-    other.socket_fd = 0;
-    other.connected = false;
-    other.host.clear();
-    other.port = 0;
-    return *this;
-}
+    if (this->connected) {
+        return MCD_RET_ACT_NONE;
+    }
 
-MCDServer MCDServer::Open(const std::string &host, int port)
-{
-    MCDServer server{host, port};
-    mcd_error_info_st error;
+    /* a lost connection is replaced by a new socket */
+    this->disconnect();
+    if (this->create_socket(error) != MCD_RET_ACT_NONE) {
+        return error.return_status;
+    }
 
-    if (server.connect_to_target(error) != MCD_RET_ACT_NONE) {
-        throw mcd_exception{error};
+    mcd_return_et ret{this->config.socket_path.empty()
+                          ? this->connect_tcp(error)
+                          : this->connect_unix(error)};
+
+    if (ret != MCD_RET_ACT_NONE) {
+        /* a socket cannot be connected again after a failed attempt */
+        CLOSESOCKET(this->socket_fd);
+        this->socket_fd = 0;
+        return ret;
     }
 
-    return server;
+    this->connected = true;
+    return MCD_RET_ACT_NONE;
 }
 
-mcd_return_et MCDServer::connect_to_target(mcd_error_info_st &error)
+mcd_return_et SocketTransport::connect_tcp(mcd_error_info_st &error)
 {
     struct addrinfo *servinfo, *a;
     struct addrinfo hints{
@@ -131,9 +321,9 @@ mcd_return_et MCDServer::connect_to_target(mcd_error_info_st &error)
         .ai_socktype{SOCK_STREAM},
     };
 
-    std::string port_s{std::to_string(this->port)};
-    int gai_ret{
-        getaddrinfo(this->host.c_str(), port_s.c_str(), &hints, &servinfo)};
+    std::string port_s{std::to_string(this->config.port)};
+    int gai_ret{getaddrinfo(this->config.host.c_str(), port_s.c_str(), &hints,
+                            &servinfo)};
     if (gai_ret != 0) {
         error = {
             .return_status{MCD_RET_ACT_HANDLE_ERROR},
@@ -147,7 +337,7 @@ mcd_return_et MCDServer::connect_to_target(mcd_error_info_st &error)
     }
 
     for (a = servinfo; a; a = a->ai_next) {
-        if (connect(this->socket_fd, a->ai_addr, (int)a->ai_addrlen) != 0) {
+        if (::connect(this->socket_fd, a->ai_addr, (int)a->ai_addrlen) != 0) {
             error = {
                 .return_status{MCD_RET_ACT_HANDLE_ERROR},
                 .error_code{MCD_ERR_CONNECTION},
@@ -168,46 +358,56 @@ mcd_return_et MCDServer::connect_to_target(mcd_error_info_st &error)
         return error.return_status;
     }
 
-    this->connected = true;
     return MCD_RET_ACT_NONE;
 }
 
-mcd_return_et MCDServer::send_message(uint32_t request_size,
-                                      mcd_error_info_st &error)
+mcd_return_et SocketTransport::connect_unix(mcd_error_info_st &error)
 {
-    if (!this->connected) {
-        if (this->socket_fd) {
-            CLOSESOCKET(this->socket_fd);
-        }
+#if defined(WIN32)
+    error = {
+        .return_status{MCD_RET_ACT_HANDLE_ERROR},
+        .error_code{MCD_ERR_CONNECTION},
+        .error_events{MCD_ERR_EVT_NONE},
+        .error_str{"UNIX domain sockets are not supported"},
+    };
+    return error.return_status;
+#else
+    struct sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
 
-        this->socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-        if (!ISVALIDSOCKET(this->socket_fd)) {
-            this->socket_fd = 0;
-            error = {mcd_error_info_st{
-                .return_status{MCD_RET_ACT_HANDLE_ERROR},
-                .error_code{MCD_ERR_CONNECTION},
-                .error_events{MCD_ERR_EVT_NONE},
-                .error_str{"socket creation failed while reconnecting"},
-            }};
-            return error.return_status;
-        }
+    if (this->config.socket_path.size() >= sizeof(addr.sun_path)) {
+        error = {
+            .return_status{MCD_RET_ACT_HANDLE_ERROR},
+            .error_code{MCD_ERR_PARAM},
+            .error_events{MCD_ERR_EVT_NONE},
+            .error_str{"UNIX domain socket path too long"},
+        };
+        return error.return_status;
+    }
+    this->config.socket_path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
 
-        int optval{TRUE};
-        setsockopt(this->socket_fd, SOL_SOCKET, SO_REUSEADDR, (char *)&optval,
-                   sizeof(int));
-        if (this->connect_to_target(error) != MCD_RET_ACT_NONE) {
-            error = {
-                .return_status{MCD_RET_ACT_HANDLE_ERROR},
-                .error_code{MCD_ERR_CONNECTION},
-                .error_events{MCD_ERR_EVT_NONE},
-                .error_str{"server reconnection failed"},
-            };
-            return error.return_status;
+    if (::connect(this->socket_fd, (struct sockaddr *)&addr, sizeof(addr)) !=
+        0) {
+        error = {
+            .return_status{MCD_RET_ACT_HANDLE_ERROR},
+            .error_code{MCD_ERR_CONNECTION},
+            .error_events{MCD_ERR_EVT_NONE},
+            .error_str{},
         };
+        snprintf(error.error_str, MCD_INFO_STR_LEN,
+                 "UNIX domain socket connection failed (%d)",
+                 GETSOCKETERRNO());
+        return error.return_status;
     }
 
-    if (send(this->socket_fd, (char *)this->buf, (int)request_size, 0) ==
-        SOCKET_ERROR) {
+    return MCD_RET_ACT_NONE;
+#endif
+}
+
+mcd_return_et SocketTransport::send(const char *data, uint32_t len,
+                                    mcd_error_info_st &error)
+{
+    if (::send(this->socket_fd, data, (int)len, 0) == SOCKET_ERROR) {
         this->connected = false;
         error = {
             .return_status{MCD_RET_ACT_HANDLE_EVENT},
@@ -220,3 +420,142 @@ mcd_return_et MCDServer::send_message(uint32_t request_size,
 
     return MCD_RET_ACT_NONE;
 }
+
+std::vector<SOCKET> SocketTransport::wait_handles() const
+{
+    return {this->socket_fd};
+}
+
+mcd_return_et SocketTransport::receive(char *data, uint32_t capacity,
+                                       uint32_t &num_bytes,
+                                       mcd_error_info_st &error)
+{
+#if defined(WIN32)
+    /* only called when the socket is readable, so recv does not block */
+    long int ret{recv(this->socket_fd, data, (int)capacity, 0)};
+#else
+    long int ret{recv(this->socket_fd, data, capacity, MSG_DONTWAIT)};
+    if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        num_bytes = 0;
+        return MCD_RET_ACT_NONE;
+    }
+#endif
+
+    if (ret == 0) {
+        this->connected = false;
+        error = {
+            .return_status{MCD_RET_ACT_HANDLE_EVENT},
+            .error_code{MCD_ERR_CONNECTION},
+            .error_events{MCD_ERR_EVT_PWRDN},
+            .error_str{"receiving response failed (connection closed)"},
+        };
+        return error.return_status;
+    } else if (ret < 0) {
+        this->connected = false;
+        error = {
+            .return_status{MCD_RET_ACT_HANDLE_EVENT},
+            .error_code{MCD_ERR_CONNECTION},
+            .error_events{MCD_ERR_EVT_NONE},
+            .error_str{""},
+        };
+        snprintf(error.error_str, MCD_INFO_STR_LEN,
+                 "receiving response failed (%d)", GETSOCKETERRNO());
+        return error.return_status;
+    }
+
+    num_bytes = (uint32_t)ret;
+    return MCD_RET_ACT_NONE;
+}
+
+static std::unique_ptr<Transport> create_transport(
+    const MCDServerConfig &config)
+{
+#if defined(__linux__)
+    if (config.shared_memory) {
+        return std::make_unique<ShmTransport>(config);
+    }
+#endif
+    return std::make_unique<SocketTransport>(config);
+}
+
+MCDServer::MCDServer(const MCDServerConfig &config)
+    : config{config},
+      transport{create_transport(config)},
+      io{std::make_unique<IoThread>(*this->transport)},
+      request_ids{0}
+{
+}
+
+MCDServer::MCDServer(MCDServer &&other)
+    : config{other.config},
+      transport{std::move(other.transport)},
+      io{std::move(other.io)},
+      request_ids{other.request_ids.load()},
+      server_uid{other.server_uid}
+{
+}
+
+MCDServer &MCDServer::operator=(MCDServer &&other)
+{
+    /* the thread serving the current transport has to stop first */
+    io = std::move(other.io);
+    transport = std::move(other.transport);
+    config = other.config;
+    request_ids = other.request_ids.load();
+    server_uid = other.server_uid;
+    return *this;
+}
+
+MCDServer MCDServer::Open(const MCDServerConfig &config)
+{
+    MCDServer server{config};
+    mcd_error_info_st error;
+
+    if (server.transport->connect(error) != MCD_RET_ACT_NONE) {
+        throw mcd_exception{error};
+    }
+    server.io->start();
+
+    return server;
+}
+
+char *MCDServer::msg_buf()
+{
+    static thread_local std::vector<char> buf(MCD_MAX_PACKET_LENGTH);
+    return buf.data();
+}
+
+mcd_return_et MCDServer::send_message(uint32_t request_id,
+                                      uint32_t request_size,
+                                      mcd_error_info_st &error)
+{
+    std::lock_guard<std::mutex> lock{this->send_mutex};
+
+    if (!this->is_connected()) {
+        /* responses of the previous connection are meaningless */
+        this->io->stop();
+        this->transport->disconnect();
+        if (this->transport->connect(error) != MCD_RET_ACT_NONE) {
+            error = {
+                .return_status{MCD_RET_ACT_HANDLE_ERROR},
+                .error_code{MCD_ERR_CONNECTION},
+                .error_events{MCD_ERR_EVT_NONE},
+                .error_str{"server reconnection failed"},
+            };
+            return error.return_status;
+        }
+        this->io->start();
+    }
+
+    /* announced first, the response might arrive before send returns */
+    this->io->expect(request_id);
+    return this->transport->send(msg_buf(), request_size, error);
+}
+
+mcd_return_et MCDServer::receive_messages(uint32_t request_id,
+                                          mcd_error_info_st &error)
+{
+    return this->io->next_message(
+        request_id, msg_buf(),
+        std::chrono::milliseconds(this->config.timeout_ms), error);
+}
@@ -0,0 +1,420 @@
+/*
+MIT License
+
+Copyright (c) 2025 Lauterbach GmbH
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#include "comm.hpp"
+
+/* period in which the thread checks for a stop without a wakeup handle */
+#define STOP_POLL_MILLISECONDS 50
+
+/* events which are kept until they are taken */
+#define MAX_QUEUED_EVENTS 64
+
+static const mcd_error_info_st IO_ERROR_STOPPED{
+    .return_status{MCD_RET_ACT_HANDLE_ERROR},
+    .error_code{MCD_ERR_CONNECTION},
+    .error_events{MCD_ERR_EVT_NONE},
+    .error_str{"connection not established"},
+};
+
+static const mcd_error_info_st IO_ERROR_REJECTED{
+    .return_status{MCD_RET_ACT_HANDLE_ERROR},
+    .error_code{MCD_ERR_GENERAL},
+    .error_events{MCD_ERR_EVT_NONE},
+    .error_str{"request rejected by the server"},
+};
+
+IoThread::IoThread(Transport &transport)
+    : transport{transport},
+      stop_requested{false},
+      alive{false},
+      failure{IO_ERROR_STOPPED},
+      rx_buf(2 * MCD_MAX_PACKET_LENGTH),
+      rx_begin{0},
+      rx_end{0},
+      rx_scanned{0},
+      rx_overflow{false}
+{
+#if defined(__linux__)
+    this->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (this->wake_fd < 0) {
+        throw mcd_exception{mcd_error_info_st{
+            .return_status{MCD_RET_ACT_HANDLE_ERROR},
+            .error_code{MCD_ERR_GENERAL},
+            .error_events{MCD_ERR_EVT_NONE},
+            .error_str{"eventfd creation failed"},
+        }};
+    }
+#endif
+}
+
+IoThread::~IoThread()
+{
+    this->stop();
+#if defined(__linux__)
+    close(this->wake_fd);
+#endif
+}
+
+void IoThread::start()
+{
+    this->stop();
+
+    this->rx_begin = 0;
+    this->rx_end = 0;
+    this->rx_scanned = 0;
+    this->rx_overflow = false;
+    this->stop_requested = false;
+
+    {
+        /* requests of the previous connection will never be answered */
+        std::lock_guard<std::mutex> lock{this->mutex};
+        this->requests.clear();
+        this->events.clear();
+        this->failure = IO_ERROR_STOPPED;
+        this->alive = true;
+        this->completed.notify_all();
+    }
+
+    this->thread = std::thread{&IoThread::run, this};
+}
+
+void IoThread::stop()
+{
+    if (this->thread.joinable()) {
+        this->stop_requested = true;
+        this->wake();
+        this->thread.join();
+    }
+    this->fail(IO_ERROR_STOPPED);
+}
+
+void IoThread::wake()
+{
+#if defined(__linux__)
+    uint64_t one{1};
+    (void)!write(this->wake_fd, &one, sizeof(one));
+#endif
+}
+
+void IoThread::run()
+{
+    std::vector<SOCKET> handles{this->transport.wait_handles()};
+    int epoll_fd{-1};
+
+#if defined(__linux__)
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        this->fail({
+            .return_status{MCD_RET_ACT_HANDLE_ERROR},
+            .error_code{MCD_ERR_GENERAL},
+            .error_events{MCD_ERR_EVT_NONE},
+            .error_str{"epoll creation failed"},
+        });
+        return;
+    }
+    handles.push_back(this->wake_fd);
+    for (SOCKET handle : handles) {
+        struct epoll_event event{
+            .events{EPOLLIN},
+            .data{.fd{handle}},
+        };
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, handle, &event);
+    }
+#endif
+
+    mcd_error_info_st error;
+    std::vector<char> message{this->take_buffer()};
+    while (!this->stop_requested && this->alive) {
+        if (this->transport.prepare_wait(this->response_pending())) {
+            this->wait_readable(handles, epoll_fd);
+            this->transport.finish_wait();
+        }
+        if (this->stop_requested) {
+            break;
+        }
+
+        if (this->receive_bytes(error) != MCD_RET_ACT_NONE) {
+            this->fail(error);
+            break;
+        }
+
+        for (;;) {
+            Framing framing{this->extract_message(message, error)};
+            if (framing == Framing::INCOMPLETE) {
+                break;
+            } else if (framing == Framing::MESSAGE) {
+                this->complete(std::move(message), MCD_RET_ACT_NONE, {});
+                message = this->take_buffer();
+            } else if (framing == Framing::DISCARDED) {
+                this->complete({}, error.return_status, error);
+            } else {
+                this->fail(error);
+                break;
+            }
+        }
+    }
+
+#if defined(__linux__)
+    close(epoll_fd);
+#endif
+}
+
+void IoThread::wait_readable(const std::vector<SOCKET> &handles, int epoll_fd)
+{
+#if defined(__linux__)
+    (void)handles;
+    struct epoll_event events[4];
+    int num_events{epoll_wait(epoll_fd, events, 4, -1)};
+    for (int i{0}; i < num_events; i++) {
+        if (events[i].data.fd == this->wake_fd) {
+            uint64_t count;
+            (void)!read(this->wake_fd, &count, sizeof(count));
+        }
+    }
+#else
+    (void)epoll_fd;
+    fd_set readfds;
+    struct timeval tv{
+        .tv_sec{0},
+        .tv_usec{STOP_POLL_MILLISECONDS * 1000},
+    };
+    FD_ZERO(&readfds);
+    SOCKET max_handle{0};
+    for (SOCKET handle : handles) {
+        FD_SET(handle, &readfds);
+        if (handle > max_handle) {
+            max_handle = handle;
+        }
+    }
+    select((int)max_handle + 1, &readfds, NULL, NULL, &tv);
+#endif
+}
+
+mcd_return_et IoThread::receive_bytes(mcd_error_info_st &error)
+{
+    /* discard framed bytes if the remaining space cannot hold a packet */
+    if (this->rx_buf.size() - this->rx_end < MCD_MAX_PACKET_LENGTH) {
+        memmove(this->rx_buf.data(), this->rx_buf.data() + this->rx_begin,
+                this->rx_end - this->rx_begin);
+        this->rx_end -= this->rx_begin;
+        this->rx_begin = 0;
+    }
+
+    uint32_t num_bytes;
+    if (this->transport.receive(this->rx_buf.data() + this->rx_end,
+                                (uint32_t)this->rx_buf.size() - this->rx_end,
+                                num_bytes, error) != MCD_RET_ACT_NONE) {
+        return error.return_status;
+    }
+
+    this->rx_end += num_bytes;
+    return MCD_RET_ACT_NONE;
+}
+
+std::vector<char> IoThread::take_buffer()
+{
+    std::lock_guard<std::mutex> lock{this->mutex};
+    if (this->spare.empty()) {
+        return {};
+    }
+    std::vector<char> buffer{std::move(this->spare.back())};
+    this->spare.pop_back();
+    return buffer;
+}
+
+/* Whether any announced request still awaits its response */
+bool IoThread::response_pending()
+{
+    std::lock_guard<std::mutex> lock{this->mutex};
+    return std::any_of(this->requests.begin(), this->requests.end(),
+                       [](const Request &request) {
+                           return !request.completed;
+                       });
+}
+
+std::deque<IoThread::Request>::iterator IoThread::find_request(
+    uint32_t request_id)
+{
+    return std::find_if(this->requests.begin(), this->requests.end(),
+                        [request_id](const Request &request) {
+                            return request.request_id == request_id;
+                        });
+}
+
+void IoThread::complete(std::vector<char> &&message,
+                        mcd_return_et return_status,
+                        const mcd_error_info_st &error)
+{
+    uint32_t request_id;
+    MessageKind kind{return_status == MCD_RET_ACT_NONE
+                         ? classify_message(message, request_id)
+                         : MessageKind::UNKNOWN};
+
+    std::lock_guard<std::mutex> lock{this->mutex};
+
+    if (kind == MessageKind::EVENT && this->alive) {
+        if (this->events.size() == MAX_QUEUED_EVENTS) {
+            this->spare.push_back(std::move(this->events.front()));
+            this->events.pop_front();
+        }
+        this->events.push_back(std::move(message));
+        return;
+    }
+
+    auto request{this->requests.end()};
+    if (kind == MessageKind::REPLY || kind == MessageKind::FAILURE) {
+        request = this->find_request(request_id);
+    } else if (kind == MessageKind::ORDERED_REPLY ||
+               return_status != MCD_RET_ACT_NONE) {
+        /*
+         * The server answers in the order of the requests. A discarded
+         * message cannot be identified either, it is reported to the oldest
+         * request which is still waiting.
+         */
+        request = std::find_if(
+            this->requests.begin(), this->requests.end(),
+            [](const Request &r) { return !r.completed; });
+    }
+
+    if (!this->alive || request == this->requests.end() ||
+        request->completed) {
+        /* no response, e.g. a greeting or a late duplicate */
+        if (message.capacity() > 0) {
+            this->spare.push_back(std::move(message));
+        }
+        return;
+    }
+
+    request->completed = true;
+    if (kind == MessageKind::FAILURE) {
+        /* the message is not a result, so it is not handed out */
+        this->spare.push_back(std::move(message));
+        request->completion = {
+            .message{},
+            .return_status{IO_ERROR_REJECTED.return_status},
+            .error{IO_ERROR_REJECTED},
+        };
+    } else {
+        request->completion = {
+            .message{std::move(message)},
+            .return_status{return_status},
+            .error{error},
+        };
+    }
+    this->completed.notify_all();
+}
+
+void IoThread::fail(const mcd_error_info_st &error)
+{
+    std::lock_guard<std::mutex> lock{this->mutex};
+    if (!this->alive) {
+        return;
+    }
+    this->failure = error;
+    this->alive = false;
+    this->completed.notify_all();
+}
+
+void IoThread::expect(uint32_t request_id)
+{
+    std::lock_guard<std::mutex> lock{this->mutex};
+    this->requests.push_back({
+        .request_id{request_id},
+        .completed{false},
+        .completion{},
+    });
+}
+
+mcd_return_et IoThread::next_message(uint32_t request_id, char *dst,
+                                     std::chrono::milliseconds timeout,
+                                     mcd_error_info_st &error)
+{
+    std::unique_lock<std::mutex> lock{this->mutex};
+
+    /* the request is dropped when the thread is started again */
+    bool ready{this->completed.wait_for(lock, timeout, [this, request_id] {
+        auto request{this->find_request(request_id)};
+        return request == this->requests.end() || request->completed ||
+               !this->alive;
+    })};
+
+    auto request{this->find_request(request_id)};
+
+    if (!ready) {
+        this->failure = {
+            .return_status{MCD_RET_ACT_HANDLE_ERROR},
+            .error_code{MCD_ERR_TIMED_OUT},
+            .error_events{MCD_ERR_EVT_NONE},
+            .error_str{"receiving response failed (timeout)"},
+        };
+        this->alive = false;
+        this->stop_requested = true;
+        this->wake();
+        this->completed.notify_all();
+    }
+
+    if (request == this->requests.end()) {
+        error = this->alive ? IO_ERROR_STOPPED : this->failure;
+        return error.return_status;
+    }
+
+    if (!request->completed) {
+        this->requests.erase(request);
+        error = this->failure;
+        return error.return_status;
+    }
+
+    Completion &c{request->completion};
+    mcd_return_et ret{c.return_status};
+    if (ret == MCD_RET_ACT_NONE) {
+        memcpy(dst, c.message.data(), c.message.size());
+        this->spare.push_back(std::move(c.message));
+    } else {
+        error = c.error;
+    }
+    this->requests.erase(request);
+    return ret;
+}
+
+bool IoThread::next_event(std::vector<char> &event)
+{
+    std::lock_guard<std::mutex> lock{this->mutex};
+    if (this->events.empty()) {
+        return false;
+    }
+    if (event.capacity() > 0) {
+        this->spare.push_back(std::move(event));
+    }
+    event = std::move(this->events.front());
+    this->events.pop_front();
+    return true;
+}
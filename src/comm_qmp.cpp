@@ -22,74 +22,202 @@
  * SOFTWARE.
  */
 
-#include "comm.hpp"
+#include <cstring>
+#include <string_view>
 
-#define TIMEOUT_SECONDS 5
+#include "comm.hpp"
 
-mcd_return_et MCDServer::receive_messages(mcd_error_info_st &error)
+static mcd_return_et overflow_error(mcd_error_info_st &error)
 {
-    fd_set readfds;
-    struct timeval tv{
-        .tv_sec{TIMEOUT_SECONDS},
+    error = {
+        .return_status{MCD_RET_ACT_HANDLE_EVENT},
+        .error_code{MCD_ERR_CONNECTION},
+        .error_events{MCD_ERR_EVT_NONE},
+        .error_str{"receiving response failed (overflow)"},
     };
+    return error.return_status;
+}
 
+IoThread::Framing IoThread::extract_message(std::vector<char> &message,
+                                            mcd_error_info_st &error)
+{
     static constexpr char DELIMITER = '\n';
-    uint32_t received_bytes{0};
-    do {
-        FD_ZERO(&readfds);
-        FD_SET(this->socket_fd, &readfds);
-        select((int)this->socket_fd + 1, &readfds, NULL, NULL, &tv);
-        if (!FD_ISSET(this->socket_fd, &readfds)) {
-            this->connected = false;
-            error = {
-                .return_status{MCD_RET_ACT_HANDLE_ERROR},
-                .error_code{MCD_ERR_TIMED_OUT},
-                .error_events{MCD_ERR_EVT_NONE},
-                .error_str{"receiving response failed (timeout)"},
-            };
-            return error.return_status;
+
+    /*
+     * QMP messages are single JSON lines which are handed out including a
+     * terminating '\0'. Bytes which have been searched for the delimiter
+     * before are not searched again, so a long response arriving in many
+     * segments is scanned only once. Once a binary wire format has been
+     * negotiated, messages are binary frames instead.
+     */
+    for (;;) {
+        const char *begin{this->rx_buf.data() + this->rx_begin};
+        uint32_t available{this->rx_end - this->rx_begin};
+
+        if (available > 0 && this->rx_scanned == 0 && !this->rx_overflow &&
+            qmp_frame_marker((uint8_t)begin[0])) {
+            if (available < QMP_FRAME_HEADER_SIZE) {
+                return Framing::INCOMPLETE;
+            }
+            uint32_t payload_length{qmp_frame_get_u32(begin + 1)};
+            if (payload_length >
+                MCD_MAX_PACKET_LENGTH - QMP_FRAME_HEADER_SIZE) {
+                /* without a delimiter the stream cannot be resynchronized */
+                overflow_error(error);
+                return Framing::BROKEN;
+            }
+            uint32_t length{QMP_FRAME_HEADER_SIZE + payload_length};
+            if (available < length) {
+                return Framing::INCOMPLETE;
+            }
+            message.assign(begin, begin + length);
+            this->rx_begin += length;
+            if (this->rx_begin == this->rx_end) {
+                this->rx_begin = 0;
+                this->rx_end = 0;
+            }
+            return Framing::MESSAGE;
         }
 
-        long int num_bytes{recv(this->socket_fd,
-                                (char *)this->buf + received_bytes,
-                                MCD_MAX_PACKET_LENGTH - received_bytes, 0)};
-
-        if (num_bytes == 0) {
-            this->connected = false;
-            error = {
-                .return_status{MCD_RET_ACT_HANDLE_EVENT},
-                .error_code{MCD_ERR_CONNECTION},
-                .error_events{MCD_ERR_EVT_PWRDN},
-                .error_str{"receiving response failed (connection closed)"},
-            };
-            return error.return_status;
-        } else if (num_bytes < 0) {
-            error = {
-                .return_status{MCD_RET_ACT_HANDLE_EVENT},
-                .error_code{MCD_ERR_CONNECTION},
-                .error_events{MCD_ERR_EVT_NONE},
-                .error_str{""},
-            };
-            snprintf(error.error_str, MCD_INFO_STR_LEN,
-                     "receiving response failed (%d)", GETSOCKETERRNO());
-            return error.return_status;
+        const char *delimiter{(const char *)memchr(
+            begin + this->rx_scanned, DELIMITER,
+            available - this->rx_scanned)};
+
+        if (delimiter) {
+            uint32_t length{(uint32_t)(delimiter - begin) + 1};
+            /* reserve one byte for the terminating '\0' */
+            bool overlong{length > MCD_MAX_PACKET_LENGTH - 1};
+            bool complete{!overlong && !this->rx_overflow};
+            bool report{overlong && !this->rx_overflow};
+            if (complete) {
+                message.assign(begin, begin + length);
+                message.push_back('\0');
+            }
+
+            this->rx_begin += length;
+            this->rx_scanned = 0;
+            this->rx_overflow = false;
+            if (this->rx_begin == this->rx_end) {
+                this->rx_begin = 0;
+                this->rx_end = 0;
+            }
+
+            if (complete) {
+                return Framing::MESSAGE;
+            } else if (report) {
+                overflow_error(error);
+                return Framing::DISCARDED;
+            }
+            /* the tail of an overlong message has been dropped */
+            continue;
+        }
+
+        this->rx_scanned = available;
+
+        /* reserve one byte for the terminating '\0' */
+        if (available >= MCD_MAX_PACKET_LENGTH - 1) {
+            /* drop the message up to its delimiter */
+            this->rx_begin = 0;
+            this->rx_end = 0;
+            this->rx_scanned = 0;
+            if (!this->rx_overflow) {
+                this->rx_overflow = true;
+                overflow_error(error);
+                return Framing::DISCARDED;
+            }
         }
 
-        received_bytes += num_bytes;
-    } while (received_bytes < MCD_MAX_PACKET_LENGTH &&
-             this->buf[received_bytes - 1] != DELIMITER);
-
-    if (this->buf[received_bytes - 1] != DELIMITER) {
-        error = {
-            .return_status{MCD_RET_ACT_HANDLE_EVENT},
-            .error_code{MCD_ERR_CONNECTION},
-            .error_events{MCD_ERR_EVT_NONE},
-            .error_str{"receiving response failed (overflow)"},
-        };
-        /* TODO: handle overflow (clear buffer) */
-        return error.return_status;
+        return Framing::INCOMPLETE;
     }
+}
 
-    this->buf[received_bytes] = '\0';
-    return MCD_RET_ACT_NONE;
+/* parses the request ID following the closing quote of the key "id" */
+static bool parse_request_id(const char *c, const char *end,
+                             uint32_t &request_id)
+{
+    /* skip the closing quote, the colon and whitespace */
+    for (c++; c < end && (*c == ':' || *c == ' ' || *c == '\t'); c++) {
+    }
+    if (c >= end || *c < '0' || *c > '9') {
+        return false;
+    }
+
+    uint64_t id{0};
+    for (; c < end && *c >= '0' && *c <= '9'; c++) {
+        id = id * 10 + (uint64_t)(*c - '0');
+        if (id > UINT32_MAX) {
+            return false;
+        }
+    }
+    request_id = (uint32_t)id;
+    return true;
+}
+
+IoThread::MessageKind IoThread::classify_message(
+    const std::vector<char> &message, uint32_t &request_id)
+{
+    if (!message.empty() && qmp_frame_marker((uint8_t)message[0])) {
+        /* the header of a binary frame tells the request ID */
+        if (message.size() < QMP_FRAME_HEADER_SIZE) {
+            return MessageKind::UNKNOWN;
+        } else if (!((uint8_t)message[0] & QMP_FRAME_HAS_ID)) {
+            return MessageKind::EVENT;
+        }
+        request_id = qmp_frame_get_u32(message.data() + 5);
+        return MessageKind::REPLY;
+    }
+
+    /*
+     * Only the keys of the outermost object are looked at: "return", "error"
+     * or "event" tell the kind of the message and "id" the request ID.
+     * Nested objects and strings are skipped without parsing the message, and
+     * the scan ends as soon as both are known.
+     */
+    MessageKind kind{MessageKind::UNKNOWN};
+    bool has_id{false};
+    bool at_key{false};
+    int depth{0};
+    const char *c{message.data()};
+    const char *end{c + message.size()};
+    for (; c < end && !(has_id && kind != MessageKind::UNKNOWN); c++) {
+        if (*c == '"') {
+            const char *string{c + 1};
+            for (c++; c < end && *c != '"'; c++) {
+                if (*c == '\\' && c + 1 < end) {
+                    c++;
+                }
+            }
+            if (c >= end) {
+                return MessageKind::UNKNOWN;
+            }
+            if (!at_key) {
+                continue;
+            }
+            at_key = false;
+            std::string_view key{string, (size_t)(c - string)};
+            if (key == "id") {
+                has_id = parse_request_id(c, end, request_id);
+            } else if (key == "return") {
+                kind = MessageKind::REPLY;
+            } else if (key == "error") {
+                kind = MessageKind::FAILURE;
+            } else if (key == "event") {
+                /* events carry no ID */
+                return MessageKind::EVENT;
+            }
+        } else if (*c == '{' || *c == '[') {
+            at_key = depth == 0 && *c == '{';
+            depth++;
+        } else if (*c == '}' || *c == ']') {
+            depth--;
+        } else if (*c == ',') {
+            at_key = depth == 1;
+        }
+    }
+
+    if (!has_id) {
+        return MessageKind::UNKNOWN;
+    }
+    /* a message with an ID answers its request even without a result */
+    return kind == MessageKind::FAILURE ? kind : MessageKind::REPLY;
 }
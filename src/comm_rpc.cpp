@@ -22,86 +22,60 @@
  * SOFTWARE.
  */
 
-#include "comm.hpp"
+#include <cstring>
 
-#define TIMEOUT_SECONDS 5
+#include "comm.hpp"
 
-mcd_return_et MCDServer::receive_messages(mcd_error_info_st &error)
+IoThread::Framing IoThread::extract_message(std::vector<char> &message,
+                                            mcd_error_info_st &error)
 {
-    fd_set readfds;
-    struct timeval tv{
-        .tv_sec{TIMEOUT_SECONDS},
-    };
+    /*
+     * A single receive might provide several frames. The frames following the
+     * current one stay in rx_buf for the next call.
+     */
+    uint32_t available{this->rx_end - this->rx_begin};
+    const char *frame{this->rx_buf.data() + this->rx_begin};
 
-    FD_ZERO(&readfds);
-    FD_SET(this->socket_fd, &readfds);
-    select((int)this->socket_fd + 1, &readfds, NULL, NULL, &tv);
-    if (!FD_ISSET(this->socket_fd, &readfds)) {
-        error = {
-            .return_status{MCD_RET_ACT_HANDLE_ERROR},
-            .error_code{MCD_ERR_TIMED_OUT},
-            .error_events{MCD_ERR_EVT_NONE},
-            .error_str{"receiving response failed (timeout)"},
-        };
-        return error.return_status;
+    if (available < sizeof(uint32_t)) {
+        return Framing::INCOMPLETE;
     }
 
-    /* read response length */
-    if (recv(this->socket_fd, (char *)this->buf, sizeof(uint32_t), 0) == 0) {
-        this->connected = false;
+    uint32_t length;
+    memcpy(&length, frame, sizeof(length));
+    if (length > MCD_MAX_PACKET_LENGTH - sizeof(uint32_t)) {
         error = {
             .return_status{MCD_RET_ACT_HANDLE_EVENT},
             .error_code{MCD_ERR_CONNECTION},
-            .error_events{MCD_ERR_EVT_PWRDN},
-            .error_str{"receiving response failed (connection closed)"},
+            .error_events{MCD_ERR_EVT_NONE},
+            .error_str{"receiving response failed (overflow)"},
         };
-        return error.return_status;
+        return Framing::BROKEN;
     }
 
-    uint32_t length{*(uint32_t *)this->buf};
-    uint32_t received_bytes{0};
-    do {
-        FD_ZERO(&readfds);
-        FD_SET(this->socket_fd, &readfds);
-        select((int)this->socket_fd + 1, &readfds, NULL, NULL, &tv);
-        if (!FD_ISSET(this->socket_fd, &readfds)) {
-            error = {
-                .return_status{MCD_RET_ACT_HANDLE_ERROR},
-                .error_code{MCD_ERR_TIMED_OUT},
-                .error_events{MCD_ERR_EVT_NONE},
-                .error_str{"receiving response failed (timeout)"},
-            };
-            return error.return_status;
-        }
-
-        long int num_bytes{
-            recv(this->socket_fd,
-                 (char *)this->buf + received_bytes + sizeof(uint32_t),
-                 MCD_MAX_PACKET_LENGTH - received_bytes, 0)};
-
-        if (num_bytes == 0) {
-            this->connected = false;
-            error = {
-                .return_status{MCD_RET_ACT_HANDLE_EVENT},
-                .error_code{MCD_ERR_CONNECTION},
-                .error_events{MCD_ERR_EVT_PWRDN},
-                .error_str{"receiving response failed (connection closed)"},
-            };
-            return error.return_status;
-        } else if (num_bytes < 0) {
-            error = {
-                .return_status{MCD_RET_ACT_HANDLE_EVENT},
-                .error_code{MCD_ERR_CONNECTION},
-                .error_events{MCD_ERR_EVT_NONE},
-                .error_str{""},
-            };
-            snprintf(error.error_str, MCD_INFO_STR_LEN,
-                     "receiving response failed (%d)", GETSOCKETERRNO());
-            return error.return_status;
-        }
+    uint32_t frame_size{(uint32_t)sizeof(uint32_t) + length};
+    if (available < frame_size) {
+        return Framing::INCOMPLETE;
+    }
 
-        received_bytes += num_bytes;
-    } while (received_bytes < length);
+    message.assign(frame, frame + frame_size);
+    this->rx_begin += frame_size;
+    if (this->rx_begin == this->rx_end) {
+        this->rx_begin = 0;
+        this->rx_end = 0;
+    }
+    return Framing::MESSAGE;
+}
 
-    return MCD_RET_ACT_NONE;
-}
\ No newline at end of file
+IoThread::MessageKind IoThread::classify_message(
+    const std::vector<char> &message, uint32_t &request_id)
+{
+    /* every message is a reply, a negotiated request ID follows the length */
+    if (!rpc_request_ids()) {
+        return MessageKind::ORDERED_REPLY;
+    }
+    if (message.size() < 2 * sizeof(uint32_t)) {
+        return MessageKind::UNKNOWN;
+    }
+    memcpy(&request_id, message.data() + sizeof(uint32_t), sizeof(request_id));
+    return MessageKind::REPLY;
+}
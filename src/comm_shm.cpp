@@ -0,0 +1,265 @@
+/*
+MIT License
+
+Copyright (c) 2025 Lauterbach GmbH
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#if defined(__linux__)
+
+#include <poll.h>
+#include <sys/mman.h>
+
+#include <chrono>
+#include <new>
+#include <thread>
+
+#include "comm.hpp"
+#include "shm_ring.hpp"
+
+static mcd_return_et shm_error(const char *error_str, mcd_error_info_st &error)
+{
+    error = {
+        .return_status{MCD_RET_ACT_HANDLE_ERROR},
+        .error_code{MCD_ERR_CONNECTION},
+        .error_events{MCD_ERR_EVT_NONE},
+        .error_str{""},
+    };
+    snprintf(error.error_str, MCD_INFO_STR_LEN, "%s (%d)", error_str, errno);
+    return error.return_status;
+}
+
+static mcd_return_et server_gone_error(mcd_error_info_st &error)
+{
+    error = {
+        .return_status{MCD_RET_ACT_HANDLE_EVENT},
+        .error_code{MCD_ERR_CONNECTION},
+        .error_events{MCD_ERR_EVT_PWRDN},
+        .error_str{"shared memory transport failed (connection closed)"},
+    };
+    return error.return_status;
+}
+
+ShmTransport::ShmTransport(const MCDServerConfig &config)
+    : control{config},
+      timeout_ms{config.timeout_ms},
+      memfd{-1},
+      request_event_fd{-1},
+      response_event_fd{-1},
+      channel{nullptr},
+      connected{false}
+{
+}
+
+ShmTransport::~ShmTransport() { this->disconnect(); }
+
+bool ShmTransport::is_connected() const
+{
+    return this->connected;
+}
+
+void ShmTransport::disconnect()
+{
+    this->connected = false;
+    this->control.disconnect();
+    if (this->channel) {
+        munmap(this->channel, sizeof(ShmChannel));
+        this->channel = nullptr;
+    }
+    for (int *fd :
+         {&this->memfd, &this->request_event_fd, &this->response_event_fd}) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+mcd_return_et ShmTransport::connect(mcd_error_info_st &error)
+{
+    if (this->is_connected()) {
+        return MCD_RET_ACT_NONE;
+    }
+
+    /* a lost connection is replaced by new shared memory */
+    this->disconnect();
+    if (this->control.connect(error) != MCD_RET_ACT_NONE) {
+        return error.return_status;
+    }
+
+    if (this->handshake(error) != MCD_RET_ACT_NONE) {
+        this->disconnect();
+        return error.return_status;
+    }
+
+    this->connected = true;
+    return MCD_RET_ACT_NONE;
+}
+
+mcd_return_et ShmTransport::handshake(mcd_error_info_st &error)
+{
+    this->memfd = memfd_create("mcd_shm", MFD_CLOEXEC);
+    if (this->memfd < 0 || ftruncate(this->memfd, sizeof(ShmChannel)) != 0) {
+        return shm_error("shared memory creation failed", error);
+    }
+
+    void *addr{mmap(nullptr, sizeof(ShmChannel), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, this->memfd, 0)};
+    if (addr == MAP_FAILED) {
+        return shm_error("shared memory mapping failed", error);
+    }
+    this->channel = new (addr) ShmChannel{};
+
+    this->request_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    this->response_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (this->request_event_fd < 0 || this->response_event_fd < 0) {
+        return shm_error("eventfd creation failed", error);
+    }
+
+    mcd_shm_handshake_st hs{
+        .magic{},
+        .size{sizeof(ShmChannel)},
+        .ring_capacity{MCD_SHM_RING_CAPACITY},
+    };
+    memcpy(hs.magic, MCD_SHM_MAGIC, sizeof(hs.magic));
+
+    int fds[3]{this->memfd, this->request_event_fd, this->response_event_fd};
+    char control_buf[CMSG_SPACE(sizeof(fds))]{};
+    struct iovec iov{
+        .iov_base{&hs},
+        .iov_len{sizeof(hs)},
+    };
+    struct msghdr msg{
+        .msg_name{nullptr},
+        .msg_namelen{0},
+        .msg_iov{&iov},
+        .msg_iovlen{1},
+        .msg_control{control_buf},
+        .msg_controllen{sizeof(control_buf)},
+        .msg_flags{0},
+    };
+    struct cmsghdr *cmsg{CMSG_FIRSTHDR(&msg)};
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    if (sendmsg(this->control.native_handle(), &msg, MSG_NOSIGNAL) !=
+        (ssize_t)sizeof(hs)) {
+        return shm_error("shared memory handshake failed", error);
+    }
+
+    uint32_t status;
+    struct pollfd fd{
+        .fd{this->control.native_handle()},
+        .events{POLLIN},
+        .revents{0},
+    };
+    if (poll(&fd, 1, (int)this->timeout_ms) != 1 ||
+        recv(fd.fd, &status, sizeof(status), MSG_WAITALL) !=
+            (ssize_t)sizeof(status)) {
+        return shm_error("shared memory handshake failed", error);
+    }
+
+    if (status != 0) {
+        error = {
+            .return_status{MCD_RET_ACT_HANDLE_ERROR},
+            .error_code{MCD_ERR_CONNECTION},
+            .error_events{MCD_ERR_EVT_NONE},
+            .error_str{"shared memory rejected by server"},
+        };
+        return error.return_status;
+    }
+
+    return MCD_RET_ACT_NONE;
+}
+
+mcd_return_et ShmTransport::send(const char *data, uint32_t len,
+                                 mcd_error_info_st &error)
+{
+    ShmRing &ring{this->channel->requests};
+    auto deadline{std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(this->timeout_ms)};
+
+    while (len > 0) {
+        uint32_t num_bytes{ring.write(data, len)};
+        data += num_bytes;
+        len -= num_bytes;
+        ring.notify(this->request_event_fd);
+        if (len == 0) {
+            break;
+        }
+
+        /* the server drains the ring while it processes earlier requests */
+        if (std::chrono::steady_clock::now() > deadline) {
+            this->connected = false;
+            error = {
+                .return_status{MCD_RET_ACT_HANDLE_ERROR},
+                .error_code{MCD_ERR_TIMED_OUT},
+                .error_events{MCD_ERR_EVT_NONE},
+                .error_str{"sending request failed (timeout)"},
+            };
+            return error.return_status;
+        }
+        std::this_thread::yield();
+    }
+
+    return MCD_RET_ACT_NONE;
+}
+
+mcd_return_et ShmTransport::receive(char *data, uint32_t capacity,
+                                    uint32_t &num_bytes,
+                                    mcd_error_info_st &error)
+{
+    uint64_t count;
+    (void)!read(this->response_event_fd, &count, sizeof(count));
+
+    num_bytes = this->channel->responses.read(data, capacity);
+    if (num_bytes > 0) {
+        return MCD_RET_ACT_NONE;
+    }
+
+    /* the server never sends on the socket, so it has been closed */
+    char c;
+    ssize_t ret{
+        recv(this->control.native_handle(), &c, 1, MSG_PEEK | MSG_DONTWAIT)};
+    if (ret == 0 || (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        this->connected = false;
+        return server_gone_error(error);
+    }
+
+    return MCD_RET_ACT_NONE;
+}
+
+std::vector<SOCKET> ShmTransport::wait_handles() const
+{
+    return {this->response_event_fd, this->control.native_handle()};
+}
+
+bool ShmTransport::prepare_wait(bool response_pending)
+{
+    /* spinning while idle would only burn CPU time */
+    ShmRing &ring{this->channel->responses};
+    return !(response_pending && ring.spin()) && ring.prepare_wait();
+}
+
+void ShmTransport::finish_wait() { this->channel->responses.finish_wait(); }
+
+#endif
@@ -25,7 +25,13 @@
 #include "mcd_rpc.h"
 #include "mcd_api.h"
 
+#include <ctype.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <type_traits>
 
 #if defined __BYTE_ORDER__
 static const bool HOST_BIG_ENDIAN = __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__;
@@ -91,8 +97,77 @@ enum {
     UID_MCD_READ_TRACE = 54,
 };
 
+/*
+ * Integers are sent at full width unless the compact encoding has been
+ * negotiated when opening the server (see mcd_rpc.h). The compact encoding
+ * sends integers and enums wider than a byte as unsigned LEB128: seven bits per
+ * byte starting with the least significant ones, the top bit of a byte is set
+ * if another one follows. Enums are encoded by their unsigned value. The frame
+ * header (length and a negotiated request ID) always keeps its fixed layout.
+ *
+ * The encoding is only switched while the server is opened, when no other
+ * request is in flight.
+ */
+static bool compact_encoding = false;
+
+static int marshal_varint(uint64_t value, char *buf)
+{
+    int n = 0;
+    while (value >= 0x80) {
+        buf[n++] = (char)(value | 0x80);
+        value >>= 7;
+    }
+    buf[n++] = (char)value;
+    return n;
+}
+
+static int unmarshal_varint(const char *buf, uint64_t *value)
+{
+    uint64_t v = 0;
+    int n = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t b = (uint8_t)buf[n++];
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) break;
+    }
+    *value = v;
+    return n;
+}
+
+/* maximum number of bytes of an integer with the given width on the wire */
+static uint32_t encoded_size(size_t bytes)
+{
+    if (!compact_encoding || bytes == 1) return (uint32_t)bytes;
+    return (uint32_t)((8 * bytes + 6) / 7);
+}
+
+/* unsigned integer with the width of T */
+template <typename T>
+using WireUint = std::conditional_t<
+    sizeof(T) == 8, uint64_t,
+    std::conditional_t<sizeof(T) == 4, uint32_t, uint16_t>>;
+
+template <typename T>
+static int marshal_varint_as(T obj, char *buf)
+{
+    WireUint<T> value;
+    memcpy(&value, &obj, sizeof(value));
+    return marshal_varint(value, buf);
+}
+
+template <typename T>
+static int unmarshal_varint_as(const char *buf, T *obj)
+{
+    uint64_t v;
+    int n = unmarshal_varint(buf, &v);
+    WireUint<T> value = (WireUint<T>)v;
+    memcpy(obj, &value, sizeof(value));
+    return n;
+}
+
+/* types only transferred in arrays are copied in bulk, see marshal_array */
 #define DEFINE_PRIMITIVE(type)                                               \
-    static int marshal_##type(type obj, char *buf)                           \
+    static int marshal_fixed_##type(type obj, char *buf)                     \
     {                                                                        \
         const int BYTES = sizeof(type);                                      \
         if constexpr (HOST_BIG_ENDIAN && BYTES > 1)                          \
@@ -101,7 +176,7 @@ enum {
             *(type *)buf = obj;                                              \
         return BYTES;                                                        \
     }                                                                        \
-    static int unmarshal_##type(const char *buf, type *obj)                  \
+    static int unmarshal_fixed_##type(const char *buf, type *obj)            \
     {                                                                        \
         const int BYTES = sizeof(type);                                      \
         if constexpr (HOST_BIG_ENDIAN && BYTES > 1)                          \
@@ -110,6 +185,18 @@ enum {
         else                                                                 \
             *obj = *(const type *)buf;                                       \
         return BYTES;                                                        \
+    }                                                                        \
+    [[maybe_unused]] static int marshal_##type(type obj, char *buf)          \
+    {                                                                        \
+        if constexpr (sizeof(type) > 1)                                      \
+            if (compact_encoding) return marshal_varint_as(obj, buf);        \
+        return marshal_fixed_##type(obj, buf);                               \
+    }                                                                        \
+    [[maybe_unused]] static int unmarshal_##type(const char *buf, type *obj) \
+    {                                                                        \
+        if constexpr (sizeof(type) > 1)                                      \
+            if (compact_encoding) return unmarshal_varint_as(buf, obj);      \
+        return unmarshal_fixed_##type(buf, obj);                             \
     }
 
 DEFINE_PRIMITIVE(mcd_addr_space_type_et)
@@ -155,6 +242,173 @@ static int unmarshal_mcd_bool_t(const char *buf, mcd_bool_t *obj)
     return l;
 }
 
+/*
+ * Arrays of primitives are copied as a whole. The wire format is little-endian
+ * and matches the memory layout of the array on little-endian hosts.
+ * Big-endian hosts reverse the bytes of every element in a loop without
+ * dependencies between the elements, which the compiler vectorizes. With the
+ * compact encoding, only byte arrays are copied.
+ */
+template <typename T>
+static uint32_t marshal_array(const T *obj, uint32_t len, char *buf)
+{
+    if constexpr (sizeof(T) > 1) {
+        if (compact_encoding) {
+            char *tail = buf;
+            for (uint32_t i = 0; i < len; i++)
+                tail += marshal_varint_as(obj[i], tail);
+            return (uint32_t)(tail - buf);
+        }
+    }
+    const uint32_t bytes = len * (uint32_t)sizeof(T);
+    if constexpr (HOST_BIG_ENDIAN && sizeof(T) > 1) {
+        const char *src = (const char *)obj;
+        for (uint32_t i = 0; i < bytes; i += sizeof(T))
+            for (uint32_t b = 0; b < sizeof(T); b++)
+                buf[i + b] = src[i + sizeof(T) - 1 - b];
+    } else if (bytes > 0) {
+        memcpy(buf, obj, bytes);
+    }
+    return bytes;
+}
+
+template <typename T>
+static uint32_t unmarshal_array(const char *buf, T *obj, uint32_t len)
+{
+    if constexpr (sizeof(T) > 1) {
+        if (compact_encoding) {
+            const char *head = buf;
+            for (uint32_t i = 0; i < len; i++)
+                head += unmarshal_varint_as(head, obj + i);
+            return (uint32_t)(head - buf);
+        }
+    }
+    const uint32_t bytes = len * (uint32_t)sizeof(T);
+    if constexpr (HOST_BIG_ENDIAN && sizeof(T) > 1) {
+        char *dst = (char *)obj;
+        for (uint32_t i = 0; i < bytes; i += sizeof(T))
+            for (uint32_t b = 0; b < sizeof(T); b++)
+                dst[i + b] = buf[i + sizeof(T) - 1 - b];
+    } else if (bytes > 0) {
+        memcpy(obj, buf, bytes);
+    }
+    return bytes;
+}
+
+/*
+ * Structs which only consist of primitives are described by the offset and
+ * size of their fields in wire order. If the fields follow each other without
+ * padding, the memory layout of the struct on a little-endian host equals the
+ * wire format and the struct is copied as a whole. The field-wise marshal
+ * functions remain for all other structs and hosts and for the compact
+ * encoding.
+ */
+struct WireField {
+    size_t offset;
+    size_t size;
+};
+
+template <size_t N>
+static constexpr uint32_t wire_size(const WireField (&fields)[N])
+{
+    size_t size = 0;
+    for (const WireField &f : fields) size += f.size;
+    return (uint32_t)size;
+}
+
+template <size_t N>
+static constexpr bool wire_packed(const WireField (&fields)[N])
+{
+    size_t offset = 0;
+    for (const WireField &f : fields) {
+        if (f.offset != offset) return false;
+        offset += f.size;
+    }
+    return true;
+}
+
+template <typename T>
+struct WireLayout {
+    static constexpr bool PACKED = false;
+};
+
+#define WIRE_FIELD(type, member) \
+    WireField { offsetof(type, member), sizeof(((type *)0)->member) }
+
+#define DEFINE_WIRE_LAYOUT(type, ...)                        \
+    template <>                                              \
+    struct WireLayout<type> {                                \
+        static constexpr WireField FIELDS[] = {__VA_ARGS__}; \
+        static constexpr uint32_t SIZE = wire_size(FIELDS);  \
+        static constexpr bool PACKED =                       \
+            !HOST_BIG_ENDIAN && wire_packed(FIELDS);         \
+    };
+
+/* return 0 if the struct has to be (un)marshalled field-wise */
+template <typename T>
+static uint32_t marshal_packed(const T *obj, char *buf)
+{
+    if constexpr (WireLayout<T>::PACKED) {
+        if (!compact_encoding) {
+            memcpy(buf, obj, WireLayout<T>::SIZE);
+            return WireLayout<T>::SIZE;
+        }
+    }
+    return 0;
+}
+
+template <typename T>
+static uint32_t unmarshal_packed(const char *buf, T *obj)
+{
+    if constexpr (WireLayout<T>::PACKED) {
+        if (!compact_encoding) {
+            memcpy(obj, buf, WireLayout<T>::SIZE);
+            return WireLayout<T>::SIZE;
+        }
+    }
+    return 0;
+}
+
+DEFINE_WIRE_LAYOUT(mcd_addr_st, WIRE_FIELD(mcd_addr_st, address),
+                   WIRE_FIELD(mcd_addr_st, mem_space_id),
+                   WIRE_FIELD(mcd_addr_st, addr_space_id),
+                   WIRE_FIELD(mcd_addr_st, addr_space_type))
+DEFINE_WIRE_LAYOUT(mcd_qry_systems_args,
+                   WIRE_FIELD(mcd_qry_systems_args, start_index),
+                   WIRE_FIELD(mcd_qry_systems_args, num_systems))
+DEFINE_WIRE_LAYOUT(mcd_qry_mem_spaces_args,
+                   WIRE_FIELD(mcd_qry_mem_spaces_args, core_uid),
+                   WIRE_FIELD(mcd_qry_mem_spaces_args, start_index),
+                   WIRE_FIELD(mcd_qry_mem_spaces_args, num_mem_spaces))
+DEFINE_WIRE_LAYOUT(mcd_qry_reg_groups_args,
+                   WIRE_FIELD(mcd_qry_reg_groups_args, core_uid),
+                   WIRE_FIELD(mcd_qry_reg_groups_args, start_index),
+                   WIRE_FIELD(mcd_qry_reg_groups_args, num_reg_groups))
+DEFINE_WIRE_LAYOUT(mcd_qry_reg_map_args,
+                   WIRE_FIELD(mcd_qry_reg_map_args, core_uid),
+                   WIRE_FIELD(mcd_qry_reg_map_args, reg_group_id),
+                   WIRE_FIELD(mcd_qry_reg_map_args, start_index),
+                   WIRE_FIELD(mcd_qry_reg_map_args, num_regs))
+DEFINE_WIRE_LAYOUT(mcd_qry_ctrigs_args,
+                   WIRE_FIELD(mcd_qry_ctrigs_args, core_uid),
+                   WIRE_FIELD(mcd_qry_ctrigs_args, start_index),
+                   WIRE_FIELD(mcd_qry_ctrigs_args, num_ctrigs))
+DEFINE_WIRE_LAYOUT(mcd_qry_trig_args, WIRE_FIELD(mcd_qry_trig_args, core_uid),
+                   WIRE_FIELD(mcd_qry_trig_args, trig_id))
+DEFINE_WIRE_LAYOUT(mcd_remove_trig_args,
+                   WIRE_FIELD(mcd_remove_trig_args, core_uid),
+                   WIRE_FIELD(mcd_remove_trig_args, trig_id))
+DEFINE_WIRE_LAYOUT(mcd_qry_trig_state_args,
+                   WIRE_FIELD(mcd_qry_trig_state_args, core_uid),
+                   WIRE_FIELD(mcd_qry_trig_state_args, trig_id))
+DEFINE_WIRE_LAYOUT(mcd_qry_trig_set_args,
+                   WIRE_FIELD(mcd_qry_trig_set_args, core_uid),
+                   WIRE_FIELD(mcd_qry_trig_set_args, start_index),
+                   WIRE_FIELD(mcd_qry_trig_set_args, num_trigs))
+DEFINE_WIRE_LAYOUT(mcd_qry_rst_class_info_args,
+                   WIRE_FIELD(mcd_qry_rst_class_info_args, core_uid),
+                   WIRE_FIELD(mcd_qry_rst_class_info_args, rst_class))
+
 /* marshal / unmarshal complex data types */
 
 static uint32_t marshal_mcd_core_con_info_st(const mcd_core_con_info_st *obj,
@@ -163,55 +417,38 @@ static uint32_t marshal_mcd_core_con_info_st(const mcd_core_con_info_st *obj,
     char *tail = buf;
 
     tail += marshal_uint32_t((uint32_t)MCD_HOSTNAME_LEN, tail);
-    for (uint32_t i = 0; i < (uint32_t)MCD_HOSTNAME_LEN; i++) {
-        tail += marshal_mcd_char_t(obj->host[i], tail);
-    }
+    tail += marshal_array(obj->host, (uint32_t)MCD_HOSTNAME_LEN, tail);
 
     tail += marshal_uint32_t(obj->server_port, tail);
 
     tail += marshal_uint32_t((uint32_t)MCD_KEY_LEN, tail);
-    for (uint32_t i = 0; i < (uint32_t)MCD_KEY_LEN; i++) {
-        tail += marshal_mcd_char_t(obj->server_key[i], tail);
-    }
+    tail += marshal_array(obj->server_key, (uint32_t)MCD_KEY_LEN, tail);
 
     tail += marshal_uint32_t((uint32_t)MCD_KEY_LEN, tail);
-    for (uint32_t i = 0; i < (uint32_t)MCD_KEY_LEN; i++) {
-        tail += marshal_mcd_char_t(obj->system_key[i], tail);
-    }
+    tail += marshal_array(obj->system_key, (uint32_t)MCD_KEY_LEN, tail);
 
     tail += marshal_uint32_t((uint32_t)MCD_KEY_LEN, tail);
-    for (uint32_t i = 0; i < (uint32_t)MCD_KEY_LEN; i++) {
-        tail += marshal_mcd_char_t(obj->device_key[i], tail);
-    }
+    tail += marshal_array(obj->device_key, (uint32_t)MCD_KEY_LEN, tail);
 
     tail += marshal_uint32_t((uint32_t)MCD_UNIQUE_NAME_LEN, tail);
-    for (uint32_t i = 0; i < (uint32_t)MCD_UNIQUE_NAME_LEN; i++) {
-        tail += marshal_mcd_char_t(obj->system[i], tail);
-    }
+    tail += marshal_array(obj->system, (uint32_t)MCD_UNIQUE_NAME_LEN, tail);
 
     tail += marshal_uint32_t((uint32_t)MCD_UNIQUE_NAME_LEN, tail);
-    for (uint32_t i = 0; i < (uint32_t)MCD_UNIQUE_NAME_LEN; i++) {
-        tail += marshal_mcd_char_t(obj->system_instance[i], tail);
-    }
+    tail += marshal_array(obj->system_instance, (uint32_t)MCD_UNIQUE_NAME_LEN,
+                          tail);
 
     tail += marshal_uint32_t((uint32_t)MCD_UNIQUE_NAME_LEN, tail);
-    for (uint32_t i = 0; i < (uint32_t)MCD_UNIQUE_NAME_LEN; i++) {
-        tail += marshal_mcd_char_t(obj->acc_hw[i], tail);
-    }
+    tail += marshal_array(obj->acc_hw, (uint32_t)MCD_UNIQUE_NAME_LEN, tail);
 
     tail += marshal_uint32_t(obj->device_type, tail);
 
     tail += marshal_uint32_t((uint32_t)MCD_UNIQUE_NAME_LEN, tail);
-    for (uint32_t i = 0; i < (uint32_t)MCD_UNIQUE_NAME_LEN; i++) {
-        tail += marshal_mcd_char_t(obj->device[i], tail);
-    }
+    tail += marshal_array(obj->device, (uint32_t)MCD_UNIQUE_NAME_LEN, tail);
 
     tail += marshal_uint32_t(obj->device_id, tail);
 
     tail += marshal_uint32_t((uint32_t)MCD_UNIQUE_NAME_LEN, tail);
-    for (uint32_t i = 0; i < (uint32_t)MCD_UNIQUE_NAME_LEN; i++) {
-        tail += marshal_mcd_char_t(obj->core[i], tail);
-    }
+    tail += marshal_array(obj->core, (uint32_t)MCD_UNIQUE_NAME_LEN, tail);
 
     tail += marshal_uint32_t(obj->core_type, tail);
 
@@ -220,6 +457,52 @@ static uint32_t marshal_mcd_core_con_info_st(const mcd_core_con_info_st *obj,
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t serialized_size_mcd_core_con_info_st(
+    const mcd_core_con_info_st *obj)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+    size += (uint32_t)MCD_HOSTNAME_LEN * encoded_size(sizeof(*obj->host));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+    size += (uint32_t)MCD_KEY_LEN * encoded_size(sizeof(*obj->server_key));
+
+    size += encoded_size(sizeof(uint32_t));
+    size += (uint32_t)MCD_KEY_LEN * encoded_size(sizeof(*obj->system_key));
+
+    size += encoded_size(sizeof(uint32_t));
+    size += (uint32_t)MCD_KEY_LEN * encoded_size(sizeof(*obj->device_key));
+
+    size += encoded_size(sizeof(uint32_t));
+    size += (uint32_t)MCD_UNIQUE_NAME_LEN * encoded_size(sizeof(*obj->system));
+
+    size += encoded_size(sizeof(uint32_t));
+    size += (uint32_t)MCD_UNIQUE_NAME_LEN *
+            encoded_size(sizeof(*obj->system_instance));
+
+    size += encoded_size(sizeof(uint32_t));
+    size += (uint32_t)MCD_UNIQUE_NAME_LEN * encoded_size(sizeof(*obj->acc_hw));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+    size += (uint32_t)MCD_UNIQUE_NAME_LEN * encoded_size(sizeof(*obj->device));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+    size += (uint32_t)MCD_UNIQUE_NAME_LEN * encoded_size(sizeof(*obj->core));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t unmarshal_mcd_core_con_info_st(const char *buf,
                                                mcd_core_con_info_st *obj)
 {
@@ -229,9 +512,7 @@ static uint32_t unmarshal_mcd_core_con_info_st(const char *buf,
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->host + i);
-        }
+        head += unmarshal_array(head, obj->host, len);
     }
 
     head += unmarshal_uint32_t(head, &obj->server_port);
@@ -240,54 +521,42 @@ static uint32_t unmarshal_mcd_core_con_info_st(const char *buf,
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->server_key + i);
-        }
+        head += unmarshal_array(head, obj->server_key, len);
     }
 
     {
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->system_key + i);
-        }
+        head += unmarshal_array(head, obj->system_key, len);
     }
 
     {
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->device_key + i);
-        }
+        head += unmarshal_array(head, obj->device_key, len);
     }
 
     {
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->system + i);
-        }
+        head += unmarshal_array(head, obj->system, len);
     }
 
     {
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->system_instance + i);
-        }
+        head += unmarshal_array(head, obj->system_instance, len);
     }
 
     {
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->acc_hw + i);
-        }
+        head += unmarshal_array(head, obj->acc_hw, len);
     }
 
     head += unmarshal_uint32_t(head, &obj->device_type);
@@ -296,9 +565,7 @@ static uint32_t unmarshal_mcd_core_con_info_st(const char *buf,
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->device + i);
-        }
+        head += unmarshal_array(head, obj->device, len);
     }
 
     head += unmarshal_uint32_t(head, &obj->device_id);
@@ -307,9 +574,7 @@ static uint32_t unmarshal_mcd_core_con_info_st(const char *buf,
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->core + i);
-        }
+        head += unmarshal_array(head, obj->core, len);
     }
 
     head += unmarshal_uint32_t(head, &obj->core_type);
@@ -334,9 +599,7 @@ static uint32_t unmarshal_mcd_error_info_st(const char *buf,
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->error_str + i);
-        }
+        head += unmarshal_array(head, obj->error_str, len);
     }
 
     return (uint32_t)(head - buf);
@@ -352,9 +615,7 @@ uint32_t unmarshal_mcd_memspace_st(const char *buf, mcd_memspace_st *obj)
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->mem_space_name + i);
-        }
+        head += unmarshal_array(head, obj->mem_space_name, len);
     }
 
     head += unmarshal_mcd_mem_type_et(head, &obj->mem_type);
@@ -392,9 +653,7 @@ static uint32_t unmarshal_mcd_register_group_st(const char *buf,
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->reg_group_name + i);
-        }
+        head += unmarshal_array(head, obj->reg_group_name, len);
     }
 
     head += unmarshal_uint32_t(head, &obj->n_registers);
@@ -404,6 +663,10 @@ static uint32_t unmarshal_mcd_register_group_st(const char *buf,
 
 static uint32_t marshal_mcd_addr_st(const mcd_addr_st *obj, char *buf)
 {
+    if (uint32_t packed = marshal_packed(obj, buf)) {
+        return packed;
+    }
+
     char *tail = buf;
 
     tail += marshal_uint64_t(obj->address, tail);
@@ -417,8 +680,27 @@ static uint32_t marshal_mcd_addr_st(const mcd_addr_st *obj, char *buf)
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t serialized_size_mcd_addr_st(const mcd_addr_st *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint64_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(mcd_addr_space_type_et));
+
+    return size;
+}
+
 static uint32_t unmarshal_mcd_addr_st(const char *buf, mcd_addr_st *obj)
 {
+    if (uint32_t packed = unmarshal_packed(buf, obj)) {
+        return packed;
+    }
+
     const char *head = buf;
 
     head += unmarshal_uint64_t(head, &obj->address);
@@ -445,9 +727,7 @@ static uint32_t unmarshal_mcd_register_info_st(const char *buf,
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->regname + i);
-        }
+        head += unmarshal_array(head, obj->regname, len);
     }
 
     head += unmarshal_uint32_t(head, &obj->regsize);
@@ -467,6 +747,35 @@ static uint32_t unmarshal_mcd_register_info_st(const char *buf,
     return (uint32_t)(head - buf);
 }
 
+static uint32_t serialized_size_mcd_register_info_st(
+    const mcd_register_info_st *)
+{
+    uint32_t size = 0;
+
+    size += serialized_size_mcd_addr_st(nullptr);
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+    size += (uint32_t)MCD_REG_NAME_LEN * encoded_size(sizeof(mcd_char_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint8_t));
+
+    size += encoded_size(sizeof(uint8_t));
+
+    size += encoded_size(sizeof(mcd_reg_type_et));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t marshal_mcd_tx_st(const mcd_tx_st *obj, char *buf)
 {
     char *tail = buf;
@@ -482,9 +791,7 @@ static uint32_t marshal_mcd_tx_st(const mcd_tx_st *obj, char *buf)
     tail += marshal_uint8_t(obj->core_mode, tail);
 
     tail += marshal_uint32_t((uint32_t)obj->num_bytes, tail);
-    for (uint32_t i = 0; i < (uint32_t)obj->num_bytes; i++) {
-        tail += marshal_uint8_t(obj->data[i], tail);
-    }
+    tail += marshal_array(obj->data, (uint32_t)obj->num_bytes, tail);
 
     tail += marshal_uint32_t(obj->num_bytes, tail);
 
@@ -493,6 +800,30 @@ static uint32_t marshal_mcd_tx_st(const mcd_tx_st *obj, char *buf)
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t serialized_size_mcd_tx_st(const mcd_tx_st *obj)
+{
+    uint32_t size = 0;
+
+    size += serialized_size_mcd_addr_st(&obj->addr);
+
+    size += encoded_size(sizeof(mcd_tx_access_type_et));
+
+    size += encoded_size(sizeof(mcd_tx_access_opt_et));
+
+    size += encoded_size(sizeof(uint8_t));
+
+    size += encoded_size(sizeof(uint8_t));
+
+    size += encoded_size(sizeof(uint32_t));
+    size += (uint32_t)obj->num_bytes * encoded_size(sizeof(*obj->data));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t unmarshal_mcd_tx_st(const char *buf, mcd_tx_st *obj)
 {
     const char *head = buf;
@@ -510,9 +841,7 @@ static uint32_t unmarshal_mcd_tx_st(const char *buf, mcd_tx_st *obj)
     {
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_uint8_t(head, obj->data + i);
-        }
+        head += unmarshal_array(head, obj->data, len);
     }
 
     head += unmarshal_uint32_t(head, &obj->num_bytes);
@@ -538,6 +867,22 @@ static uint32_t marshal_mcd_txlist_st(const mcd_txlist_st *obj, char *buf)
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t serialized_size_mcd_txlist_st(const mcd_txlist_st *obj)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+    for (uint32_t i = 0; i < (uint32_t)obj->num_tx; i++) {
+        size += serialized_size_mcd_tx_st(obj->tx + i);
+    }
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t unmarshal_mcd_txlist_st(const char *buf, mcd_txlist_st *obj)
 {
     const char *head = buf;
@@ -640,18 +985,14 @@ static uint32_t unmarshal_mcd_core_state_st(const char *buf,
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->stop_str + i);
-        }
+        head += unmarshal_array(head, obj->stop_str, len);
     }
 
     {
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->info_str + i);
-        }
+        head += unmarshal_array(head, obj->info_str, len);
     }
 
     return (uint32_t)(head - buf);
@@ -667,36 +1008,92 @@ static uint32_t unmarshal_mcd_rst_info_st(const char *buf, mcd_rst_info_st *obj)
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->info_str + i);
-        }
+        head += unmarshal_array(head, obj->info_str, len);
     }
 
     return (uint32_t)(head - buf);
 }
 
+/*
+ * The client requests the compact encoding with the key encoding=varint in the
+ * config string of mcd_open_server_f. A server which supports it answers the
+ * request in the fixed encoding and echoes the key in the config string of its
+ * response. Both sides use the compact encoding for all further messages.
+ */
+static const char COMPACT_ENCODING_KEY[] = "encoding=varint";
+static bool compact_encoding_requested = false;
+
+/*
+ * Request IDs in the frame header are negotiated the same way with the key
+ * dispatch=id. Until then, the header carries none and the server answers the
+ * requests in their order. The flag is read by the I/O thread.
+ */
+static const char REQUEST_ID_KEY[] = "dispatch=id";
+static bool request_ids_requested = false;
+static std::atomic<bool> request_ids{false};
+
+static bool has_config_key(const mcd_char_t *config_string, uint32_t len,
+                           const char *key)
+{
+    const uint32_t key_len = (uint32_t)strlen(key);
+    for (uint32_t i = 0; config_string && i + key_len <= len; i++) {
+        bool starts = i == 0 || isspace((unsigned char)config_string[i - 1]);
+        bool ends = i + key_len == len || config_string[i + key_len] == '\0' ||
+                    isspace((unsigned char)config_string[i + key_len]);
+        if (starts && ends && memcmp(config_string + i, key, key_len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static uint32_t rpc_marshal_mcd_open_server_args(
     const mcd_open_server_args *obj, char *buf)
 {
+    compact_encoding = false;
+    compact_encoding_requested =
+        has_config_key(obj->config_string, obj->config_string_len,
+                       COMPACT_ENCODING_KEY);
+    request_ids = false;
+    request_ids_requested = has_config_key(
+        obj->config_string, obj->config_string_len, REQUEST_ID_KEY);
+
     char *tail = buf;
 
     tail += marshal_uint32_t(obj->system_key_len, tail);
 
     tail += marshal_uint32_t((uint32_t)obj->system_key_len, tail);
-    for (uint32_t i = 0; i < (uint32_t)obj->system_key_len; i++) {
-        tail += marshal_mcd_char_t(obj->system_key[i], tail);
-    }
+    tail += marshal_array(obj->system_key, (uint32_t)obj->system_key_len, tail);
 
     tail += marshal_uint32_t(obj->config_string_len, tail);
 
     tail += marshal_uint32_t((uint32_t)obj->config_string_len, tail);
-    for (uint32_t i = 0; i < (uint32_t)obj->config_string_len; i++) {
-        tail += marshal_mcd_char_t(obj->config_string[i], tail);
-    }
+    tail += marshal_array(obj->config_string, (uint32_t)obj->config_string_len,
+                          tail);
 
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_open_server_args(
+    const mcd_open_server_args *obj)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+    size +=
+        (uint32_t)obj->system_key_len * encoded_size(sizeof(*obj->system_key));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+    size += (uint32_t)obj->config_string_len *
+            encoded_size(sizeof(*obj->config_string));
+
+    return size;
+}
+
 static uint32_t unmarshal_mcd_ctrig_info_st(const char *buf,
                                             mcd_ctrig_info_st *obj)
 {
@@ -708,9 +1105,7 @@ static uint32_t unmarshal_mcd_ctrig_info_st(const char *buf,
         uint32_t len;
         head += unmarshal_uint32_t(head, &len);
 
-        for (uint32_t i = 0; i < len; i++) {
-            head += unmarshal_mcd_char_t(head, obj->info_str + i);
-        }
+        head += unmarshal_array(head, obj->info_str, len);
     }
 
     return (uint32_t)(head - buf);
@@ -742,6 +1137,32 @@ static uint32_t marshal_mcd_trig_simple_core_st(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t serialized_size_mcd_trig_simple_core_st(
+    const mcd_trig_simple_core_st *obj)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(mcd_trig_type_et));
+
+    size += encoded_size(sizeof(mcd_trig_opt_et));
+
+    size += encoded_size(sizeof(mcd_trig_action_et));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint8_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += serialized_size_mcd_addr_st(&obj->addr_start);
+
+    size += encoded_size(sizeof(uint64_t));
+
+    return size;
+}
+
 static uint32_t unmarshal_mcd_trig_simple_core_st(const char *buf,
                                                   mcd_trig_simple_core_st *obj)
 {
@@ -808,6 +1229,46 @@ static uint32_t marshal_mcd_trig_complex_core_st(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t serialized_size_mcd_trig_complex_core_st(
+    const mcd_trig_complex_core_st *obj)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(mcd_trig_type_et));
+
+    size += encoded_size(sizeof(mcd_trig_opt_et));
+
+    size += encoded_size(sizeof(mcd_trig_action_et));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint8_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += serialized_size_mcd_addr_st(&obj->addr_start);
+
+    size += encoded_size(sizeof(uint64_t));
+
+    size += encoded_size(sizeof(uint64_t));
+
+    size += encoded_size(sizeof(uint64_t));
+
+    size += encoded_size(sizeof(uint64_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint64_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t unmarshal_mcd_trig_complex_core_st(
     const char *buf, mcd_trig_complex_core_st *obj)
 {
@@ -883,6 +1344,41 @@ static uint32_t marshal_mcd_rpc_trig_st(const mcd_rpc_trig_st *obj, char *buf)
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t serialized_size_mcd_rpc_trig_st(const mcd_rpc_trig_st *obj)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint8_t));
+
+    size += encoded_size(sizeof(uint8_t));
+    if (obj->is_complex_core) {
+        size += serialized_size_mcd_trig_complex_core_st(obj->complex_core);
+    }
+
+    size += encoded_size(sizeof(uint8_t));
+
+    size += encoded_size(sizeof(uint8_t));
+    if (obj->is_simple_core) {
+        size += serialized_size_mcd_trig_simple_core_st(obj->simple_core);
+    }
+
+    /* backwards compatibility */
+
+    /* is_trig_bus */
+    size += encoded_size(sizeof(uint8_t));
+    size += encoded_size(sizeof(uint8_t));
+
+    /* is_counter */
+    size += encoded_size(sizeof(uint8_t));
+    size += encoded_size(sizeof(uint8_t));
+
+    /* is_custom */
+    size += encoded_size(sizeof(uint8_t));
+    size += encoded_size(sizeof(uint8_t));
+
+    return size;
+}
+
 static uint32_t unmarshal_mcd_rpc_trig_st(const char *buf, mcd_rpc_trig_st *obj)
 {
     const char *head = buf;
@@ -951,9 +1447,7 @@ static uint32_t rpc_unmarshal_mcd_open_server_result(
                     host = 0;
                 }
 
-                for (uint32_t i = 0; i < len; i++) {
-                    head += unmarshal_mcd_char_t(head, host + i);
-                }
+                head += unmarshal_array(head, host, len);
 
                 obj->server.host = host;
             }
@@ -985,9 +1479,7 @@ static uint32_t rpc_unmarshal_mcd_open_server_result(
                     config_string = 0;
                 }
 
-                for (uint32_t i = 0; i < len; i++) {
-                    head += unmarshal_mcd_char_t(head, config_string + i);
-                }
+                head += unmarshal_array(head, config_string, len);
 
                 obj->server.config_string = config_string;
             }
@@ -996,6 +1488,17 @@ static uint32_t rpc_unmarshal_mcd_open_server_result(
         }
     }
 
+    compact_encoding = compact_encoding_requested &&
+                       obj->return_status == MCD_RET_ACT_NONE &&
+                       has_config_key(obj->server.config_string,
+                                      obj->server.config_string_len,
+                                      COMPACT_ENCODING_KEY);
+    request_ids = request_ids_requested &&
+                  obj->return_status == MCD_RET_ACT_NONE &&
+                  has_config_key(obj->server.config_string,
+                                 obj->server.config_string_len,
+                                 REQUEST_ID_KEY);
+
     return (uint32_t)(head - buf);
 }
 
@@ -1009,6 +1512,16 @@ static uint32_t rpc_marshal_mcd_close_server_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_close_server_args(
+    const mcd_close_server_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_close_server_result(
     const char *buf, mcd_close_server_result *obj)
 {
@@ -1031,6 +1544,18 @@ static uint32_t rpc_marshal_mcd_qry_systems_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_qry_systems_args(
+    const mcd_qry_systems_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_qry_systems_result(
     const char *buf, mcd_qry_systems_result *obj)
 {
@@ -1088,6 +1613,20 @@ static uint32_t rpc_marshal_mcd_qry_devices_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_qry_devices_args(
+    const mcd_qry_devices_args *obj)
+{
+    uint32_t size = 0;
+
+    size += serialized_size_mcd_core_con_info_st(obj->system_con_info);
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_qry_devices_result(
     const char *buf, mcd_qry_devices_result *obj)
 {
@@ -1145,6 +1684,20 @@ static uint32_t rpc_marshal_mcd_qry_cores_args(const mcd_qry_cores_args *obj,
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_qry_cores_args(
+    const mcd_qry_cores_args *obj)
+{
+    uint32_t size = 0;
+
+    size += serialized_size_mcd_core_con_info_st(obj->connection_info);
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_qry_cores_result(const char *buf,
                                                    mcd_qry_cores_result *obj)
 {
@@ -1198,6 +1751,16 @@ static uint32_t rpc_marshal_mcd_open_core_args(const mcd_open_core_args *obj,
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_open_core_args(
+    const mcd_open_core_args *obj)
+{
+    uint32_t size = 0;
+
+    size += serialized_size_mcd_core_con_info_st(obj->core_con_info);
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_open_core_result(const char *buf,
                                                    mcd_open_core_result *obj)
 {
@@ -1236,6 +1799,16 @@ static uint32_t rpc_marshal_mcd_close_core_args(const mcd_close_core_args *obj,
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_close_core_args(
+    const mcd_close_core_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_close_core_result(const char *buf,
                                                     mcd_close_core_result *obj)
 {
@@ -1261,6 +1834,21 @@ static uint32_t rpc_marshal_mcd_qry_error_info_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_qry_error_info_args(
+    const mcd_qry_error_info_args *obj)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint8_t));
+
+    size += encoded_size(sizeof(uint8_t));
+    if (obj->has_core_uid != 0) {
+        size += encoded_size(sizeof(uint32_t));
+    }
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_qry_error_info_result(
     const char *buf, mcd_qry_error_info_result *obj)
 {
@@ -1285,6 +1873,20 @@ static uint32_t rpc_marshal_mcd_qry_mem_spaces_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_qry_mem_spaces_args(
+    const mcd_qry_mem_spaces_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_qry_mem_spaces_result(
     const char *buf, mcd_qry_mem_spaces_result *obj)
 {
@@ -1342,6 +1944,20 @@ static uint32_t rpc_marshal_mcd_qry_reg_groups_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_qry_reg_groups_args(
+    const mcd_qry_reg_groups_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_qry_reg_groups_result(
     const char *buf, mcd_qry_reg_groups_result *obj)
 {
@@ -1401,6 +2017,22 @@ static uint32_t rpc_marshal_mcd_qry_reg_map_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_qry_reg_map_args(
+    const mcd_qry_reg_map_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_qry_reg_map_result(
     const char *buf, mcd_qry_reg_map_result *obj)
 {
@@ -1456,6 +2088,18 @@ static uint32_t rpc_marshal_mcd_execute_txlist_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_execute_txlist_args(
+    const mcd_execute_txlist_args *obj)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += serialized_size_mcd_txlist_st(obj->txlist);
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_execute_txlist_result(
     const char *buf, mcd_execute_txlist_result *obj)
 {
@@ -1484,6 +2128,16 @@ static uint32_t rpc_marshal_mcd_qry_trig_info_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_qry_trig_info_args(
+    const mcd_qry_trig_info_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_qry_trig_info_result(
     const char *buf, mcd_qry_trig_info_result *obj)
 {
@@ -1516,6 +2170,20 @@ static uint32_t rpc_marshal_mcd_qry_ctrigs_args(const mcd_qry_ctrigs_args *obj,
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_qry_ctrigs_args(
+    const mcd_qry_ctrigs_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_qry_ctrigs_result(const char *buf,
                                                     mcd_qry_ctrigs_result *obj)
 {
@@ -1571,6 +2239,18 @@ static uint32_t rpc_marshal_mcd_create_trig_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_create_trig_args(
+    const mcd_create_trig_args *obj)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += serialized_size_mcd_rpc_trig_st(obj->trig);
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_create_trig_result(
     const char *buf, mcd_create_trig_result *obj)
 {
@@ -1617,6 +2297,17 @@ static uint32_t rpc_marshal_mcd_qry_trig_args(const mcd_qry_trig_args *obj,
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_qry_trig_args(const mcd_qry_trig_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_qry_trig_result(const char *buf,
                                                   mcd_qry_trig_result *obj)
 {
@@ -1647,6 +2338,18 @@ static uint32_t rpc_marshal_mcd_remove_trig_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_remove_trig_args(
+    const mcd_remove_trig_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_remove_trig_result(
     const char *buf, mcd_remove_trig_result *obj)
 {
@@ -1669,6 +2372,18 @@ static uint32_t rpc_marshal_mcd_qry_trig_state_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_qry_trig_state_args(
+    const mcd_qry_trig_state_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_qry_trig_state_result(
     const char *buf, mcd_qry_trig_state_result *obj)
 {
@@ -1697,6 +2412,16 @@ static uint32_t rpc_marshal_mcd_activate_trig_set_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_activate_trig_set_args(
+    const mcd_activate_trig_set_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_activate_trig_set_result(
     const char *buf, mcd_activate_trig_set_result *obj)
 {
@@ -1717,6 +2442,16 @@ static uint32_t rpc_marshal_mcd_remove_trig_set_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_remove_trig_set_args(
+    const mcd_remove_trig_set_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_remove_trig_set_result(
     const char *buf, mcd_remove_trig_set_result *obj)
 {
@@ -1741,6 +2476,20 @@ static uint32_t rpc_marshal_mcd_qry_trig_set_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_qry_trig_set_args(
+    const mcd_qry_trig_set_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_qry_trig_set_result(
     const char *buf, mcd_qry_trig_set_result *obj)
 {
@@ -1771,9 +2520,7 @@ static uint32_t rpc_unmarshal_mcd_qry_trig_set_result(
             {
                 uint32_t len;
                 head += unmarshal_uint32_t(head, &len);
-                for (uint32_t i = 0; i < len; i++) {
-                    head += unmarshal_uint32_t(head, obj->trig_ids + i);
-                }
+                head += unmarshal_array(head, obj->trig_ids, len);
             }
         } else {
             obj->trig_ids = 0;
@@ -1793,6 +2540,16 @@ static uint32_t rpc_marshal_mcd_qry_trig_set_state_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_qry_trig_set_state_args(
+    const mcd_qry_trig_set_state_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_qry_trig_set_state_result(
     const char *buf, mcd_qry_trig_set_state_result *obj)
 {
@@ -1822,6 +2579,17 @@ static uint32_t rpc_marshal_mcd_run_args(const mcd_run_args *obj, char *buf)
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_run_args(const mcd_run_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint8_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_run_result(const char *buf,
                                              mcd_run_result *obj)
 {
@@ -1843,6 +2611,17 @@ static uint32_t rpc_marshal_mcd_stop_args(const mcd_stop_args *obj, char *buf)
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_stop_args(const mcd_stop_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint8_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_stop_result(const char *buf,
                                               mcd_stop_result *obj)
 {
@@ -1868,6 +2647,21 @@ static uint32_t rpc_marshal_mcd_step_args(const mcd_step_args *obj, char *buf)
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_step_args(const mcd_step_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint8_t));
+
+    size += encoded_size(sizeof(mcd_core_step_type_et));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_step_result(const char *buf,
                                               mcd_step_result *obj)
 {
@@ -1890,6 +2684,18 @@ static uint32_t rpc_marshal_mcd_set_global_args(const mcd_set_global_args *obj,
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_set_global_args(
+    const mcd_set_global_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint8_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_set_global_result(const char *buf,
                                                     mcd_set_global_result *obj)
 {
@@ -1910,6 +2716,16 @@ static uint32_t rpc_marshal_mcd_qry_state_args(const mcd_qry_state_args *obj,
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_qry_state_args(
+    const mcd_qry_state_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_qry_state_result(const char *buf,
                                                    mcd_qry_state_result *obj)
 {
@@ -1938,6 +2754,16 @@ static uint32_t rpc_marshal_mcd_qry_rst_classes_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_qry_rst_classes_args(
+    const mcd_qry_rst_classes_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_qry_rst_classes_result(
     const char *buf, mcd_qry_rst_classes_result *obj)
 {
@@ -1968,6 +2794,18 @@ static uint32_t rpc_marshal_mcd_qry_rst_class_info_args(
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_qry_rst_class_info_args(
+    const mcd_qry_rst_class_info_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint8_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_qry_rst_class_info_result(
     const char *buf, mcd_qry_rst_class_info_result *obj)
 {
@@ -1999,6 +2837,19 @@ static uint32_t rpc_marshal_mcd_rst_args(const mcd_rst_args *obj, char *buf)
     return (uint32_t)(tail - buf);
 }
 
+static uint32_t rpc_serialized_size_mcd_rst_args(const mcd_rst_args *)
+{
+    uint32_t size = 0;
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint32_t));
+
+    size += encoded_size(sizeof(uint8_t));
+
+    return size;
+}
+
 static uint32_t rpc_unmarshal_mcd_rst_result(const char *buf,
                                              mcd_rst_result *obj)
 {
@@ -2009,19 +2860,41 @@ static uint32_t rpc_unmarshal_mcd_rst_result(const char *buf,
     return (uint32_t)(head - buf);
 }
 
+void select_compact_encoding(bool compact) { compact_encoding = compact; }
+
+bool rpc_request_ids(void) { return request_ids; }
+
 uint32_t marshal_mcd_exit(char *buf, size_t buf_size)
 {
+    if (buf_size < sizeof(uint8_t)) {
+        return 0;
+    }
     return marshal_uint8_t(UID_MCD_EXIT, buf);
 }
 
 #define DEFINE_RPC(function, uid)                                              \
+    uint32_t serialized_size_##function##_args(function##_args const *args,    \
+                                               uint32_t request_id)            \
+    {                                                                          \
+        /* length, request ID if negotiated, function ID */                    \
+        return (request_ids ? 2 : 1) * sizeof(request_id) + sizeof(uint8_t) +  \
+               rpc_serialized_size_##function##_args(args);                    \
+    }                                                                          \
     uint32_t marshal_##function##_args(function##_args const *args,            \
-                                       char *buf, size_t buf_size)             \
+                                       uint32_t request_id, char *buf,         \
+                                       size_t buf_size)                        \
     {                                                                          \
+        if (serialized_size_##function##_args(args, request_id) > buf_size) {  \
+            return 0;                                                          \
+        }                                                                      \
         char *marsh = buf + sizeof(uint32_t); /* reserve space for length */   \
         char *tail = marsh;                                                    \
+        if (request_ids) {                                                     \
+            tail += marshal_fixed_uint32_t(request_id, tail);                  \
+        }                                                                      \
         tail += marshal_uint8_t(uid, tail);                                    \
-        tail += rpc_marshal_##function##_args(args, tail);                     \
+        uint32_t packed = marshal_packed(args, tail);                          \
+        tail += packed ? packed : rpc_marshal_##function##_args(args, tail);   \
         *(uint32_t *)buf = (uint32_t)(tail - marsh);                           \
         return (uint32_t)(tail - buf);                                         \
     }                                                                          \
@@ -2029,9 +2902,15 @@ uint32_t marshal_mcd_exit(char *buf, size_t buf_size)
                                                 function##_result *res,        \
                                                 mcd_error_info_st *error_info) \
     {                                                                          \
-        uint32_t length;                                                       \
-        buf += unmarshal_uint32_t(buf, &length);                               \
-        uint32_t actual_length = rpc_unmarshal_##function##_result(buf, res);  \
+        uint32_t length, request_id, header = 0;                               \
+        buf += unmarshal_fixed_uint32_t(buf, &length);                         \
+        if (request_ids) {                                                     \
+            /* the request ID has been matched by the I/O thread already */    \
+            header = unmarshal_fixed_uint32_t(buf, &request_id);               \
+            buf += header;                                                     \
+        }                                                                      \
+        uint32_t actual_length =                                               \
+            header + rpc_unmarshal_##function##_result(buf, res);              \
         if (actual_length != length) {                                         \
             *error_info = {                                                    \
                 .return_status = MCD_RET_ACT_HANDLE_ERROR,                     \
@@ -2078,3 +2957,41 @@ DEFINE_RPC(mcd_qry_state, UID_MCD_QRY_STATE)
 DEFINE_RPC(mcd_qry_rst_classes, UID_MCD_QRY_RST_CLASSES)
 DEFINE_RPC(mcd_qry_rst_class_info, UID_MCD_QRY_RST_CLASS_INFO)
 DEFINE_RPC(mcd_rst, UID_MCD_RST)
+
+uint32_t marshal_mcd_execute_txlist_bound(void)
+{
+    /*
+     * request:  length, request ID (if negotiated), function ID, core UID,
+     *           txlist (three counters)
+     * response: length, request ID (if negotiated), return status, option
+     *           flag, txlist (three counters)
+     */
+    const uint32_t header{2 * sizeof(uint32_t)};
+    const uint32_t byte{sizeof(uint8_t)};
+    const uint32_t counter{encoded_size(sizeof(uint32_t))};
+    const uint32_t request{header + byte + counter + 3 * counter};
+    const uint32_t response{header + encoded_size(sizeof(mcd_return_et)) +
+                            byte + 3 * counter};
+    return request > response ? request : response;
+}
+
+uint32_t marshal_mcd_tx_st_bound(const mcd_tx_st *tx)
+{
+    return serialized_size_mcd_tx_st(tx);
+}
+
+uint32_t unmarshal_mcd_qry_reg_map_bound(void)
+{
+    /*
+     * length, request ID (if negotiated), return status, num_regs,
+     * reg_info_len and reg_info (each with option flag), length of reg_info
+     */
+    return 2 * sizeof(uint32_t) + encoded_size(sizeof(mcd_return_et)) +
+           3 * (sizeof(uint8_t) + encoded_size(sizeof(uint32_t))) +
+           encoded_size(sizeof(uint32_t));
+}
+
+uint32_t unmarshal_mcd_register_info_st_bound(void)
+{
+    return serialized_size_mcd_register_info_st(nullptr);
+}
@@ -22,9 +22,16 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
 #include <cassert>
+#include <cinttypes>
+#include <cstdio>
 #include <cstring>
+#include <deque>
+#include <mutex>
 #include <optional>
+#include <shared_mutex>
+#include <vector>
 
 #include "adapter.hpp"
 #include "comm.hpp"
@@ -85,7 +92,7 @@ const mcd_error_info_st MCD_ERROR_MARSHAL{
     .return_status{MCD_RET_ACT_HANDLE_ERROR},
     .error_code{MCD_ERR_RPC_MARSHAL},
     .error_events{MCD_ERR_EVT_NONE},
-    .error_str{"error during argument marshalling"},
+    .error_str{"error during argument marshalling (packet size exceeded)"},
 };
 
 const mcd_error_info_st MCD_ERROR_UNMARSHAL{
@@ -116,16 +123,258 @@ const mcd_error_info_st MCD_ERROR_INVALID_NULL_PARAM{
     .error_str{"null was invalidly passed as a parameter"},
 };
 
+/*
+ * The error state is kept per thread such that threads driving different
+ * cores report their own errors with mcd_qry_error_info_f.
+ */
+
 /* Reserves memory for special error scenarios */
-static mcd_error_info_st custom_mcd_error{};
+static thread_local mcd_error_info_st custom_mcd_error{};
 
-/* Indicates that the error information is stored on server side */
-const mcd_error_info_st MCD_ERROR_ASK_SERVER{};
+/* The error info of the last failed server call of this thread */
+static thread_local mcd_error_info_st server_error_info{};
 
-const mcd_error_info_st *last_error{&MCD_ERROR_NONE};
+thread_local const mcd_error_info_st *last_error{&MCD_ERROR_NONE};
 
 static std::optional<MCDServer> g_mcd_server{};
 
+/*
+ * Guards the lifetime of g_mcd_server: opening and closing the server requires
+ * exclusive access, all other API calls share it. The responses are routed to
+ * the calling thread by their request ID or, without IDs, by the order of the
+ * requests, so the requests of concurrent calls overlap on the connection.
+ * Calls on the same core are serialized by the access mutex of the core in
+ * addition.
+ *
+ * Some calls are composed of other API calls, e.g. mcd_open_core_f queries
+ * the core database. Only the outermost call of a thread acquires the lock.
+ */
+static std::shared_mutex server_mutex;
+static thread_local uint32_t server_access_depth{0};
+
+class ServerAccess
+{
+    const bool exclusive;
+
+public:
+    explicit ServerAccess(bool exclusive = false) : exclusive{exclusive}
+    {
+        if (server_access_depth++ > 0) {
+            return;
+        }
+        if (exclusive) {
+            server_mutex.lock();
+        } else {
+            server_mutex.lock_shared();
+        }
+    }
+
+    ~ServerAccess()
+    {
+        if (--server_access_depth > 0) {
+            return;
+        }
+        if (exclusive) {
+            server_mutex.unlock();
+        } else {
+            server_mutex.unlock_shared();
+        }
+    }
+
+    ServerAccess(ServerAccess &) = delete;
+    ServerAccess &operator=(ServerAccess &other) = delete;
+};
+
+/*
+ * Remote calls
+ *
+ * All API calls forwarded to the server take the same steps: the arguments
+ * are marshalled into the message buffer and sent, then the response to the
+ * request is awaited and unmarshalled into the result. RpcCall ties the
+ * argument struct of a function to its result and its (un)marshalling, such
+ * that invoke performs these steps for every function.
+ *
+ * Callers which keep several requests in flight use the two halves
+ * send_request and receive_result instead.
+ */
+template <typename Args>
+struct RpcCall;
+
+#define DEFINE_RPC_CALL(function)                                              \
+    template <>                                                                \
+    struct RpcCall<function##_args> {                                          \
+        using Result = function##_result;                                      \
+        static constexpr auto marshal = marshal_##function##_args;             \
+        static constexpr auto unmarshal = unmarshal_##function##_result;       \
+    };
+
+DEFINE_RPC_CALL(mcd_open_server)
+DEFINE_RPC_CALL(mcd_close_server)
+DEFINE_RPC_CALL(mcd_qry_systems)
+DEFINE_RPC_CALL(mcd_qry_devices)
+DEFINE_RPC_CALL(mcd_qry_cores)
+DEFINE_RPC_CALL(mcd_open_core)
+DEFINE_RPC_CALL(mcd_close_core)
+DEFINE_RPC_CALL(mcd_qry_error_info)
+DEFINE_RPC_CALL(mcd_qry_mem_spaces)
+DEFINE_RPC_CALL(mcd_qry_reg_groups)
+DEFINE_RPC_CALL(mcd_qry_reg_map)
+DEFINE_RPC_CALL(mcd_execute_txlist)
+DEFINE_RPC_CALL(mcd_qry_trig_info)
+DEFINE_RPC_CALL(mcd_qry_ctrigs)
+DEFINE_RPC_CALL(mcd_create_trig)
+DEFINE_RPC_CALL(mcd_qry_trig)
+DEFINE_RPC_CALL(mcd_remove_trig)
+DEFINE_RPC_CALL(mcd_qry_trig_state)
+DEFINE_RPC_CALL(mcd_activate_trig_set)
+DEFINE_RPC_CALL(mcd_remove_trig_set)
+DEFINE_RPC_CALL(mcd_qry_trig_set)
+DEFINE_RPC_CALL(mcd_qry_trig_set_state)
+DEFINE_RPC_CALL(mcd_run)
+DEFINE_RPC_CALL(mcd_stop)
+DEFINE_RPC_CALL(mcd_step)
+DEFINE_RPC_CALL(mcd_set_global)
+DEFINE_RPC_CALL(mcd_qry_state)
+DEFINE_RPC_CALL(mcd_qry_rst_classes)
+DEFINE_RPC_CALL(mcd_qry_rst_class_info)
+DEFINE_RPC_CALL(mcd_rst)
+
+/*
+ * Marshals and sends a request without awaiting its response. A request which
+ * exceeds the packet size fails with MCD_ERR_RPC_MARSHAL and is not sent.
+ */
+template <typename Args>
+static mcd_return_et send_request(const Args &args, uint32_t &request_id,
+                                  mcd_error_info_st &error)
+{
+    request_id = g_mcd_server->new_request_id();
+    uint32_t req_len{RpcCall<Args>::marshal(&args, request_id,
+                                            g_mcd_server->msg_buf(),
+                                            MCD_MAX_PACKET_LENGTH)};
+
+    if (req_len == 0) {
+        error = MCD_ERROR_MARSHAL;
+        return error.return_status;
+    }
+
+    return g_mcd_server->send_message(request_id, req_len, error);
+}
+
+/* Awaits the response to a request sent by send_request */
+template <typename Args>
+static mcd_return_et receive_result(uint32_t request_id,
+                                    typename RpcCall<Args>::Result &res,
+                                    mcd_error_info_st &error)
+{
+    if (g_mcd_server->receive_messages(request_id, error) !=
+        MCD_RET_ACT_NONE) {
+        return error.return_status;
+    }
+
+    /* only some protocols describe why unmarshalling failed */
+    error = MCD_ERROR_UNMARSHAL;
+    return RpcCall<Args>::unmarshal(g_mcd_server->msg_buf(), &res, &error);
+}
+
+/*
+ * Calls a function on the server. If the call cannot be completed, error
+ * describes why. Otherwise, res holds the return status of the server.
+ */
+template <typename Args>
+static mcd_return_et invoke(const Args &args,
+                            typename RpcCall<Args>::Result &res,
+                            mcd_error_info_st &error)
+{
+    uint32_t request_id;
+    if (send_request(args, request_id, error) != MCD_RET_ACT_NONE) {
+        return error.return_status;
+    }
+    return receive_result<Args>(request_id, res, error);
+}
+
+/*
+ * Sets the error state for the return status of a server call. The server
+ * only keeps the error of its last call, so the details of a failure are
+ * fetched right away, before a call of another thread replaces them. The
+ * caller still holds the core, which serializes the calls on it.
+ */
+static mcd_return_et server_error(mcd_return_et ret, const Core *adapter)
+{
+    if (ret == MCD_RET_ACT_NONE) {
+        last_error = &MCD_ERROR_NONE;
+        return ret;
+    }
+
+    mcd_qry_error_info_args args{
+        .core_uid{},
+        .has_core_uid{adapter != nullptr},
+    };
+
+    if (adapter) {
+        args.core_uid = adapter->core_uid;
+    }
+
+    mcd_qry_error_info_result res{
+        .error_info{&server_error_info},
+    };
+
+    /* on a transmission error, this error is reported instead */
+    invoke(args, res, server_error_info);
+    last_error = &server_error_info;
+    return ret;
+}
+
+static mcd_return_et execute_txlist(const mcd_core_st *core,
+                                    mcd_txlist_st *txlist,
+                                    bool defer_writes);
+
+/*
+ * Sends the writes deferred by the write buffer of a core. They are dropped
+ * even if the server fails to execute them. The error is then reported by the
+ * call which flushes the buffer, and its error info names the first write
+ * which failed since the client has long been told that it succeeded.
+ */
+static mcd_return_et flush_write_buffer(const mcd_core_st *core)
+{
+    Core *adapter{(Core *)core->instance};
+    std::vector<mcd_tx_st> tx;
+    std::vector<std::vector<uint8_t>> data;
+    adapter->write_buffer.take(tx, data);
+    if (tx.empty()) {
+        last_error = &MCD_ERROR_NONE;
+        return last_error->return_status;
+    }
+
+    mcd_txlist_st txlist{
+        .tx{tx.data()},
+        .num_tx{(uint32_t)tx.size()},
+        .num_tx_ok{0},
+    };
+    mcd_return_et ret{execute_txlist(core, &txlist, false)};
+    if (ret == MCD_RET_ACT_NONE || txlist.num_tx_ok >= txlist.num_tx) {
+        return ret;
+    }
+
+    const mcd_error_info_st error{*last_error};
+    const mcd_tx_st &failed{tx[txlist.num_tx_ok]};
+    const uint32_t num_dropped{txlist.num_tx - txlist.num_tx_ok - 1};
+    custom_mcd_error = {
+        .return_status{ret},
+        .error_code{error.error_code},
+        .error_events{error.error_events},
+        .error_str{},
+    };
+    /* the server's text is cut short to leave room for the failed write */
+    snprintf(custom_mcd_error.error_str, MCD_INFO_STR_LEN,
+             "deferred write of %" PRIu32 " bytes at 0x%" PRIx64
+             " in memory space %" PRIu32 " failed, %" PRIu32
+             " later writes dropped: %.*s",
+             failed.num_bytes, failed.addr.address, failed.addr.mem_space_id,
+             num_dropped, MCD_INFO_STR_LEN / 2, error.error_str);
+    last_error = &custom_mcd_error;
+    return ret;
+}
+
 mcd_return_et mcd_initialize_f(const mcd_api_version_st *version_req,
                                mcd_impl_version_info_st *impl_info)
 {
@@ -168,18 +417,21 @@ mcd_return_et mcd_initialize_f(const mcd_api_version_st *version_req,
 
 void mcd_exit_f(void)
 {
+    ServerAccess access{true};
+
     if (!g_mcd_server) {
         /* no server connection active */
         last_error = &MCD_ERROR_NONE;
         return;
     }
 
+    uint32_t request_id{g_mcd_server->new_request_id()};
     uint32_t req_len{
-        marshal_mcd_exit(g_mcd_server->msg_buf, MCD_MAX_PACKET_LENGTH)};
+        marshal_mcd_exit(g_mcd_server->msg_buf(), MCD_MAX_PACKET_LENGTH)};
 
     /* we don't expect any response here */
 
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
+    if (g_mcd_server->send_message(request_id, req_len, custom_mcd_error) !=
         MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
     } else {
@@ -201,6 +453,8 @@ mcd_return_et mcd_open_server_f(const mcd_char_t *system_key,
                                 const mcd_char_t *config_string,
                                 mcd_server_st **server)
 {
+    ServerAccess access{true};
+
     if (!server || !system_key || !config_string) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -221,44 +475,15 @@ mcd_return_et mcd_open_server_f(const mcd_char_t *system_key,
         return last_error->return_status;
     }
 
-    std::string host{LOCALHOST};
-    int port{MCD_DEFAULT_TCP_PORT};
-    if (config_string && strlen(config_string)) {
-        /* expected format: <hostname>:<port> */
-        std::string s{config_string};
-        size_t i{s.find_first_of(':')};
-        if (i == 0 || i == std::string::npos || i != s.find_last_of(':')) {
-            custom_mcd_error = {
-                .return_status{MCD_RET_ACT_HANDLE_ERROR},
-                .error_code{MCD_ERR_PARAM},
-                .error_events{MCD_ERR_EVT_NONE},
-                .error_str{"ill-formed config_string, expected: "
-                           "<hostname>:<port>"},
-            };
-            last_error = &custom_mcd_error;
-            return last_error->return_status;
-        }
-
-        host = {s, 0, i};
-        std::string port_s{s, i + 1, std::string::npos};
-
-        try {
-            port = std::stoi(port_s);
-        } catch (std::exception const &) {
-            custom_mcd_error = {
-                .return_status{MCD_RET_ACT_HANDLE_ERROR},
-                .error_code{MCD_ERR_PARAM},
-                .error_events{MCD_ERR_EVT_NONE},
-                .error_str{"ill-formed config_string, expected: "
-                           "<hostname>:<port>"},
-            };
-            last_error = &custom_mcd_error;
-            return last_error->return_status;
-        }
+    MCDServerConfig config;
+    if (MCDServerConfig::Parse(config_string, config, custom_mcd_error) !=
+        MCD_RET_ACT_NONE) {
+        last_error = &custom_mcd_error;
+        return last_error->return_status;
     }
 
     try {
-        g_mcd_server = MCDServer::Open(host, port);
+        g_mcd_server = MCDServer::Open(config);
     } catch (const mcd_exception &ex) {
         custom_mcd_error = ex.error_info;
         last_error = &custom_mcd_error;
@@ -272,32 +497,12 @@ mcd_return_et mcd_open_server_f(const mcd_char_t *system_key,
         .config_string_len{(uint32_t)strlen(config_string)},
     };
 
-    uint32_t req_len{marshal_mcd_open_server_args(&args, g_mcd_server->msg_buf,
-                                                  MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    mcd_open_server_result res;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_open_server_result res;
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &custom_mcd_error;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_open_server_result(g_mcd_server->msg_buf, &res,
-                                                  &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
     if (res.return_status == MCD_RET_ACT_NONE) {
         g_mcd_server->server_uid = res.server.server_uid;
         *server = new mcd_server_st{
@@ -321,6 +526,8 @@ mcd_return_et mcd_open_server_f(const mcd_char_t *system_key,
 
 mcd_return_et mcd_close_server_f(const mcd_server_st *server)
 {
+    ServerAccess access{true};
+
     if (!server) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -341,32 +548,12 @@ mcd_return_et mcd_close_server_f(const mcd_server_st *server)
         .server_uid{g_mcd_server->server_uid},
     };
 
-    uint32_t req_len{marshal_mcd_close_server_args(&args, g_mcd_server->msg_buf,
-                                                   MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    mcd_close_server_result res;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_close_server_result res;
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_close_server_result(g_mcd_server->msg_buf, &res,
-                                                   &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
     if (res.return_status == MCD_RET_ACT_NONE) {
         if (server->host) {
             delete[] server->host;
@@ -408,6 +595,8 @@ mcd_return_et mcd_qry_server_config_f(const mcd_server_st *server,
 mcd_return_et mcd_qry_systems_f(uint32_t start_index, uint32_t *num_systems,
                                 mcd_core_con_info_st *system_con_info)
 {
+    ServerAccess access{};
+
     if (!num_systems || (*num_systems && !system_con_info)) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -423,44 +612,25 @@ mcd_return_et mcd_qry_systems_f(uint32_t start_index, uint32_t *num_systems,
         .num_systems{*num_systems},
     };
 
-    uint32_t req_len{marshal_mcd_qry_systems_args(&args, g_mcd_server->msg_buf,
-                                                  MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
-        last_error = &custom_mcd_error;
-        return last_error->return_status;
-    }
-
     mcd_qry_systems_result res{
         .num_systems{num_systems},
         .system_con_info{system_con_info},
     };
 
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_UNMARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_qry_systems_result(g_mcd_server->msg_buf, &res,
-                                                  &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
+        last_error = &custom_mcd_error;
+        return last_error->return_status;
+    }
 
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    return server_error(res.return_status, nullptr);
 }
 
 mcd_return_et mcd_qry_devices_f(const mcd_core_con_info_st *system_con_info,
                                 uint32_t start_index, uint32_t *num_devices,
                                 mcd_core_con_info_st *device_con_info)
 {
+    ServerAccess access{};
+
     if (!system_con_info || !num_devices ||
         (*num_devices && !device_con_info)) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
@@ -478,43 +648,25 @@ mcd_return_et mcd_qry_devices_f(const mcd_core_con_info_st *system_con_info,
         .num_devices{*num_devices},
     };
 
-    uint32_t req_len{marshal_mcd_qry_devices_args(&args, g_mcd_server->msg_buf,
-                                                  MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
-        last_error = &custom_mcd_error;
-        return last_error->return_status;
-    }
-
     mcd_qry_devices_result res{
         .num_devices{num_devices},
         .device_con_info{device_con_info},
     };
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_qry_devices_result(g_mcd_server->msg_buf, &res,
-                                                  &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
 
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
+        last_error = &custom_mcd_error;
+        return last_error->return_status;
+    }
+
+    return server_error(res.return_status, nullptr);
 }
 
 mcd_return_et mcd_qry_cores_f(const mcd_core_con_info_st *connection_info,
                               uint32_t start_index, uint32_t *num_cores,
                               mcd_core_con_info_st *core_con_info)
 {
+    ServerAccess access{};
+
     if (!num_cores || (*num_cores && !core_con_info)) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -531,37 +683,17 @@ mcd_return_et mcd_qry_cores_f(const mcd_core_con_info_st *connection_info,
         .num_cores{*num_cores},
     };
 
-    uint32_t req_len{marshal_mcd_qry_cores_args(&args, g_mcd_server->msg_buf,
-                                                MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
-        last_error = &custom_mcd_error;
-        return last_error->return_status;
-    }
-
     mcd_qry_cores_result res{
         .num_cores{num_cores},
         .core_con_info{core_con_info},
     };
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_qry_cores_result(g_mcd_server->msg_buf, &res,
-                                                &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
 
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
+        last_error = &custom_mcd_error;
+        return last_error->return_status;
+    }
+
+    return server_error(res.return_status, nullptr);
 }
 
 mcd_return_et mcd_qry_core_modes_f(const mcd_core_st *core,
@@ -575,6 +707,8 @@ mcd_return_et mcd_qry_core_modes_f(const mcd_core_st *core,
 mcd_return_et mcd_open_core_f(const mcd_core_con_info_st *core_con_info,
                               mcd_core_st **core)
 {
+    ServerAccess access{};
+
     if (!core_con_info || !core) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -589,33 +723,20 @@ mcd_return_et mcd_open_core_f(const mcd_core_con_info_st *core_con_info,
         .core_con_info{core_con_info},
     };
 
-    uint32_t req_len{marshal_mcd_open_core_args(&args, g_mcd_server->msg_buf,
-                                                MCD_MAX_PACKET_LENGTH)};
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    mcd_open_core_result res;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_open_core_result res;
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_open_core_result(g_mcd_server->msg_buf, &res,
-                                                &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
     if (res.return_status != MCD_RET_ACT_NONE) {
-        last_error = &MCD_ERROR_ASK_SERVER;
-        return res.return_status;
+        return server_error(res.return_status, nullptr);
     }
 
     Core *adapter{new Core{*res.core.core_con_info, res.core.core_uid}};
+    adapter->memory_cache.set_capacity(g_mcd_server->cache_pages());
+    adapter->memory_cache.set_fill_spaces(g_mcd_server->cache_fill());
+    adapter->write_buffer.set_capacity(g_mcd_server->write_buffer());
     *core = new mcd_core_st{
         .instance{adapter},
         .core_con_info{res.core.core_con_info},
@@ -634,6 +755,8 @@ mcd_return_et mcd_open_core_f(const mcd_core_con_info_st *core_con_info,
 
 mcd_return_et mcd_close_core_f(const mcd_core_st *core)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -645,18 +768,17 @@ mcd_return_et mcd_close_core_f(const mcd_core_st *core)
     }
 
     Core *adapter{(Core *)core->instance};
+    {
+        std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
+        if (flush_write_buffer(core) != MCD_RET_ACT_NONE) {
+            return last_error->return_status;
+        }
+    }
+
     mcd_close_core_args args{
         .core_uid{adapter->core_uid},
     };
 
-    uint32_t req_len{marshal_mcd_close_core_args(&args, g_mcd_server->msg_buf,
-                                                 MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
     /*
      * After passing through the mcd_close_core_f request,
      * the following errors might occur:
@@ -666,32 +788,21 @@ mcd_return_et mcd_close_core_f(const mcd_core_st *core)
      * 3. Error in mcd_close_core_f of server
      */
 
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
-        /* error during transmission */
+    mcd_close_core_result res;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
+        if ((custom_mcd_error.return_status == MCD_RET_ACT_HANDLE_EVENT) &&
+            (custom_mcd_error.error_events & MCD_ERR_EVT_PWRDN)) {
+            /* since target is powered down, we did everything we could */
+            delete adapter;
+            delete core->core_con_info;
+            delete core;
+            last_error = &MCD_ERROR_NONE;
+            return last_error->return_status;
+        }
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_close_core_result res;
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            if ((custom_mcd_error.return_status == MCD_RET_ACT_HANDLE_EVENT) &&
-                (custom_mcd_error.error_events & MCD_ERR_EVT_PWRDN)) {
-                /* since target is powered down, we did everything we could */
-                delete adapter;
-                delete core->core_con_info;
-                delete core;
-                last_error = &MCD_ERROR_NONE;
-                return last_error->return_status;
-            }
-        }
-        status = unmarshal_mcd_close_core_result(g_mcd_server->msg_buf, &res,
-                                                 &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
     if (res.return_status == MCD_RET_ACT_NONE) {
         delete adapter;
         delete core->core_con_info;
@@ -702,8 +813,7 @@ mcd_return_et mcd_close_core_f(const mcd_core_st *core)
      * we might need to keep the information for another try
      */
 
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    return server_error(res.return_status, adapter);
 }
 
 void mcd_qry_error_info_f(const mcd_core_st *core,
@@ -713,55 +823,8 @@ void mcd_qry_error_info_f(const mcd_core_st *core,
         return;
     }
 
-    if (last_error != &MCD_ERROR_ASK_SERVER) {
-        /* todo: core specific */
-        *error_info = *last_error;
-        return;
-    }
-
-    /*
-     * We need to request the error info from the server
-     * If an error occurs during transmission, return this error instead
-     * (mcd_qry_error_info should not fail in normal operation)
-     */
-
-    if (!g_mcd_server) {
-        *error_info = MCD_ERROR_SERVER_NOT_OPEN;
-        return;
-    }
-
-    mcd_qry_error_info_args args{
-        .core_uid{},
-        .has_core_uid{core && core->instance},
-    };
-
-    if (args.has_core_uid) {
-        Core *adapter{(Core *)core->instance};
-        args.core_uid = adapter->core_uid;
-    }
-
-    uint32_t req_len{marshal_mcd_qry_error_info_args(
-        &args, g_mcd_server->msg_buf, MCD_MAX_PACKET_LENGTH)};
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
-        *error_info = custom_mcd_error;
-        return;
-    }
-
-    mcd_qry_error_info_result res{
-        .error_info{error_info},
-    };
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            *error_info = custom_mcd_error;
-            return;
-        }
-        status = unmarshal_mcd_qry_error_info_result(g_mcd_server->msg_buf,
-                                                     &res, &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
+    /* the details of server errors were fetched by the failed call */
+    *error_info = *last_error;
 }
 
 mcd_return_et mcd_qry_device_description_f(const mcd_core_st *core,
@@ -791,12 +854,15 @@ mcd_return_et mcd_qry_mem_spaces_f(const mcd_core_st *core,
                                    uint32_t *num_mem_spaces,
                                    mcd_memspace_st *mem_spaces)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance || !num_mem_spaces) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
 
     if (adapter->core_database_updated()) {
         if (adapter->query_mem_spaces(start_index, num_mem_spaces, mem_spaces,
@@ -819,40 +885,20 @@ mcd_return_et mcd_qry_mem_spaces_f(const mcd_core_st *core,
         .num_mem_spaces{*num_mem_spaces},
     };
 
-    uint32_t req_len{marshal_mcd_qry_mem_spaces_args(
-        &args, g_mcd_server->msg_buf, MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
-        last_error = &custom_mcd_error;
-        return last_error->return_status;
-    }
-
     mcd_qry_mem_spaces_result res{
         .num_mem_spaces{num_mem_spaces},
         .mem_spaces{mem_spaces},
     };
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_qry_mem_spaces_result(g_mcd_server->msg_buf,
-                                                     &res, &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
-}
 
-mcd_return_et mcd_qry_mem_blocks_f(const mcd_core_st *core,
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
+        last_error = &custom_mcd_error;
+        return last_error->return_status;
+    }
+
+    return server_error(res.return_status, adapter);
+}
+
+mcd_return_et mcd_qry_mem_blocks_f(const mcd_core_st *core,
                                    uint32_t mem_space_id, uint32_t start_index,
                                    uint32_t *num_mem_blocks,
                                    mcd_memblock_st *mem_blocks)
@@ -875,12 +921,15 @@ mcd_return_et mcd_qry_reg_groups_f(const mcd_core_st *core,
                                    uint32_t *num_reg_groups,
                                    mcd_register_group_st *reg_groups)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance || !num_reg_groups) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
 
     if (adapter->core_database_updated()) {
         if (adapter->query_reg_groups(start_index, num_reg_groups, reg_groups,
@@ -903,49 +952,42 @@ mcd_return_et mcd_qry_reg_groups_f(const mcd_core_st *core,
         .num_reg_groups{*num_reg_groups},
     };
 
-    uint32_t req_len{marshal_mcd_qry_reg_groups_args(
-        &args, g_mcd_server->msg_buf, MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
+    mcd_qry_reg_groups_result res{
+        .num_reg_groups{num_reg_groups},
+        .reg_groups{reg_groups},
+    };
 
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_qry_reg_groups_result res{
-        .num_reg_groups{num_reg_groups},
-        .reg_groups{reg_groups},
-    };
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_qry_reg_groups_result(g_mcd_server->msg_buf,
-                                                     &res, &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
+    return server_error(res.return_status, adapter);
+}
 
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+/*
+ * Largest number of registers whose descriptions fit into a response. The
+ * bounds depend on the encoding negotiated with the server.
+ */
+static uint32_t max_reg_map_page()
+{
+    return (MCD_MAX_PACKET_LENGTH - unmarshal_mcd_qry_reg_map_bound()) /
+           unmarshal_mcd_register_info_st_bound();
 }
 
 mcd_return_et mcd_qry_reg_map_f(const mcd_core_st *core, uint32_t reg_group_id,
                                 uint32_t start_index, uint32_t *num_regs,
                                 mcd_register_info_st *reg_info)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance || !num_regs) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
 
     if (adapter->core_database_updated()) {
         if (adapter->query_reg_map(reg_group_id, start_index, num_regs,
@@ -964,12 +1006,13 @@ mcd_return_et mcd_qry_reg_map_f(const mcd_core_st *core, uint32_t reg_group_id,
         return last_error->return_status;
     }
 
-    /* Partition large requests to avoid having message buffer overflows */
-    if (*num_regs > 100) {
+    /* Partition large requests such that every response fits into a packet */
+    const uint32_t max_regs{max_reg_map_page()};
+    if (*num_regs > max_regs) {
         uint32_t num{0};
         do {
             const uint32_t num_queried{
-                (*num_regs - num) < 100 ? (*num_regs - num) : 100};
+                (*num_regs - num) < max_regs ? (*num_regs - num) : max_regs};
             uint32_t num_response{num_queried};
             mcd_return_et ret{mcd_qry_reg_map_f(core, reg_group_id,
                                                 start_index + num,
@@ -998,37 +1041,17 @@ mcd_return_et mcd_qry_reg_map_f(const mcd_core_st *core, uint32_t reg_group_id,
         .num_regs{*num_regs},
     };
 
-    uint32_t req_len{marshal_mcd_qry_reg_map_args(&args, g_mcd_server->msg_buf,
-                                                  MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
-        last_error = &custom_mcd_error;
-        return last_error->return_status;
-    }
-
     mcd_qry_reg_map_result res{
         .num_regs{num_regs},
         .reg_info{reg_info},
     };
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_qry_reg_map_result(g_mcd_server->msg_buf, &res,
-                                                  &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
 
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
+        last_error = &custom_mcd_error;
+        return last_error->return_status;
+    }
+
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_qry_reg_compound_f(const mcd_core_st *core,
@@ -1044,6 +1067,8 @@ mcd_return_et mcd_qry_reg_compound_f(const mcd_core_st *core,
 mcd_return_et mcd_qry_trig_info_f(const mcd_core_st *core,
                                   mcd_trig_info_st *trig_info)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -1055,46 +1080,29 @@ mcd_return_et mcd_qry_trig_info_f(const mcd_core_st *core,
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
     mcd_qry_trig_info_args args{
         .core_uid{adapter->core_uid},
     };
 
-    uint32_t req_len{marshal_mcd_qry_trig_info_args(
-        &args, g_mcd_server->msg_buf, MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
+    mcd_qry_trig_info_result res{
+        .trig_info{trig_info},
+    };
 
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_qry_trig_info_result res{
-        .trig_info{trig_info},
-    };
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_qry_trig_info_result(g_mcd_server->msg_buf, &res,
-                                                    &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_qry_ctrigs_f(const mcd_core_st *core, uint32_t start_index,
                                uint32_t *num_ctrigs,
                                mcd_ctrig_info_st *ctrig_info)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance || !num_ctrigs) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -1106,48 +1114,31 @@ mcd_return_et mcd_qry_ctrigs_f(const mcd_core_st *core, uint32_t start_index,
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
     mcd_qry_ctrigs_args args{
         .core_uid{adapter->core_uid},
         .start_index{start_index},
         .num_ctrigs{*num_ctrigs},
     };
 
-    uint32_t req_len{marshal_mcd_qry_ctrigs_args(&args, g_mcd_server->msg_buf,
-                                                 MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
-        last_error = &custom_mcd_error;
-        return last_error->return_status;
-    }
-
     mcd_qry_ctrigs_result res{
         .num_ctrigs{num_ctrigs},
         .ctrig_info{ctrig_info},
     };
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_qry_ctrigs_result(g_mcd_server->msg_buf, &res,
-                                                 &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
 
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
+        last_error = &custom_mcd_error;
+        return last_error->return_status;
+    }
+
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_create_trig_f(const mcd_core_st *core, void *trig,
                                 uint32_t *trig_id)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance || !trig || !trig_id) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -1159,6 +1150,7 @@ mcd_return_et mcd_create_trig_f(const mcd_core_st *core, void *trig,
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
     uint32_t trig_struct_size{*(uint32_t *)trig};
 
     mcd_rpc_trig_st rpc_trig{
@@ -1194,42 +1186,24 @@ mcd_return_et mcd_create_trig_f(const mcd_core_st *core, void *trig,
         .trig{&rpc_trig},
     };
 
-    uint32_t req_len{marshal_mcd_create_trig_args(&args, g_mcd_server->msg_buf,
-                                                  MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
-        last_error = &custom_mcd_error;
-        return last_error->return_status;
-    }
-
     mcd_create_trig_result res{
         .trig{&rpc_trig}, /* rpc_trig already points to trig */
         .trig_id{trig_id},
     };
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_create_trig_result(g_mcd_server->msg_buf, &res,
-                                                  &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
 
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
+        last_error = &custom_mcd_error;
+        return last_error->return_status;
+    }
+
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_qry_trig_f(const mcd_core_st *core, uint32_t trig_id,
                              uint32_t max_trig_size, void *trig)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance || !trig) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -1241,25 +1215,12 @@ mcd_return_et mcd_qry_trig_f(const mcd_core_st *core, uint32_t trig_id,
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
     mcd_qry_trig_args args{
         .core_uid{adapter->core_uid},
         .trig_id{trig_id},
     };
 
-    uint32_t req_len{marshal_mcd_qry_trig_args(&args, g_mcd_server->msg_buf,
-                                               MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
-        last_error = &custom_mcd_error;
-        return last_error->return_status;
-    }
-
     mcd_rpc_trig_st rpc_trig{
         .is_complex_core{max_trig_size >= sizeof(mcd_trig_complex_core_st)},
         .is_simple_core{max_trig_size >= sizeof(mcd_trig_simple_core_st)},
@@ -1274,23 +1235,19 @@ mcd_return_et mcd_qry_trig_f(const mcd_core_st *core, uint32_t trig_id,
     mcd_qry_trig_result res{
         .trig{&rpc_trig},
     };
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_qry_trig_result(g_mcd_server->msg_buf, &res,
-                                               &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
 
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
+        last_error = &custom_mcd_error;
+        return last_error->return_status;
+    }
+
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_remove_trig_f(const mcd_core_st *core, uint32_t trig_id)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -1302,44 +1259,26 @@ mcd_return_et mcd_remove_trig_f(const mcd_core_st *core, uint32_t trig_id)
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
     mcd_remove_trig_args args{
         .core_uid{adapter->core_uid},
         .trig_id{trig_id},
     };
 
-    uint32_t req_len{marshal_mcd_remove_trig_args(&args, g_mcd_server->msg_buf,
-                                                  MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    mcd_remove_trig_result res;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_remove_trig_result res;
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_remove_trig_result(g_mcd_server->msg_buf, &res,
-                                                  &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_qry_trig_state_f(const mcd_core_st *core, uint32_t trig_id,
                                    mcd_trig_state_st *trig_state)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance | !trig_state) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -1351,45 +1290,28 @@ mcd_return_et mcd_qry_trig_state_f(const mcd_core_st *core, uint32_t trig_id,
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
     mcd_qry_trig_state_args args{
         .core_uid{adapter->core_uid},
         .trig_id{trig_id},
     };
 
-    uint32_t req_len{marshal_mcd_qry_trig_state_args(
-        &args, g_mcd_server->msg_buf, MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
+    mcd_qry_trig_state_result res{
+        .trig_state{trig_state},
+    };
 
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_qry_trig_state_result res{
-        .trig_state{trig_state},
-    };
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_qry_trig_state_result(g_mcd_server->msg_buf,
-                                                     &res, &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_activate_trig_set_f(const mcd_core_st *core)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -1401,42 +1323,24 @@ mcd_return_et mcd_activate_trig_set_f(const mcd_core_st *core)
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
     mcd_activate_trig_set_args args{
         .core_uid{adapter->core_uid},
     };
 
-    uint32_t req_len{marshal_mcd_activate_trig_set_args(
-        &args, g_mcd_server->msg_buf, MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    mcd_activate_trig_set_result res;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_activate_trig_set_result res;
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_activate_trig_set_result(
-            g_mcd_server->msg_buf, &res, &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_remove_trig_set_f(const mcd_core_st *core)
 {
+    ServerAccess access{};
+
     if (!core) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -1448,43 +1352,25 @@ mcd_return_et mcd_remove_trig_set_f(const mcd_core_st *core)
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
     mcd_remove_trig_set_args args{
         .core_uid{adapter->core_uid},
     };
 
-    uint32_t req_len{marshal_mcd_remove_trig_set_args(
-        &args, g_mcd_server->msg_buf, MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    mcd_remove_trig_set_result res;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_remove_trig_set_result res;
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_remove_trig_set_result(g_mcd_server->msg_buf,
-                                                      &res, &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_qry_trig_set_f(const mcd_core_st *core, uint32_t start_index,
                                  uint32_t *num_trigs, uint32_t *trig_ids)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance || !num_trigs || (*num_trigs && !trig_ids)) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -1496,40 +1382,22 @@ mcd_return_et mcd_qry_trig_set_f(const mcd_core_st *core, uint32_t start_index,
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
     mcd_qry_trig_set_args args{
         .core_uid{adapter->core_uid},
         .start_index{start_index},
         .num_trigs{*num_trigs},
     };
 
-    uint32_t req_len{marshal_mcd_qry_trig_set_args(&args, g_mcd_server->msg_buf,
-                                                   MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
-        last_error = &custom_mcd_error;
-        return last_error->return_status;
-    }
-
     mcd_qry_trig_set_result res{
         .num_trigs{num_trigs},
         .trig_ids{trig_ids},
     };
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_qry_trig_set_result(g_mcd_server->msg_buf, &res,
-                                                   &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
+
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
+        last_error = &custom_mcd_error;
+        return last_error->return_status;
+    }
 
     last_error = &MCD_ERROR_NONE;
     return last_error->return_status;
@@ -1538,6 +1406,8 @@ mcd_return_et mcd_qry_trig_set_f(const mcd_core_st *core, uint32_t start_index,
 mcd_return_et mcd_qry_trig_set_state_f(const mcd_core_st *core,
                                        mcd_trig_set_state_st *trig_state)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance || !trig_state) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -1549,172 +1419,1031 @@ mcd_return_et mcd_qry_trig_set_state_f(const mcd_core_st *core,
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
     mcd_qry_trig_set_state_args args{
         .core_uid{adapter->core_uid},
     };
 
-    uint32_t req_len{marshal_mcd_qry_trig_set_state_args(
-        &args, g_mcd_server->msg_buf, MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
+    mcd_qry_trig_set_state_result res{
+        .trig_state{trig_state},
+    };
 
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_qry_trig_set_state_result res{
-        .trig_state{trig_state},
-    };
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_qry_trig_set_state_result(
-            g_mcd_server->msg_buf, &res, &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    return server_error(res.return_status, adapter);
 }
 
-mcd_return_et mcd_execute_txlist_f(const mcd_core_st *core,
-                                   mcd_txlist_st *txlist)
+/*
+ * Packing of transaction lists
+ *
+ * Each client transaction is converted into a server transaction list by the
+ * TxAdapter of its memory space. The server transactions of consecutive client
+ * transactions are concatenated into a single mcd_execute_txlist request as
+ * long as the request and its response fit into one packet. This way, a list
+ * of many small transactions (e.g. a register dump) costs only a few round
+ * trips instead of one per transaction.
+ */
+/* A transaction which may be executed once more without any effect */
+static bool plain_read(const mcd_tx_st &tx)
 {
-    if (!core || !core->instance || !txlist) {
-        last_error = &MCD_ERROR_INVALID_NULL_PARAM;
-        return last_error->return_status;
+    return tx.access_type == MCD_TX_AT_R &&
+           !(tx.options & MCD_TX_OPT_SIDE_EFFECTS);
+}
+
+struct TxPacket {
+    struct Entry {
+        uint32_t client_index;
+        /* the client transaction or one of its fragments */
+        mcd_tx_st *client_tx;
+        TxAdapter *tx_adapter;
+        mcd_txlist_st server_request;
+        /* index of the first server transaction in tx */
+        uint32_t offset;
+        /* the adapter could not convert the transaction */
+        bool skipped;
+        /* answered from the register or memory cache */
+        bool cached;
+        /* the response may be stored in the cache, see TargetCache */
+        uint64_t cache_ticket;
+        /* client_tx reads into a buffer of the pipeline, the bytes of the
+         * client transaction start at data_offset */
+        bool buffered;
+        uint32_t data_offset;
+        /* client_tx also reads the num_merged following client
+         * transactions, see coalesce_reads */
+        uint32_t num_merged;
+        /* client_tx reads whole pages for the memory cache */
+        bool page_fill;
+        /* the client transaction is completed by its last fragment */
+        bool fragment;
+        bool last_fragment;
+
+        /*
+         * The server transaction reads more than the client transactions, so
+         * its failure does not imply that they fail.
+         */
+        bool speculative() const
+        {
+            return !cached && (num_merged > 0 || page_fill);
+        }
+    };
+
+    std::vector<Entry> entries;
+    std::vector<mcd_tx_st> tx;
+    uint32_t size{marshal_mcd_execute_txlist_bound()};
+
+    /* valid once the packet has been sent */
+    uint32_t request_id{0};
+    mcd_txlist_st server_txlist{};
+    mcd_execute_txlist_result res{};
+
+    /*
+     * Set by collect if a speculative read failed or came back short: the
+     * index of its entry and of the first client transaction it did not
+     * complete.
+     */
+    size_t failed_read{SIZE_MAX};
+    uint32_t retry_index{0};
+
+    bool empty() const { return entries.empty(); }
+
+    bool speculative() const
+    {
+        return std::any_of(entries.begin(), entries.end(),
+                           [](const Entry &e) { return e.speculative(); });
     }
 
-    if (txlist->num_tx == 0) {
-        last_error = &MCD_ERROR_NONE;
-        return last_error->return_status;
+    bool idempotent() const
+    {
+        return std::all_of(entries.begin(), entries.end(), [](const Entry &e) {
+            return e.skipped || e.cached || plain_read(*e.client_tx);
+        });
     }
 
-    if (!g_mcd_server) {
-        last_error = &MCD_ERROR_SERVER_NOT_OPEN;
-        return last_error->return_status;
+    /* A single request which exceeds the packet size is sent on its own */
+    bool fits(const mcd_txlist_st &server_request) const
+    {
+        uint32_t s{size};
+        for (uint32_t i = 0; i < server_request.num_tx; i++) {
+            s += marshal_mcd_tx_st_bound(server_request.tx + i);
+        }
+        return tx.empty() || s <= MCD_MAX_PACKET_LENGTH;
     }
 
-    Core *adapter{(Core *)core->instance};
+    void add(const Entry &entry)
+    {
+        const mcd_txlist_st &server_request{entry.server_request};
+        entries.push_back(entry);
+        entries.back().offset = (uint32_t)tx.size();
 
-    if (!adapter->core_database_updated()) {
-        custom_mcd_error = {
-            .return_status{MCD_RET_ACT_HANDLE_ERROR},
-            .error_code{MCD_ERR_GENERAL},
-            .error_events{MCD_ERR_EVT_NONE},
-            .error_str{"core database not updated"},
-        };
-        last_error = &custom_mcd_error;
-        return last_error->return_status;
+        for (uint32_t i = 0; i < server_request.num_tx; i++) {
+            mcd_tx_st server_tx{server_request.tx[i]};
+            server_tx.num_bytes_ok = 0;
+            tx.push_back(server_tx);
+            size += marshal_mcd_tx_st_bound(&server_tx);
+        }
     }
 
-    /* we only have a limited buffer size to communicate with the server */
-    if (txlist->num_tx > 1) {
-        txlist->num_tx_ok = 0;
-        for (uint32_t i = 0; i < txlist->num_tx; i++) {
-            mcd_txlist_st tx{
-                .tx{txlist->tx + i},
-                .num_tx{1},
-                .num_tx_ok{0},
-            };
+    void skip(const Entry &entry)
+    {
+        entries.push_back(entry);
+        entries.back().skipped = true;
+    }
 
-            mcd_return_et ret{mcd_execute_txlist_f(core, &tx)};
-            if (ret == MCD_RET_ACT_NONE) {
-                txlist->num_tx_ok++;
-            } else {
-                return ret;
+    void answer(const Entry &entry)
+    {
+        entries.push_back(entry);
+        entries.back().cached = true;
+    }
+
+    /* Takes over an entry of another packet which has not been executed */
+    void requeue(const Entry &entry)
+    {
+        if (entry.skipped || entry.cached) {
+            entries.push_back(entry);
+        } else {
+            add(entry);
+        }
+    }
+
+    void clear()
+    {
+        for (Entry &e : entries) {
+            if (!e.skipped && !e.cached) {
+                e.tx_adapter->free_server_request(std::move(e.server_request));
             }
         }
+        entries.clear();
+        tx.clear();
+        size = marshal_mcd_execute_txlist_bound();
+        server_txlist = {};
+        res = {};
+        failed_read = SIZE_MAX;
+        retry_index = 0;
+    }
 
-        last_error = &MCD_ERROR_NONE;
-        return last_error->return_status;
+    /*
+     * Extracts the bytes of the client transactions from the buffer read.
+     * Returns the number of leading client transactions which are complete.
+     */
+    static uint32_t scatter(const Entry &e, mcd_txlist_st *txlist)
+    {
+        const mcd_tx_st &buffer{*e.client_tx};
+        const uint64_t begin{txlist->tx[e.client_index].addr.address};
+        uint32_t num_complete{0};
+        bool complete{true};
+        for (uint32_t n = 0; n <= e.num_merged; n++) {
+            mcd_tx_st &client_tx{txlist->tx[e.client_index + n]};
+            const uint64_t offset{e.data_offset + client_tx.addr.address -
+                                  begin};
+            uint32_t num_bytes_ok{0};
+            if (buffer.num_bytes_ok > offset) {
+                num_bytes_ok = buffer.num_bytes_ok - (uint32_t)offset;
+                if (num_bytes_ok > client_tx.num_bytes) {
+                    num_bytes_ok = client_tx.num_bytes;
+                }
+            }
+            memcpy(client_tx.data, buffer.data + offset, num_bytes_ok);
+            client_tx.num_bytes_ok = num_bytes_ok;
+
+            complete = complete && num_bytes_ok == client_tx.num_bytes;
+            if (complete) {
+                num_complete++;
+            }
+        }
+        return num_complete;
+    }
+
+    /* Keeps the memory cache from extending reads into a failed range */
+    static void fill_failed(const Entry &e, const mcd_txlist_st *txlist,
+                            Core &core)
+    {
+        uint64_t client_end{0};
+        for (uint32_t n = 0; n <= e.num_merged; n++) {
+            const mcd_tx_st &client_tx{txlist->tx[e.client_index + n]};
+            client_end = std::max(client_end, client_tx.addr.address +
+                                                  client_tx.num_bytes);
+        }
+        core.memory_cache.fill_failed(*e.client_tx, client_end);
     }
 
-    mcd_tx_st &client_tx{txlist->tx[0]};
-    TxAdapter *tx_adapter;
-    if (adapter->get_tx_adapter(
-        client_tx.addr, &tx_adapter, custom_mcd_error)) {
+    /* Fails a client transaction of which a fragment has not been completed */
+    static void short_fragment()
+    {
+        custom_mcd_error = {
+            .return_status{MCD_RET_ACT_HANDLE_ERROR},
+            .error_code{MCD_ERR_TXLIST_TX},
+            .error_events{MCD_ERR_EVT_NONE},
+            .error_str{"fragment of a transaction not completed"},
+        };
         last_error = &custom_mcd_error;
-        return last_error->return_status;
     }
 
-    mcd_txlist_st server_request;
-    tx_adapter->grant_server_access(core);
-    if (tx_adapter->yield_server_request(
-            client_tx, server_request, custom_mcd_error) != MCD_RET_ACT_NONE) {
-        /* skip transaction */
-        txlist->tx[0].num_bytes_ok = 0;
-        txlist->num_tx_ok = 1;
+    /*
+     * Hands the server's response back to the client transactions. On success,
+     * txlist->num_tx_ok is increased by the number of client transactions in
+     * the packet. On failure, only client transactions whose server
+     * transactions all succeeded are counted. If a speculative read failed or
+     * came back short, collecting stops there with failed_read set instead of
+     * an error. Collecting starts at the entry first, so it can be resumed
+     * after such a read. Successful reads are stored in the caches of the
+     * core if they accept them.
+     */
+    mcd_return_et collect(mcd_txlist_st *txlist, Core &core, size_t first = 0)
+    {
         last_error = &MCD_ERROR_NONE;
+        for (size_t index = first; index < entries.size(); index++) {
+            Entry &e{entries[index]};
+
+            if (last_error != &MCD_ERROR_NONE) {
+                /* a preceding transaction failed */
+                break;
+            }
+
+            mcd_tx_st &client_tx{txlist->tx[e.client_index]};
+
+            if (e.skipped && e.fragment) {
+                /* the client transaction cannot be completed anymore */
+                short_fragment();
+                break;
+            }
+
+            if (e.skipped) {
+                client_tx.num_bytes_ok = 0;
+                txlist->num_tx_ok++;
+                continue;
+            }
+
+            if (e.cached) {
+                if (e.buffered) {
+                    scatter(e, txlist);
+                }
+                txlist->num_tx_ok += 1 + e.num_merged;
+                continue;
+            }
+
+            uint32_t num_tx_ok{0};
+            if (server_txlist.num_tx_ok > e.offset) {
+                num_tx_ok = server_txlist.num_tx_ok - e.offset;
+                if (num_tx_ok > e.server_request.num_tx) {
+                    num_tx_ok = e.server_request.num_tx;
+                }
+            }
+
+            const mcd_txlist_st server_response{
+                .tx{server_txlist.tx + e.offset},
+                .num_tx{e.server_request.num_tx},
+                .num_tx_ok{num_tx_ok},
+            };
+
+            if (res.return_status != MCD_RET_ACT_NONE &&
+                num_tx_ok < e.server_request.num_tx) {
+                /* collect anyway such that num_bytes_ok reflects the partial
+                 * transfer of the failed transaction */
+                e.tx_adapter->collect_client_response(
+                    *e.client_tx, server_response, custom_mcd_error);
+                if (e.fragment) {
+                    client_tx.num_bytes_ok += e.client_tx->num_bytes_ok;
+                } else if (e.speculative()) {
+                    if (e.page_fill) {
+                        fill_failed(e, txlist, core);
+                    }
+                    uint32_t num_complete{scatter(e, txlist)};
+                    txlist->num_tx_ok += num_complete;
+                    failed_read = index;
+                    retry_index = e.client_index + num_complete;
+                    return MCD_RET_ACT_NONE;
+                } else if (e.buffered) {
+                    txlist->num_tx_ok += scatter(e, txlist);
+                }
+                return server_error(res.return_status, &core);
+            }
+
+            if (e.tx_adapter->collect_client_response(
+                    *e.client_tx, server_response, custom_mcd_error) !=
+                MCD_RET_ACT_NONE) {
+                last_error = &custom_mcd_error;
+            } else if (e.buffered) {
+                const uint32_t num_complete{scatter(e, txlist)};
+                if (e.speculative() && num_complete < 1 + e.num_merged) {
+                    /* the bytes beyond the client's might be missing */
+                    if (e.page_fill) {
+                        fill_failed(e, txlist, core);
+                    }
+                    txlist->num_tx_ok += num_complete;
+                    failed_read = index;
+                    retry_index = e.client_index + num_complete;
+                    return MCD_RET_ACT_NONE;
+                }
+                if (e.page_fill) {
+                    core.memory_cache.fill(*e.client_tx, e.cache_ticket);
+                } else if (e.cache_ticket) {
+                    core.register_cache.fill(*e.client_tx, e.cache_ticket);
+                }
+                txlist->num_tx_ok += 1 + e.num_merged;
+            } else if (!e.fragment) {
+                if (e.cache_ticket) {
+                    core.register_cache.fill(client_tx, e.cache_ticket);
+                }
+                txlist->num_tx_ok++;
+            } else {
+                client_tx.num_bytes_ok += e.client_tx->num_bytes_ok;
+                if (e.client_tx->num_bytes_ok < e.client_tx->num_bytes) {
+                    short_fragment();
+                } else if (e.last_fragment &&
+                           client_tx.num_bytes_ok == client_tx.num_bytes) {
+                    txlist->num_tx_ok++;
+                }
+            }
+        }
+
         return last_error->return_status;
     }
+};
 
-    mcd_execute_txlist_args args{
-        .core_uid{adapter->core_uid},
-        .txlist{&server_request},
-    };
+/*
+ * Largest transaction which fits into a packet on its own. The bounds depend
+ * on the data encoding negotiated with the server.
+ */
+static uint32_t max_tx_num_bytes()
+{
+    uint32_t lo{0}, hi{MCD_MAX_PACKET_LENGTH};
+    while (lo < hi) {
+        mcd_tx_st tx{};
+        tx.num_bytes = lo + (hi - lo + 1) / 2;
+        if (marshal_mcd_execute_txlist_bound() + marshal_mcd_tx_st_bound(&tx) <=
+            MCD_MAX_PACKET_LENGTH) {
+            lo = tx.num_bytes;
+        } else {
+            hi = tx.num_bytes - 1;
+        }
+    }
+    return lo;
+}
+
+/*
+ * Coalescing of reads
+ *
+ * Clients often read adjacent memory in many small transactions, e.g. a
+ * struct field by field. Consecutive reads of the same memory space which
+ * are contiguous, overlap or are at most TX_COALESCE_GAP bytes apart are
+ * fetched by a single server transaction. Its data is scattered back into
+ * the client transactions by TxPacket::scatter.
+ *
+ * Only memory is merged, neither registers nor reads with side effects, since
+ * the server would also read the gaps between them and read overlapping bytes
+ * only once. The merged read stays within the bounds of the memory space, but
+ * a gap might still be unmapped. If the merged read fails, the client
+ * transactions it did not complete are retried on their own, see
+ * TxPipeline::retry.
+ */
+static constexpr uint32_t TX_COALESCE_GAP{64};
 
-    uint32_t req_len{marshal_mcd_execute_txlist_args(
-        &args, g_mcd_server->msg_buf, MCD_MAX_PACKET_LENGTH)};
+static bool coalescable(const mcd_tx_st &tx, const mcd_memspace_st &ms)
+{
+    const uint64_t end{tx.addr.address + tx.num_bytes};
+    return tx.access_type == MCD_TX_AT_R && tx.num_bytes > 0 &&
+           !(tx.options & (MCD_TX_OPT_SIDE_EFFECTS | MCD_TX_OPT_NOINCREMENT)) &&
+           (tx.access_width <= 1 || tx.num_bytes % tx.access_width == 0) &&
+           end > tx.addr.address && tx.addr.address >= ms.min_addr &&
+           (ms.max_addr == 0 || end - 1 <= ms.max_addr);
+}
 
-    if (req_len == 0) {
+/*
+ * Determines the range of the reads which can be merged with the client
+ * transaction at index first. Returns the number of following transactions
+ * merged, merged is only set if this is nonzero.
+ */
+static uint32_t coalesce_reads(const mcd_txlist_st &txlist, uint32_t first,
+                               const mcd_memspace_st &ms,
+                               uint32_t max_num_bytes, mcd_tx_st &merged)
+{
+    const mcd_tx_st &head{txlist.tx[first]};
+    if ((ms.mem_type & MCD_MEM_SPACE_IS_REGISTERS) || !coalescable(head, ms)) {
+        return 0;
+    }
+
+    const uint64_t begin{head.addr.address};
+    uint64_t end{begin + head.num_bytes};
+
+    uint32_t num_merged{0};
+    for (uint32_t i = first + 1; i < txlist.num_tx; i++) {
+        const mcd_tx_st &tx{txlist.tx[i]};
+        const uint64_t tx_begin{tx.addr.address};
+        const uint64_t tx_end{tx_begin + tx.num_bytes};
+        if (!coalescable(tx, ms) || tx.options != head.options ||
+            tx.access_width != head.access_width ||
+            tx.core_mode != head.core_mode ||
+            tx.addr.mem_space_id != head.addr.mem_space_id ||
+            tx.addr.addr_space_id != head.addr.addr_space_id ||
+            tx.addr.addr_space_type != head.addr.addr_space_type ||
+            tx_begin < begin || tx_begin > end + TX_COALESCE_GAP ||
+            (head.access_width > 1 &&
+             (tx_begin - begin) % head.access_width != 0)) {
+            break;
+        }
+
+        const uint64_t merged_end{tx_end > end ? tx_end : end};
+        if (merged_end - begin > max_num_bytes) {
+            break;
+        }
+        end = merged_end;
+        num_merged++;
+    }
+
+    if (num_merged > 0) {
+        merged = head;
+        merged.num_bytes = (uint32_t)(end - begin);
+        merged.num_bytes_ok = 0;
+    }
+    return num_merged;
+}
+
+/*
+ * Pipelining of transaction lists
+ *
+ * Packets are sent without awaiting the responses to the preceding ones as
+ * long as no more than MCDServer::window() requests are pending. The server
+ * answers in order, so the responses are collected from the oldest packet on.
+ *
+ * If a packet fails, the packets sent after it might have been executed by the
+ * server already. Their responses are received and dropped such that they are
+ * neither counted in num_tx_ok nor mistaken for the response to a later call.
+ *
+ * A packet with a speculative read is not followed by another one before its
+ * response has arrived, and within the packet only plain reads follow it. If
+ * the read fails, the transactions after it have not been executed and can be
+ * sent again in their order. If it comes back short, the server executed
+ * them, but retrying the read after them changes nothing since none of them
+ * has side effects.
+ *
+ * A packet which is not idempotent, e.g. one with writes, is only sent when
+ * no other packet is pending. Otherwise the server might execute it although
+ * a preceding packet failed, and a client which repeats the transactions
+ * from num_tx_ok on would execute it twice. Reads after a failed packet are
+ * executed in vain, but repeating them is harmless.
+ */
+
+class TxPipeline
+{
+    const mcd_core_st *core;
+    mcd_txlist_st *txlist;
+    /* sent packets in the order of their responses */
+    std::deque<TxPacket> pending;
+
+    mcd_return_et receive()
+    {
+        TxPacket &p{pending.front()};
+
+        if (p.server_txlist.num_tx > 0 &&
+            receive_result<mcd_execute_txlist_args>(
+                p.request_id, p.res, custom_mcd_error) != MCD_RET_ACT_NONE) {
+            /* the response is lost or unreadable, drop the pending ones */
+            p.clear();
+            pending.pop_front();
+            discard();
+            last_error = &custom_mcd_error;
+            return last_error->return_status;
+        }
+
+        Core *adapter{(Core *)core->instance};
+        mcd_return_et ret{p.collect(txlist, *adapter)};
+        if (p.failed_read < p.entries.size()) {
+            return retry();
+        }
+        p.clear();
+        pending.pop_front();
+
+        if (ret != MCD_RET_ACT_NONE) {
+            discard();
+        }
+
+        return ret;
+    }
+
+    /*
+     * Executes the client transactions of a failed or short speculative read
+     * one by one. If the server went on with the rest of the packet, its
+     * response is collected, otherwise the rest is sent again.
+     */
+    mcd_return_et retry()
+    {
+        Core *adapter{(Core *)core->instance};
+        TxPacket &p{pending.front()};
+        mcd_return_et ret{MCD_RET_ACT_NONE};
+        while (p.failed_read < p.entries.size()) {
+            const TxPacket::Entry &failed{p.entries[p.failed_read]};
+            const uint32_t end{failed.client_index + failed.num_merged + 1};
+            for (uint32_t i = p.retry_index; i < end; i++) {
+                ret = execute_single(i);
+                if (ret != MCD_RET_ACT_NONE) {
+                    p.clear();
+                    pending.pop_front();
+                    discard();
+                    return ret;
+                }
+            }
+
+            if (p.server_txlist.num_tx_ok <
+                failed.offset + failed.server_request.num_tx) {
+                break;
+            }
+            const size_t next{p.failed_read + 1};
+            p.failed_read = SIZE_MAX;
+            ret = p.collect(txlist, *adapter, next);
+        }
+
+        if (p.failed_read >= p.entries.size()) {
+            /* the server executed the whole packet */
+            p.clear();
+            pending.pop_front();
+            if (ret != MCD_RET_ACT_NONE) {
+                discard();
+            }
+            return ret;
+        }
+
+        TxPacket rest;
+        for (size_t i = p.failed_read + 1; i < p.entries.size(); i++) {
+            rest.requeue(p.entries[i]);
+        }
+        p.entries.resize(p.failed_read + 1);
+        p.clear();
+        pending.pop_front();
+
+        if (rest.empty()) {
+            return MCD_RET_ACT_NONE;
+        }
+        pending.push_back(std::move(rest));
+        ret = send();
+        if (ret != MCD_RET_ACT_NONE) {
+            return ret;
+        }
+        return receive();
+    }
+
+    /* Executes a client transaction on its own, without any speculation */
+    mcd_return_et execute_single(uint32_t index)
+    {
+        Core *adapter{(Core *)core->instance};
+        mcd_tx_st &client_tx{txlist->tx[index]};
+        mcd_txlist_st single{
+            .tx{&client_tx},
+            .num_tx{1},
+            .num_tx_ok{0},
+        };
+
+        TxAdapter *tx_adapter;
+        mcd_error_info_st adapter_error;
+        if (adapter->get_tx_adapter(client_tx.addr, &tx_adapter,
+                                    adapter_error) != MCD_RET_ACT_NONE) {
+            custom_mcd_error = adapter_error;
+            last_error = &custom_mcd_error;
+            return last_error->return_status;
+        }
+
+        TxPipeline pipeline{core, &single};
+        mcd_return_et ret{pipeline.submit({
+            .client_index{0},
+            .client_tx{&client_tx},
+            .tx_adapter{tx_adapter},
+            .server_request{},
+            .offset{0},
+            .skipped{false},
+            .cached{false},
+            .cache_ticket{0},
+            .buffered{false},
+            .data_offset{0},
+            .num_merged{0},
+            .page_fill{false},
+            .fragment{false},
+            .last_fragment{false},
+        })};
+        if (ret == MCD_RET_ACT_NONE) {
+            ret = pipeline.drain();
+        }
+        txlist->num_tx_ok += single.num_tx_ok;
+        return ret;
+    }
+
+    /*
+     * Receives and drops the responses to the pending packets. A response
+     * which cannot be read is dropped as well, the I/O thread would keep the
+     * later ones otherwise. Only a lost connection takes all of them along.
+     */
+    void discard()
+    {
+        mcd_error_info_st error;
+        while (!pending.empty()) {
+            TxPacket &p{pending.front()};
+            if (p.server_txlist.num_tx > 0 &&
+                receive_result<mcd_execute_txlist_args>(p.request_id, p.res,
+                                                        error) !=
+                    MCD_RET_ACT_NONE &&
+                !g_mcd_server->is_connected()) {
+                clear();
+                return;
+            }
+            p.clear();
+            pending.pop_front();
+        }
+        packet.clear();
+    }
+
+    void clear()
+    {
+        for (TxPacket &p : pending) {
+            p.clear();
+        }
+        pending.clear();
+        packet.clear();
+    }
+
+    /* Sends the newest pending packet */
+    mcd_return_et send()
+    {
+        TxPacket &p{pending.back()};
+        p.server_txlist = {
+            .tx{p.tx.data()},
+            .num_tx{(uint32_t)p.tx.size()},
+            .num_tx_ok{0},
+        };
+        p.res = {
+            .return_status{MCD_RET_ACT_NONE},
+            .txlist{&p.server_txlist},
+        };
+
+        if (p.server_txlist.num_tx == 0) {
+            /* no transaction for the server, e.g. all answered by caches */
+            return MCD_RET_ACT_NONE;
+        }
+
+        Core *adapter{(Core *)core->instance};
+        mcd_execute_txlist_args args{
+            .core_uid{adapter->core_uid},
+            .txlist{&p.server_txlist},
+        };
+
+        if (send_request(args, p.request_id, custom_mcd_error) ==
+            MCD_RET_ACT_NONE) {
+            return MCD_RET_ACT_NONE;
+        }
+
+        if (custom_mcd_error.error_code != MCD_ERR_RPC_MARSHAL) {
+            clear();
+            last_error = &custom_mcd_error;
+            return last_error->return_status;
+        }
+
+        /* the packet was not sent, the pending ones are still answered */
+        p.clear();
+        pending.pop_back();
+        mcd_return_et ret{drain()};
+        if (ret != MCD_RET_ACT_NONE) {
+            return ret;
+        }
         last_error = &MCD_ERROR_MARSHAL;
         return last_error->return_status;
     }
 
+public:
+    /* packet which is currently filled */
+    TxPacket packet;
+
+    /* fragments and page reads of client transactions */
+    std::deque<mcd_tx_st> fragments;
+
+    /* data of the pages read for the memory cache and of coalesced reads */
+    std::deque<std::vector<uint8_t>> buffers;
+
+    TxPipeline(const mcd_core_st *core, mcd_txlist_st *txlist)
+        : core{core}, txlist{txlist}
+    {
+    }
+
     /*
-     * Since the server request has been serialized into the buffer,
-     * its object is no longer required
+     * Converts a client transaction (or a fragment of it) by its adapter and
+     * appends the result to the current packet.
      */
-    tx_adapter->free_server_request(std::move(server_request));
+    mcd_return_et submit(const TxPacket::Entry &entry)
+    {
+        TxAdapter *tx_adapter{entry.tx_adapter};
+
+        /*
+         * Transactions issued by the adapter itself must not overtake the
+         * preceding transactions of the client.
+         */
+        if (tx_adapter->accesses_server()) {
+            mcd_return_et ret{drain()};
+            if (ret != MCD_RET_ACT_NONE) {
+                return ret;
+            }
+        }
 
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+        TxPacket::Entry e{entry};
+        mcd_error_info_st adapter_error;
+        tx_adapter->grant_server_access(core);
+        if (tx_adapter->yield_server_request(*e.client_tx, e.server_request,
+                                             adapter_error) !=
+            MCD_RET_ACT_NONE) {
+            packet.skip(e);
+            return MCD_RET_ACT_NONE;
+        }
+
+        if (!packet.fits(e.server_request) ||
+            (packet.speculative() && !plain_read(*e.client_tx))) {
+            mcd_return_et ret{flush()};
+            if (ret != MCD_RET_ACT_NONE) {
+                tx_adapter->free_server_request(std::move(e.server_request));
+                return ret;
+            }
+        }
+
+        packet.add(e);
+        return MCD_RET_ACT_NONE;
+    }
+
+    /*
+     * Sends the current packet. Responses are only awaited if the window of
+     * pending requests is full.
+     */
+    mcd_return_et flush()
+    {
+        if (packet.empty()) {
+            return MCD_RET_ACT_NONE;
+        }
+
+        while (pending.size() >= g_mcd_server->window() ||
+               (!pending.empty() && (pending.back().speculative() ||
+                                     !packet.idempotent()))) {
+            mcd_return_et ret{receive()};
+            if (ret != MCD_RET_ACT_NONE) {
+                return ret;
+            }
+        }
+
+        pending.push_back(std::move(packet));
+        packet = {};
+        return send();
+    }
+
+    /*
+     * Sends the current packet and collects the responses to all pending
+     * requests.
+     */
+    mcd_return_et drain()
+    {
+        mcd_return_et ret{flush()};
+        while (ret == MCD_RET_ACT_NONE && !pending.empty()) {
+            ret = receive();
+        }
+        return ret;
+    }
+
+    /*
+     * Sends the deferred writes of the core after the transactions submitted
+     * so far, before a transaction which conflicts with them.
+     */
+    mcd_return_et flush_writes()
+    {
+        mcd_return_et ret{drain()};
+        if (ret != MCD_RET_ACT_NONE) {
+            return ret;
+        }
+        return flush_write_buffer(core);
+    }
+};
+
+/*
+ * Events announce that the target changed without a request of the client,
+ * e.g. a core resumed from the QEMU monitor. The register values of any core
+ * might have changed then.
+ */
+static void observe_events()
+{
+    std::vector<char> event;
+    bool changed{false};
+    while (g_mcd_server->next_event(event)) {
+        changed = true;
+    }
+    if (changed) {
+        TargetCache::invalidate_all();
+    }
+}
+
+mcd_return_et mcd_execute_txlist_f(const mcd_core_st *core,
+                                   mcd_txlist_st *txlist)
+{
+    ServerAccess access{};
+
+    if (!core || !core->instance || !txlist) {
+        last_error = &MCD_ERROR_INVALID_NULL_PARAM;
+        return last_error->return_status;
+    }
+
+    if (txlist->num_tx == 0) {
+        last_error = &MCD_ERROR_NONE;
+        return last_error->return_status;
+    }
+
+    if (!g_mcd_server) {
+        last_error = &MCD_ERROR_SERVER_NOT_OPEN;
+        return last_error->return_status;
+    }
+
+    Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
+
+    if (!adapter->core_database_updated()) {
+        custom_mcd_error = {
+            .return_status{MCD_RET_ACT_HANDLE_ERROR},
+            .error_code{MCD_ERR_GENERAL},
+            .error_events{MCD_ERR_EVT_NONE},
+            .error_str{"core database not updated"},
+        };
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_execute_txlist_result res{
-        .txlist{txlist},
-    };
+    txlist->num_tx_ok = 0;
+    observe_events();
 
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
+    return execute_txlist(core, txlist, true);
+}
+
+/*
+ * Executes a transaction list on a core whose lock is held. Writes are only
+ * deferred by the write buffer of the core if defer_writes is set, i.e. not
+ * while the buffer itself is flushed.
+ */
+static mcd_return_et execute_txlist(const mcd_core_st *core,
+                                    mcd_txlist_st *txlist, bool defer_writes)
+{
+    Core *adapter{(Core *)core->instance};
+    const uint32_t max_num_bytes{max_tx_num_bytes()};
+    TxPipeline pipeline{core, txlist};
+    for (uint32_t i = 0; i < txlist->num_tx; i++) {
+        mcd_tx_st &client_tx{txlist->tx[i]};
+        mcd_error_info_st adapter_error;
+
+        TxAdapter *tx_adapter;
+        if (adapter->get_tx_adapter(client_tx.addr, &tx_adapter,
+                                    adapter_error) != MCD_RET_ACT_NONE) {
+            /* the preceding transactions are executed nevertheless */
+            mcd_return_et ret{pipeline.drain()};
+            if (ret != MCD_RET_ACT_NONE) {
+                return ret;
+            }
+            custom_mcd_error = adapter_error;
+            last_error = &custom_mcd_error;
             return last_error->return_status;
         }
-        status = unmarshal_mcd_execute_txlist_result(g_mcd_server->msg_buf,
-                                                     &res, &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
 
-    if (res.return_status != MCD_RET_ACT_NONE) {
-        last_error = &MCD_ERROR_ASK_SERVER;
-        return res.return_status;
-    }
+        TxPacket::Entry entry{
+            .client_index{i},
+            .client_tx{&client_tx},
+            .tx_adapter{tx_adapter},
+            .server_request{},
+            .offset{0},
+            .skipped{false},
+            .cached{false},
+            .cache_ticket{0},
+            .buffered{false},
+            .data_offset{0},
+            .num_merged{0},
+            .page_fill{false},
+            .fragment{false},
+            .last_fragment{false},
+        };
 
-    if (tx_adapter->collect_client_response(
-            client_tx, *txlist, custom_mcd_error) != MCD_RET_ACT_NONE) {
-        last_error = &custom_mcd_error;
-    } else {
-        txlist->num_tx_ok++;
-        last_error = &MCD_ERROR_NONE;
+        /* adapters which issue transactions on their own convert each
+         * client transaction separately */
+        const mcd_memspace_st *ms{
+            adapter->find_memory_space(client_tx.addr.mem_space_id)};
+        mcd_tx_st merged;
+        if (ms && !tx_adapter->accesses_server()) {
+            entry.num_merged =
+                coalesce_reads(*txlist, i, *ms, max_num_bytes, merged);
+        }
+        if (entry.num_merged > 0) {
+            std::vector<uint8_t> &data{
+                pipeline.buffers.emplace_back(merged.num_bytes)};
+            merged.data = data.data();
+            entry.client_tx = &pipeline.fragments.emplace_back(merged);
+            entry.buffered = true;
+            i += entry.num_merged;
+        }
+        mcd_tx_st &tx{*entry.client_tx};
+
+        RegisterCache &registers{adapter->register_cache};
+        MemoryCache &memory{adapter->memory_cache};
+        registers.write(tx);
+        memory.write(tx);
+
+        /* a write is completed once it is deferred */
+        WriteBuffer &writes{adapter->write_buffer};
+        const bool chained{
+            entry.client_index > 0 &&
+            (txlist->tx[entry.client_index - 1].options &
+             MCD_TX_OPT_ATOMIC_WITH_NEXT)};
+        if (defer_writes && writes.deferrable(tx, chained)) {
+            if (writes.conflicts(tx, chained)) {
+                mcd_return_et ret{pipeline.flush_writes()};
+                if (ret != MCD_RET_ACT_NONE) {
+                    return ret;
+                }
+            }
+            writes.add(tx);
+            tx.num_bytes_ok = tx.num_bytes;
+            pipeline.packet.answer(entry);
+            continue;
+        }
+
+        uint64_t page_ticket{0};
+        if (registers.read(tx, entry.cache_ticket) ||
+            (!entry.cache_ticket && memory.read(tx, page_ticket))) {
+            pipeline.packet.answer(entry);
+            continue;
+        }
+
+        /* a read which missed the memory cache fetches whole pages */
+        mcd_tx_st fill{};
+        if (page_ticket) {
+            memory.fill_range(tx, fill, max_num_bytes);
+        }
+        if (page_ticket && fill.num_bytes <= max_num_bytes &&
+            fill.num_bytes / MemoryCache::PAGE_SIZE <= memory.get_capacity()) {
+            std::vector<uint8_t> &data{
+                pipeline.buffers.emplace_back(fill.num_bytes)};
+            fill.data = data.data();
+            entry.client_tx = &pipeline.fragments.emplace_back(fill);
+            entry.cache_ticket = page_ticket;
+            entry.buffered = true;
+            entry.data_offset =
+                (uint32_t)(tx.addr.address - fill.addr.address);
+            entry.page_fill = true;
+        }
+
+        if (defer_writes && writes.conflicts(*entry.client_tx, chained)) {
+            mcd_return_et ret{pipeline.flush_writes()};
+            if (ret != MCD_RET_ACT_NONE) {
+                return ret;
+            }
+        }
+
+        if (tx.num_bytes <= max_num_bytes) {
+            mcd_return_et ret{pipeline.submit(entry)};
+            if (ret != MCD_RET_ACT_NONE) {
+                return ret;
+            }
+            continue;
+        }
+
+        /*
+         * A transaction which does not fit into a packet is split into
+         * fragments. Their data refers to the client's buffer, so it is
+         * transferred in place.
+         */
+        uint32_t fragment_size{max_num_bytes};
+        if (client_tx.access_width > 1) {
+            fragment_size -= fragment_size % client_tx.access_width;
+        }
+
+        client_tx.num_bytes_ok = 0;
+        entry.fragment = true;
+        for (uint32_t offset = 0; offset < client_tx.num_bytes;
+             offset += fragment_size) {
+            mcd_tx_st &fragment{pipeline.fragments.emplace_back(client_tx)};
+            fragment.data += offset;
+            fragment.num_bytes = client_tx.num_bytes - offset;
+            if (fragment.num_bytes > fragment_size) {
+                fragment.num_bytes = fragment_size;
+            }
+            if (!(client_tx.options & MCD_TX_OPT_NOINCREMENT)) {
+                fragment.addr.address += offset;
+            }
+
+            entry.client_tx = &fragment;
+            entry.last_fragment = offset + fragment.num_bytes ==
+                                  client_tx.num_bytes;
+
+            mcd_return_et ret{pipeline.submit(entry)};
+            if (ret != MCD_RET_ACT_NONE) {
+                return ret;
+            }
+        }
     }
 
-    return last_error->return_status;
+    return pipeline.drain();
 }
 
 mcd_return_et mcd_run_f(const mcd_core_st *core, mcd_bool_t global)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -1732,43 +2461,37 @@ mcd_return_et mcd_run_f(const mcd_core_st *core, mcd_bool_t global)
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
+
+    /* deferred writes take effect before the core executes */
+    if (flush_write_buffer(core) != MCD_RET_ACT_NONE) {
+        return last_error->return_status;
+    }
+
     mcd_run_args args{
         .core_uid{adapter->core_uid},
         .global{!!global},
     };
 
-    uint32_t req_len{marshal_mcd_run_args(&args, g_mcd_server->msg_buf,
-                                          MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
+    if (global) {
+        TargetCache::invalidate_all();
+    } else {
+        adapter->invalidate_caches();
     }
 
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    mcd_run_result res;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_run_result res;
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_run_result(g_mcd_server->msg_buf, &res,
-                                          &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_stop_f(const mcd_core_st *core, mcd_bool_t global)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -1780,40 +2503,19 @@ mcd_return_et mcd_stop_f(const mcd_core_st *core, mcd_bool_t global)
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
     mcd_stop_args args{
         .core_uid{adapter->core_uid},
         .global{!!global},
     };
 
-    uint32_t req_len{marshal_mcd_stop_args(&args, g_mcd_server->msg_buf,
-                                           MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    mcd_stop_result res;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_stop_result res;
-    mcd_return_et status;
-    do {
-        /* TODO: Delimiter Parameter */
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_stop_result(g_mcd_server->msg_buf, &res,
-                                           &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_run_until_f(const mcd_core_st *core, mcd_bool_t global,
@@ -1833,6 +2535,8 @@ mcd_return_et mcd_qry_current_time_f(const mcd_core_st *core,
 mcd_return_et mcd_step_f(const mcd_core_st *core, mcd_bool_t global,
                          mcd_core_step_type_et step_type, uint32_t n_steps)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -1844,6 +2548,13 @@ mcd_return_et mcd_step_f(const mcd_core_st *core, mcd_bool_t global,
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
+
+    /* deferred writes take effect before the core executes */
+    if (flush_write_buffer(core) != MCD_RET_ACT_NONE) {
+        return last_error->return_status;
+    }
+
     mcd_step_args args{
         .core_uid{adapter->core_uid},
         .global{!!global},
@@ -1851,39 +2562,25 @@ mcd_return_et mcd_step_f(const mcd_core_st *core, mcd_bool_t global,
         .n_steps{n_steps},
     };
 
-    uint32_t req_len{marshal_mcd_step_args(&args, g_mcd_server->msg_buf,
-                                           MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
+    if (global) {
+        TargetCache::invalidate_all();
+    } else {
+        adapter->invalidate_caches();
     }
 
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    mcd_step_result res;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_step_result res;
-    mcd_return_et status;
-    do {
-        /* TODO: Delimiter Parameter */
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_step_result(g_mcd_server->msg_buf, &res,
-                                           &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_set_global_f(const mcd_core_st *core, mcd_bool_t enable)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -1895,43 +2592,25 @@ mcd_return_et mcd_set_global_f(const mcd_core_st *core, mcd_bool_t enable)
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
     mcd_set_global_args args{
         .core_uid{adapter->core_uid},
         .enable{!!enable},
     };
 
-    uint32_t req_len{marshal_mcd_set_global_args(&args, g_mcd_server->msg_buf,
-                                                 MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    mcd_set_global_result res;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_set_global_result res;
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_set_global_result(g_mcd_server->msg_buf, &res,
-                                                 &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_qry_state_f(const mcd_core_st *core, mcd_core_state_st *state)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance || !state) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -1943,45 +2622,38 @@ mcd_return_et mcd_qry_state_f(const mcd_core_st *core, mcd_core_state_st *state)
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
     mcd_qry_state_args args{
         .core_uid{adapter->core_uid},
     };
 
-    uint32_t req_len{marshal_mcd_qry_state_args(&args, g_mcd_server->msg_buf,
-                                                MCD_MAX_PACKET_LENGTH)};
+    mcd_qry_state_result res{
+        .state{state},
+    };
 
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
+    /* the events of preceding steps must not invalidate the cache later */
+    observe_events();
+    const uint64_t epoch{TargetCache::current_epoch()};
 
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_qry_state_result res{
-        .state{state},
-    };
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_qry_state_result(g_mcd_server->msg_buf, &res,
-                                                &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
     if (state->state == MCD_CORE_STATE_HALTED &&
         strcmp(state->info_str, "halted") == 0) {
         state->state = MCD_CORE_STATE_RUNNING;
     }
 
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    if (res.return_status == MCD_RET_ACT_NONE &&
+        (state->state == MCD_CORE_STATE_HALTED ||
+         state->state == MCD_CORE_STATE_DEBUG)) {
+        adapter->set_halted(epoch);
+    } else {
+        adapter->invalidate_caches();
+    }
+
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_execute_command_f(const mcd_core_st *core,
@@ -1989,13 +2661,63 @@ mcd_return_et mcd_execute_command_f(const mcd_core_st *core,
                                     uint32_t result_string_size,
                                     mcd_char_t *result_string)
 {
-    last_error = &MCD_ERROR_NOT_IMPLEMENTED;
+    if (!core || !core->instance || !command_string ||
+        (result_string_size > 0 && !result_string)) {
+        last_error = &MCD_ERROR_INVALID_NULL_PARAM;
+        return last_error->return_status;
+    }
+
+    /* commands of the client stub itself, not forwarded to the server */
+    const bool flush{strcmp(command_string, "flush-writes") == 0};
+    if (!flush && strcmp(command_string, "cache-stats") != 0) {
+        last_error = &MCD_ERROR_NOT_IMPLEMENTED;
+        return last_error->return_status;
+    }
+
+    ServerAccess access{};
+    if (!g_mcd_server) {
+        last_error = &MCD_ERROR_SERVER_NOT_OPEN;
+        return last_error->return_status;
+    }
+
+    Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
+
+    if (flush) {
+        if (result_string_size > 0) {
+            result_string[0] = '\0';
+        }
+        return flush_write_buffer(core);
+    }
+
+    const WriteBuffer &writes{adapter->write_buffer};
+    if (result_string_size > 0) {
+        snprintf(result_string, result_string_size,
+                 "registers: %llu hits, %llu misses\n"
+                 "memory: %llu hits, %llu misses, %u/%u pages, "
+                 "read ahead %u pages\n"
+                 "writes: %llu deferred, %llu combined, %llu flushes",
+                 (unsigned long long)adapter->register_cache.hits,
+                 (unsigned long long)adapter->register_cache.misses,
+                 (unsigned long long)adapter->memory_cache.hits,
+                 (unsigned long long)adapter->memory_cache.misses,
+                 adapter->memory_cache.num_pages(),
+                 adapter->memory_cache.get_capacity(),
+                 adapter->memory_cache.get_read_ahead(),
+                 (unsigned long long)writes.deferred,
+                 (unsigned long long)writes.combined,
+                 (unsigned long long)writes.flushes);
+    }
+
+    last_error = &MCD_ERROR_NONE;
     return last_error->return_status;
 }
 
 mcd_return_et mcd_qry_rst_classes_f(const mcd_core_st *core,
                                     uint32_t *rst_class_vector)
 {
+    ServerAccess access{};
+
     if (!core || !core->instance || !rst_class_vector) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -2007,46 +2729,29 @@ mcd_return_et mcd_qry_rst_classes_f(const mcd_core_st *core,
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
     mcd_qry_rst_classes_args args{
         .core_uid{adapter->core_uid},
     };
 
-    uint32_t req_len{marshal_mcd_qry_rst_classes_args(
-        &args, g_mcd_server->msg_buf, MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
+    mcd_qry_rst_classes_result res{
+        .rst_class_vector{rst_class_vector},
+    };
 
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_qry_rst_classes_result res{
-        .rst_class_vector{rst_class_vector},
-    };
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_qry_rst_classes_result(g_mcd_server->msg_buf,
-                                                      &res, &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_qry_rst_class_info_f(const mcd_core_st *core,
                                        uint8_t rst_class,
                                        mcd_rst_info_st *rst_info)
 {
+    ServerAccess access{};
+
     if (!core || !rst_info) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -2058,47 +2763,29 @@ mcd_return_et mcd_qry_rst_class_info_f(const mcd_core_st *core,
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
     mcd_qry_rst_class_info_args args{
         .core_uid{adapter->core_uid},
         .rst_class{rst_class},
     };
 
-    uint32_t req_len{marshal_mcd_qry_rst_class_info_args(
-        &args, g_mcd_server->msg_buf, MCD_MAX_PACKET_LENGTH)};
-
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
-        last_error = &custom_mcd_error;
-        return last_error->return_status;
-    }
-
     mcd_qry_rst_class_info_result res{
         .rst_info{rst_info},
     };
-    mcd_return_et status;
 
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_qry_rst_class_info_result(
-            g_mcd_server->msg_buf, &res, &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
+        last_error = &custom_mcd_error;
+        return last_error->return_status;
+    }
 
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_rst_f(const mcd_core_st *core, uint32_t rst_class_vector,
                         mcd_bool_t rst_and_halt)
 {
+    ServerAccess access{};
+
     if (!core) {
         last_error = &MCD_ERROR_INVALID_NULL_PARAM;
         return last_error->return_status;
@@ -2110,40 +2797,29 @@ mcd_return_et mcd_rst_f(const mcd_core_st *core, uint32_t rst_class_vector,
     }
 
     Core *adapter{(Core *)core->instance};
+    std::lock_guard<std::recursive_mutex> core_lock{adapter->access};
+
+    /* deferred writes take effect before the core executes */
+    if (flush_write_buffer(core) != MCD_RET_ACT_NONE) {
+        return last_error->return_status;
+    }
+
     mcd_rst_args args{
         .core_uid{adapter->core_uid},
         .rst_class_vector{rst_class_vector},
         .rst_and_halt{!!rst_and_halt},
     };
 
-    uint32_t req_len{marshal_mcd_rst_args(&args, g_mcd_server->msg_buf,
-                                          MCD_MAX_PACKET_LENGTH)};
+    /* a reset class might cover other cores as well */
+    TargetCache::invalidate_all();
 
-    if (req_len == 0) {
-        last_error = &MCD_ERROR_MARSHAL;
-        return last_error->return_status;
-    }
-
-    if (g_mcd_server->send_message(req_len, custom_mcd_error) !=
-        MCD_RET_ACT_NONE) {
+    mcd_rst_result res;
+    if (invoke(args, res, custom_mcd_error) != MCD_RET_ACT_NONE) {
         last_error = &custom_mcd_error;
         return last_error->return_status;
     }
 
-    mcd_rst_result res;
-    mcd_return_et status;
-    do {
-        if (g_mcd_server->receive_messages(custom_mcd_error) !=
-            MCD_RET_ACT_NONE) {
-            last_error = &MCD_ERROR_MARSHAL;
-            return last_error->return_status;
-        }
-        status = unmarshal_mcd_rst_result(g_mcd_server->msg_buf, &res,
-                                          &custom_mcd_error);
-    } while (status != MCD_RET_ACT_NONE);
-
-    last_error = &MCD_ERROR_ASK_SERVER;
-    return res.return_status;
+    return server_error(res.return_status, adapter);
 }
 
 mcd_return_et mcd_chl_open_f(const mcd_core_st *core, mcd_chl_st *channel)
@@ -29,874 +29,2103 @@
 
 #include <string.h>
 
-#include <iostream>
-#include <sstream>
+#include <algorithm>
+#include <charconv>
+#include <span>
+#include <string_view>
+#include <type_traits>
 
 #include "json.hpp"
 #include "mcd_rpc.h"
 
-template <typename T>
-void json_get_to_optional(const nlohmann::json &j, const char *key, T &obj)
-{
-    if (j.contains(key)) {
-        j.at(key).get_to(obj);
+/*
+ * Encoding of memory data
+ *
+ * The data of a transaction is sent as a JSON array of numbers by default.
+ * With data=hex or data=base64 in the config string of mcd_open_server_f, the
+ * client offers a string encoding which is used once the server echoes the
+ * key in its response. Both directions use the same encoding.
+ */
+enum class DataEncoding { ARRAY, HEX, BASE64 };
+
+static DataEncoding data_encoding{DataEncoding::ARRAY};
+static DataEncoding data_encoding_requested{DataEncoding::ARRAY};
+
+static const char HEX_DIGITS[]{"0123456789abcdef"};
+static const char BASE64_DIGITS[]{
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"};
+
+/* value of every character, invalid ones (including '=') map to 0xff */
+struct DigitValues {
+    uint8_t hex[256];
+    uint8_t base64[256];
+
+    constexpr DigitValues() : hex{}, base64{}
+    {
+        for (int c{0}; c < 256; c++) {
+            hex[c] = 0xff;
+            base64[c] = 0xff;
+        }
+        for (uint8_t i{0}; i < 16; i++) {
+            hex[(uint8_t)HEX_DIGITS[i]] = i;
+            if (i >= 10) {
+                hex[(uint8_t)HEX_DIGITS[i] - 'a' + 'A'] = i;
+            }
+        }
+        for (uint8_t i{0}; i < 64; i++) {
+            base64[(uint8_t)BASE64_DIGITS[i]] = i;
+        }
     }
-}
+};
 
-#define JSON_STRING_GET_TO_ARRAY(j, key, arr) do {                     \
-    const std::string &_s = j.at(key);                                 \
-    _s.copy(arr, sizeof(arr));                                         \
-} while (0)
+static constexpr DigitValues DIGIT_VALUES{};
 
-void to_json(nlohmann::json &j, const mcd_core_con_info_st &info)
+static size_t hex_encode(const uint8_t *src, size_t n, char *dst)
 {
-    j = nlohmann::json{{"host", info.host},
-                       {"server-port", info.server_port},
-                       {"server-key", info.server_key},
-                       {"system-key", info.system_key},
-                       {"device-key", info.device_key},
-                       {"system", info.system},
-                       {"system-instance", info.system_instance},
-                       {"acc-hw", info.acc_hw},
-                       {"device-type", info.device_type},
-                       {"device", info.device},
-                       {"device-id", info.device_id},
-                       {"core", info.core},
-                       {"core-type", info.core_type},
-                       {"core-id", info.core_id}};
+    for (size_t i{0}; i < n; i++) {
+        dst[2 * i] = HEX_DIGITS[src[i] >> 4];
+        dst[2 * i + 1] = HEX_DIGITS[src[i] & 0xf];
+    }
+    return 2 * n;
+}
+
+/* with padding, see RFC 4648 */
+static size_t base64_encode(const uint8_t *src, size_t n, char *dst)
+{
+    char *tail{dst};
+    size_t i{0};
+    for (; i + 3 <= n; i += 3) {
+        uint32_t bits{(uint32_t)src[i] << 16 | (uint32_t)src[i + 1] << 8 |
+                      src[i + 2]};
+        tail[0] = BASE64_DIGITS[bits >> 18];
+        tail[1] = BASE64_DIGITS[(bits >> 12) & 0x3f];
+        tail[2] = BASE64_DIGITS[(bits >> 6) & 0x3f];
+        tail[3] = BASE64_DIGITS[bits & 0x3f];
+        tail += 4;
+    }
+    if (i < n) {
+        uint32_t bits{(uint32_t)src[i] << 16};
+        if (i + 1 < n) {
+            bits |= (uint32_t)src[i + 1] << 8;
+        }
+        tail[0] = BASE64_DIGITS[bits >> 18];
+        tail[1] = BASE64_DIGITS[(bits >> 12) & 0x3f];
+        tail[2] = i + 1 < n ? BASE64_DIGITS[(bits >> 6) & 0x3f] : '=';
+        tail[3] = '=';
+        tail += 4;
+    }
+    return (size_t)(tail - dst);
 }
 
-static void from_json(const nlohmann::json &j, mcd_core_con_info_st &info)
-{
-    JSON_STRING_GET_TO_ARRAY(j, "host", info.host);
-    j.at("server-port").get_to(info.server_port);
-    JSON_STRING_GET_TO_ARRAY(j, "server-key", info.server_key);
-    JSON_STRING_GET_TO_ARRAY(j, "system-key", info.system_key);
-    JSON_STRING_GET_TO_ARRAY(j, "device-key", info.device_key);
-    JSON_STRING_GET_TO_ARRAY(j, "system", info.system);
-    JSON_STRING_GET_TO_ARRAY(j, "system-instance", info.system_instance);
-    JSON_STRING_GET_TO_ARRAY(j, "acc-hw", info.acc_hw);
-    j.at("device-type").get_to(info.device_type);
-    JSON_STRING_GET_TO_ARRAY(j, "device", info.device);
-    j.at("device-id").get_to(info.device_id);
-    JSON_STRING_GET_TO_ARRAY(j, "core", info.core);
-    j.at("core-type").get_to(info.core_type);
-    j.at("core-id").get_to(info.core_id);
+/*
+ * The decoders return the number of bytes stored. They stop at the first
+ * invalid character or when dst is full.
+ */
+static size_t hex_decode(const char *src, size_t len, uint8_t *dst,
+                         size_t capacity)
+{
+    size_t n{std::min(len / 2, capacity)};
+    for (size_t i{0}; i < n; i++) {
+        uint8_t hi{DIGIT_VALUES.hex[(uint8_t)src[2 * i]]};
+        uint8_t lo{DIGIT_VALUES.hex[(uint8_t)src[2 * i + 1]]};
+        if ((hi | lo) & 0xf0) {
+            return i;
+        }
+        dst[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return n;
 }
 
-static void from_json(const nlohmann::json &j, mcd_error_info_st &info)
+static size_t base64_decode(const char *src, size_t len, uint8_t *dst,
+                            size_t capacity)
 {
-    j.at("return-status").get_to(info.return_status);
-    j.at("error-code").get_to(info.error_code);
-    j.at("error-events").get_to(info.error_events);
-    JSON_STRING_GET_TO_ARRAY(j, "error-str", info.error_str);
+    const uint8_t *values{DIGIT_VALUES.base64};
+    size_t i{0}, n{0};
+
+    /* whole groups of four characters */
+    for (; i + 4 <= len && n + 3 <= capacity; i += 4, n += 3) {
+        uint8_t a{values[(uint8_t)src[i]]};
+        uint8_t b{values[(uint8_t)src[i + 1]]};
+        uint8_t c{values[(uint8_t)src[i + 2]]};
+        uint8_t d{values[(uint8_t)src[i + 3]]};
+        if ((a | b | c | d) & 0xc0) {
+            break;
+        }
+        uint32_t bits{(uint32_t)a << 18 | (uint32_t)b << 12 |
+                      (uint32_t)c << 6 | d};
+        dst[n] = (uint8_t)(bits >> 16);
+        dst[n + 1] = (uint8_t)(bits >> 8);
+        dst[n + 2] = (uint8_t)bits;
+    }
+
+    /* the padded group at the end or a group which does not fit */
+    uint32_t bits{0};
+    int num_bits{0};
+    for (; i < len && n < capacity; i++) {
+        uint8_t v{values[(uint8_t)src[i]]};
+        if (v & 0xc0) {
+            break;
+        }
+        bits = (bits << 6 | v) & 0xffffff;
+        num_bits += 6;
+        if (num_bits >= 8) {
+            num_bits -= 8;
+            dst[n++] = (uint8_t)(bits >> num_bits);
+        }
+    }
+    return n;
+}
+
+/* the value of the last key=value token of a config string */
+static std::string_view config_value(const mcd_char_t *config_string,
+                                     std::string_view key)
+{
+    std::string_view value;
+    std::string_view config{config_string ? config_string : ""};
+    size_t begin{config.find_first_not_of(" \t\r\n")};
+    while (begin != std::string_view::npos) {
+        size_t end{config.find_first_of(" \t\r\n", begin)};
+        std::string_view token{config.substr(begin, end - begin)};
+        if (token.size() > key.size() && token.starts_with(key) &&
+            token[key.size()] == '=') {
+            value = token.substr(key.size() + 1);
+        }
+        begin = config.find_first_not_of(" \t\r\n", end);
+    }
+    return value;
 }
 
-static void from_json(const nlohmann::json &j, mcd_memspace_st &ms)
+/* the data encoding a config string asks for */
+static DataEncoding config_data_encoding(const mcd_char_t *config_string)
 {
-    j.at("mem-space-id").get_to(ms.mem_space_id);
-    JSON_STRING_GET_TO_ARRAY(j, "mem-space-name", ms.mem_space_name);
-    j.at("mem-type").get_to(ms.mem_type);
-    j.at("bits-per-mau").get_to(ms.bits_per_mau);
-    j.at("invariance").get_to(ms.invariance);
-    j.at("endian").get_to(ms.endian);
-    j.at("min-addr").get_to(ms.min_addr);
-    j.at("max-addr").get_to(ms.max_addr);
-    j.at("num-mem-blocks").get_to(ms.num_mem_blocks);
-    j.at("supported-access-options").get_to(ms.supported_access_options);
-    j.at("core-mode-mask-read").get_to(ms.core_mode_mask_read);
-    j.at("core-mode-mask-write").get_to(ms.core_mode_mask_write);
+    std::string_view value{config_value(config_string, "data")};
+    if (value == "hex") {
+        return DataEncoding::HEX;
+    } else if (value == "base64") {
+        return DataEncoding::BASE64;
+    }
+    return DataEncoding::ARRAY;
 }
 
-static void from_json(const nlohmann::json &j, mcd_register_group_st &rg)
+/*
+ * Wire format
+ *
+ * Messages are JSON lines by default. With format=cbor or format=msgpack in the
+ * config string of mcd_open_server_f, the client offers a binary encoding of
+ * the same messages which is used once the server echoes the key. The
+ * mcd-open-server exchange itself is always JSON. Binary messages are framed
+ * (see QMP_FRAME_HEADER_SIZE) and carry memory data as byte strings, whatever
+ * the data encoding.
+ */
+enum class WireFormat { JSON, CBOR, MSGPACK };
+
+static WireFormat wire_format{WireFormat::JSON};
+static WireFormat wire_format_requested{WireFormat::JSON};
+
+/* the wire format a config string asks for */
+static WireFormat config_wire_format(const mcd_char_t *config_string)
 {
-    j.at("reg-group-id").get_to(rg.reg_group_id);
-    JSON_STRING_GET_TO_ARRAY(j, "reg-group-name", rg.reg_group_name);
-    j.at("n-registers").get_to(rg.n_registers);
+    std::string_view value{config_value(config_string, "format")};
+    if (value == "cbor") {
+        return WireFormat::CBOR;
+    } else if (value == "msgpack") {
+        return WireFormat::MSGPACK;
+    }
+    return WireFormat::JSON;
 }
 
-static void to_json(nlohmann::json &j, const mcd_addr_st &a)
+/*
+ * Responses are parsed with the SAX interface of nlohmann::json instead of
+ * building a DOM. Every JSON value is routed to a sink which stores it directly
+ * in the result struct, unknown keys and values of the wrong type are skipped.
+ * Only the value of "return" is written, so other lines (e.g. events) leave the
+ * result untouched. A line which lacks a required member of an object is
+ * rejected.
+ */
+using Required = std::span<const std::string_view>;
+
+struct Sink {
+    enum class Kind {
+        SKIP,
+        FAIL,
+        NUMBER,
+        STRING,
+        NEW_STRING,
+        OBJECT,
+        ARRAY,
+        BYTES,
+    };
+    Kind kind{Kind::SKIP};
+    void *dst{nullptr};
+    /* width of a number, capacity of a string or bytes, stride of an array */
+    size_t size{0};
+    /* sink of a member of an object */
+    Sink (*member)(void *dst, std::string_view key){nullptr};
+    /* sink of an array element at dst */
+    Sink (*element)(void *dst){nullptr};
+    /* called after the last member of an object */
+    void (*end)(void *dst, bool matched){nullptr};
+    /* keys an object must contain, at most 32 */
+    Required required{};
+};
+
+static Sink skip() { return {.kind{Sink::Kind::SKIP}}; }
+
+/* aborts the line */
+static Sink fail() { return {.kind{Sink::Kind::FAIL}}; }
+
+template <typename T>
+static Sink number(T &field)
 {
-    j = nlohmann::json{{"address", a.address},
-                       {"mem-space-id", a.mem_space_id},
-                       {"addr-space-id", a.addr_space_id},
-                       {"addr-space-type", a.addr_space_type}};
+    static_assert(std::is_integral_v<T>, "numbers are stored in integers");
+    return {.kind{Sink::Kind::NUMBER}, .dst{&field}, .size{sizeof(T)}};
 }
 
-static void from_json(const nlohmann::json &j, mcd_addr_st &a)
+template <size_t N>
+static Sink string(mcd_char_t (&field)[N])
 {
-    j.at("address").get_to(a.address);
-    j.at("mem-space-id").get_to(a.mem_space_id);
-    j.at("addr-space-id").get_to(a.addr_space_id);
-    j.at("addr-space-type").get_to(a.addr_space_type);
+    return {.kind{Sink::Kind::STRING}, .dst{field}, .size{N}};
 }
 
-static void from_json(const nlohmann::json &j, mcd_register_info_st &r)
+/* allocates a null-terminated copy with new[] */
+static Sink new_string(const mcd_char_t *&field)
 {
-    j.at("addr").get_to(r.addr);
-    j.at("reg-group-id").get_to(r.reg_group_id);
-    JSON_STRING_GET_TO_ARRAY(j, "regname", r.regname);
-    j.at("regsize").get_to(r.regsize);
-    j.at("core-mode-mask-read").get_to(r.core_mode_mask_read);
-    j.at("core-mode-mask-write").get_to(r.core_mode_mask_write);
-    j.at("side-effects-read").get_to(r.has_side_effects_read);
-    j.at("side-effects-write").get_to(r.has_side_effects_write);
-    j.at("reg-type").get_to(r.reg_type);
-    j.at("hw-thread-id").get_to(r.hw_thread_id);
+    return {.kind{Sink::Kind::NEW_STRING}, .dst{&field}};
 }
 
-void to_json(nlohmann::json &j, const mcd_tx_st &tx)
+/* memory data, either as array of numbers or encoded as string */
+static Sink bytes(uint8_t *data, uint32_t capacity)
 {
-    std::vector<uint8_t> data{tx.data, tx.data + tx.num_bytes};
-    j = nlohmann::json{
-        {"addr", tx.addr},           {"access-type", tx.access_type},
-        {"options", tx.options},     {"access-width", tx.access_width},
-        {"core-mode", tx.core_mode}, {"data", data},
-        {"num-bytes", tx.num_bytes}, {"num-bytes-ok", tx.num_bytes_ok}};
+    return {.kind{Sink::Kind::BYTES}, .dst{data}, .size{capacity}};
 }
 
-void from_json(const nlohmann::json &j, mcd_tx_st &tx)
+template <typename T>
+static void end_object(T &, bool)
 {
-    j.at("addr").get_to(tx.addr);
-    j.at("access-type").get_to(tx.access_type);
-    j.at("options").get_to(tx.options);
-    j.at("access-width").get_to(tx.access_width);
-    j.at("core-mode").get_to(tx.core_mode);
-    j.at("num-bytes").get_to(tx.num_bytes);
-    j.at("num-bytes-ok").get_to(tx.num_bytes_ok);
-    const nlohmann::json &arr = j.at("data");
-    std::copy(arr.begin(), arr.end(), tx.data);
 }
 
-void to_json(nlohmann::json &j, const mcd_txlist_st &l)
+/* the results only require the return status */
+template <typename T>
+static Required required_members(const T &)
 {
-    std::vector<mcd_tx_st> tx{l.tx, l.tx + l.num_tx};
-    j = nlohmann::json{
-        {"tx", tx}, {"num-tx", l.num_tx}, {"num-tx-ok", l.num_tx_ok}};
+    static constexpr std::string_view keys[]{"return-status"};
+    return keys;
 }
 
-void from_json(const nlohmann::json &j, mcd_txlist_st &l)
+template <typename T>
+static Sink object(T &obj)
+{
+    return {
+        .kind{Sink::Kind::OBJECT},
+        .dst{&obj},
+        .size{sizeof(T)},
+        .member{[](void *dst, std::string_view key) {
+            return member_sink(*(T *)dst, key);
+        }},
+        .end{[](void *dst, bool matched) { end_object(*(T *)dst, matched); }},
+        .required{required_members(obj)},
+    };
+}
+
+template <typename T>
+static Sink element_sink(T &element)
 {
-    j.at("num-tx").get_to(l.num_tx);
-    j.at("num-tx-ok").get_to(l.num_tx_ok);
-    const nlohmann::json &arr = j.at("tx");
-    mcd_tx_st *tx = l.tx;
-    for (const auto &j_arr : arr) {
-        j_arr.get_to(*tx);
-        tx++;
+    if constexpr (std::is_integral_v<T>) {
+        return number(element);
+    } else {
+        return object(element);
     }
-    // std::copy(arr.begin(), arr.end(), l.tx);
 }
 
-void from_json(const nlohmann::json &j, mcd_trig_info_st &i)
+template <typename T>
+static Sink array(T *first)
 {
-    j.at("type").get_to(i.type);
-    j.at("option").get_to(i.option);
-    j.at("action").get_to(i.action);
-    j.at("trig-number").get_to(i.trig_number);
-    j.at("state-number").get_to(i.state_number);
-    j.at("counter-number").get_to(i.counter_number);
-    j.at("sw-breakpoints").get_to(i.sw_breakpoints);
+    return {
+        .kind{Sink::Kind::ARRAY},
+        .dst{first},
+        .size{sizeof(T)},
+        .element{[](void *dst) { return element_sink(*(T *)dst); }},
+    };
 }
 
-static void to_json(nlohmann::json &j, const mcd_trig_simple_core_st &t)
+static Sink member_sink(mcd_core_con_info_st &info, std::string_view key)
 {
-    j = nlohmann::json{{"type", t.type},
-                       {"option", t.option},
-                       {"action", t.action},
-                       {"action-param", t.action_param},
-                       {"modified", !!t.modified},
-                       {"state-mask", t.state_mask},
-                       {"addr-start", t.addr_start},
-                       {"addr-range", t.addr_range}};
+    if (key == "host") return string(info.host);
+    if (key == "server-port") return number(info.server_port);
+    if (key == "server-key") return string(info.server_key);
+    if (key == "system-key") return string(info.system_key);
+    if (key == "device-key") return string(info.device_key);
+    if (key == "system") return string(info.system);
+    if (key == "system-instance") return string(info.system_instance);
+    if (key == "acc-hw") return string(info.acc_hw);
+    if (key == "device-type") return number(info.device_type);
+    if (key == "device") return string(info.device);
+    if (key == "device-id") return number(info.device_id);
+    if (key == "core") return string(info.core);
+    if (key == "core-type") return number(info.core_type);
+    if (key == "core-id") return number(info.core_id);
+    return skip();
 }
 
-void from_json(const nlohmann::json &j, mcd_trig_simple_core_st &t)
-{
-    t.struct_size = sizeof(mcd_trig_simple_core_st);
-    j.at("type").get_to(t.type);
-    j.at("option").get_to(t.option);
-    j.at("action").get_to(t.action);
-    j.at("action-param").get_to(t.action_param);
-    j.at("modified").get_to((bool &)t.modified);
-    j.at("state-mask").get_to(t.state_mask);
-    j.at("addr-start").get_to(t.addr_start);
-    j.at("addr-range").get_to(t.addr_range);
-}
-
-static void to_json(nlohmann::json &j, const mcd_trig_complex_core_st &t)
-{
-    j = nlohmann::json{{"type", t.type},
-                       {"option", t.option},
-                       {"action", t.action},
-                       {"action-param", t.action_param},
-                       {"modified", !!t.modified},
-                       {"state-mask", t.state_mask},
-                       {"addr-start", t.addr_start},
-                       {"addr-range", t.addr_range},
-                       {"data-start", t.data_start},
-                       {"data-range", t.data_range},
-                       {"data-mask", t.data_mask},
-                       {"data-size", t.data_size},
-                       {"hw-thread-id", t.hw_thread_id},
-                       {"sw-thread-id", t.sw_thread_id},
-                       {"core-mode-mask", t.core_mode_mask}};
-}
-
-void from_json(const nlohmann::json &j, mcd_trig_complex_core_st &t)
+static Required required_members(const mcd_core_con_info_st &)
 {
-    t.struct_size = sizeof(mcd_trig_complex_core_st);
-    j.at("type").get_to(t.type);
-    j.at("option").get_to(t.option);
-    j.at("action").get_to(t.action);
-    j.at("action-param").get_to(t.action_param);
-    j.at("modified").get_to(t.modified);
-    j.at("state-mask").get_to(t.state_mask);
-    j.at("addr-start").get_to(t.addr_start);
-    j.at("addr-range").get_to(t.addr_range);
-    j.at("data-start").get_to(t.data_start);
-    j.at("data-range").get_to(t.data_range);
-    j.at("data-mask").get_to(t.data_mask);
-    j.at("data-size").get_to(t.data_size);
-    j.at("hw-thread-id").get_to(t.hw_thread_id);
-    j.at("sw-thread-id").get_to(t.sw_thread_id);
-    j.at("core-mode-mask").get_to(t.core_mode_mask);
+    static constexpr std::string_view keys[]{
+        "host", "server-port", "server-key", "system-key", "device-key",
+        "system", "system-instance", "acc-hw", "device-type", "device",
+        "device-id", "core", "core-type", "core-id",
+    };
+    return keys;
 }
 
-static void to_json(nlohmann::json &j, const mcd_rpc_trig_st &t)
+static Sink member_sink(mcd_error_info_st &info, std::string_view key)
 {
-    if (t.is_simple_core) {
-        j = nlohmann::json{{"trig-simple-core", *t.simple_core}};
-    } else if (t.is_complex_core) {
-        j = nlohmann::json{{"trig-complex-core", *t.complex_core}};
-    }
+    if (key == "return-status") return number(info.return_status);
+    if (key == "error-code") return number(info.error_code);
+    if (key == "error-events") return number(info.error_events);
+    if (key == "error-str") return string(info.error_str);
+    return skip();
 }
 
-static void from_json(const nlohmann::json &j, mcd_rpc_trig_st &t)
+static Required required_members(const mcd_error_info_st &)
 {
-    if (j.contains("trig-simple-core")) {
-        if (!t.is_simple_core) {
-            throw std::runtime_error(
-                "trigger container not big enough for trig_simple_core");
-        }
-        j.at("trig-simple-core").get_to(*t.simple_core);
-        t.is_complex_core = false;
-    } else if (j.contains("trig-complex-core")) {
-        if (!t.is_complex_core) {
-            throw std::runtime_error(
-                "trigger container not big enough for trig_complex_core");
-        }
-        j.at("trig-complex-core").get_to(*t.complex_core);
-        t.is_simple_core = false;
-    } else {
-        t.is_simple_core = false;
-        t.is_complex_core = false;
+    static constexpr std::string_view keys[]{
+        "return-status", "error-code", "error-events", "error-str",
+    };
+    return keys;
+}
+
+static Sink member_sink(mcd_memspace_st &ms, std::string_view key)
+{
+    if (key == "mem-space-id") return number(ms.mem_space_id);
+    if (key == "mem-space-name") return string(ms.mem_space_name);
+    if (key == "mem-type") return number(ms.mem_type);
+    if (key == "bits-per-mau") return number(ms.bits_per_mau);
+    if (key == "invariance") return number(ms.invariance);
+    if (key == "endian") return number(ms.endian);
+    if (key == "min-addr") return number(ms.min_addr);
+    if (key == "max-addr") return number(ms.max_addr);
+    if (key == "num-mem-blocks") return number(ms.num_mem_blocks);
+    if (key == "supported-access-options") {
+        return number(ms.supported_access_options);
     }
+    if (key == "core-mode-mask-read") return number(ms.core_mode_mask_read);
+    if (key == "core-mode-mask-write") return number(ms.core_mode_mask_write);
+    return skip();
 }
 
-void from_json(const nlohmann::json &j, mcd_trig_state_st &s)
+static Required required_members(const mcd_memspace_st &)
 {
-    j.at("active").get_to(s.active);
-    j.at("captured").get_to(s.captured);
-    j.at("captured-valid").get_to(s.captured_valid);
-    j.at("count-value").get_to(s.count_value);
-    j.at("count-valid").get_to(s.count_valid);
+    static constexpr std::string_view keys[]{
+        "mem-space-id", "mem-space-name", "mem-type", "bits-per-mau",
+        "invariance", "endian", "min-addr", "max-addr", "num-mem-blocks",
+        "supported-access-options", "core-mode-mask-read",
+        "core-mode-mask-write",
+    };
+    return keys;
 }
 
-void from_json(const nlohmann::json &j, mcd_trig_set_state_st &s)
+static Sink member_sink(mcd_register_group_st &rg, std::string_view key)
 {
-    j.at("active").get_to(s.active);
-    j.at("state").get_to(s.state);
-    j.at("state-valid").get_to(s.state_valid);
-    j.at("trig-bus").get_to(s.trig_bus);
-    j.at("trig-bus-valid").get_to(s.trig_bus_valid);
-    j.at("trace").get_to(s.trace);
-    j.at("trace-valid").get_to(s.trace_valid);
-    j.at("analysis").get_to(s.analysis);
-    j.at("analysis-valid").get_to(s.analysis_valid);
+    if (key == "reg-group-id") return number(rg.reg_group_id);
+    if (key == "reg-group-name") return string(rg.reg_group_name);
+    if (key == "n-registers") return number(rg.n_registers);
+    return skip();
 }
 
-void from_json(const nlohmann::json &j, mcd_core_state_st &s)
+static Required required_members(const mcd_register_group_st &)
 {
-    j.at("state").get_to(s.state);
-    j.at("event").get_to(s.event);
-    j.at("hw-thread-id").get_to(s.hw_thread_id);
-    j.at("trig-id").get_to(s.trig_id);
-    JSON_STRING_GET_TO_ARRAY(j, "stop-str", s.stop_str);
-    JSON_STRING_GET_TO_ARRAY(j, "info-str", s.info_str);
+    static constexpr std::string_view keys[]{
+        "reg-group-id", "reg-group-name", "n-registers",
+    };
+    return keys;
 }
 
-void from_json(const nlohmann::json &j, mcd_rst_info_st &i)
+static Sink member_sink(mcd_addr_st &a, std::string_view key)
 {
-    j.at("class-vector").get_to(i.class_vector);
-    JSON_STRING_GET_TO_ARRAY(j, "info-str", i.info_str);
+    if (key == "address") return number(a.address);
+    if (key == "mem-space-id") return number(a.mem_space_id);
+    if (key == "addr-space-id") return number(a.addr_space_id);
+    if (key == "addr-space-type") return number(a.addr_space_type);
+    return skip();
 }
 
-void from_json(const nlohmann::json &j, mcd_ctrig_info_st &i)
+static Required required_members(const mcd_addr_st &)
 {
-    j.at("ctrig-id").get_to(i.ctrig_id);
-    JSON_STRING_GET_TO_ARRAY(j, "info-str", i.info_str);
+    static constexpr std::string_view keys[]{
+        "address", "mem-space-id", "addr-space-id", "addr-space-type",
+    };
+    return keys;
 }
 
-static void to_json(nlohmann::json &j, const mcd_open_server_args &args)
+static Sink member_sink(mcd_register_info_st &r, std::string_view key)
 {
-    j = nlohmann::json{{"system-key", args.system_key},
-                       {"config-string", args.config_string}};
+    if (key == "addr") return object(r.addr);
+    if (key == "reg-group-id") return number(r.reg_group_id);
+    if (key == "regname") return string(r.regname);
+    if (key == "regsize") return number(r.regsize);
+    if (key == "core-mode-mask-read") return number(r.core_mode_mask_read);
+    if (key == "core-mode-mask-write") return number(r.core_mode_mask_write);
+    if (key == "side-effects-read") return number(r.has_side_effects_read);
+    if (key == "side-effects-write") return number(r.has_side_effects_write);
+    if (key == "reg-type") return number(r.reg_type);
+    if (key == "hw-thread-id") return number(r.hw_thread_id);
+    return skip();
 }
 
-static void from_json(const nlohmann::json &j, mcd_open_server_result &res)
+static Required required_members(const mcd_register_info_st &)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "server-uid", res.server.server_uid);
-
-    if (j.contains("config-string")) {
-        const std::string &s{
-            j.at("config-string").get_ref<const std::string &>()};
-        mcd_char_t *config_string{new mcd_char_t[s.size() + 1]};
-        s.copy(config_string, s.size());
-        config_string[s.size()] = '\0';
-        res.server.config_string = config_string;
-    } else {
-        res.server.config_string = nullptr;
-    }
+    static constexpr std::string_view keys[]{
+        "addr", "reg-group-id", "regname", "regsize", "core-mode-mask-read",
+        "core-mode-mask-write", "side-effects-read", "side-effects-write",
+        "reg-type", "hw-thread-id",
+    };
+    return keys;
+}
 
-    if (j.contains("host")) {
-        const std::string &s{j.at("host").get_ref<const std::string &>()};
-        mcd_char_t *host{new mcd_char_t[s.size() + 1]};
-        s.copy(host, s.size());
-        host[s.size()] = '\0';
-        res.server.host = host;
-    } else {
-        res.server.host = nullptr;
-    }
+static Sink member_sink(mcd_tx_st &tx, std::string_view key)
+{
+    if (key == "addr") return object(tx.addr);
+    if (key == "access-type") return number(tx.access_type);
+    if (key == "options") return number(tx.options);
+    if (key == "access-width") return number(tx.access_width);
+    if (key == "core-mode") return number(tx.core_mode);
+    if (key == "num-bytes") return number(tx.num_bytes);
+    if (key == "num-bytes-ok") return number(tx.num_bytes_ok);
+    if (key == "data") return bytes(tx.data, tx.num_bytes);
+    return skip();
 }
 
-static void to_json(nlohmann::json &j, const mcd_close_server_args &args)
+static Required required_members(const mcd_tx_st &)
 {
-    j = nlohmann::json{
-        {"server-uid", args.server_uid},
+    static constexpr std::string_view keys[]{
+        "addr", "access-type", "options", "access-width", "core-mode",
+        "num-bytes", "num-bytes-ok", "data",
     };
+    return keys;
 }
 
-static void from_json(const nlohmann::json &j, mcd_close_server_result &res)
+static Sink member_sink(mcd_txlist_st &l, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
+    if (key == "num-tx") return number(l.num_tx);
+    if (key == "num-tx-ok") return number(l.num_tx_ok);
+    if (key == "tx") return array(l.tx);
+    return skip();
 }
 
-static void to_json(nlohmann::json &j, const mcd_qry_systems_args &args)
+static Required required_members(const mcd_txlist_st &)
 {
-    j = nlohmann::json{
-        {"start-index", args.start_index},
-        {"num-systems", args.num_systems},
+    static constexpr std::string_view keys[]{
+        "num-tx", "num-tx-ok", "tx",
     };
+    return keys;
 }
 
-static void from_json(const nlohmann::json &j, mcd_qry_systems_result &res)
+static Sink member_sink(mcd_trig_info_st &i, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "num-systems", *res.num_systems);
-    if (j.contains("system-con-info")) {
-        const nlohmann::json &arr = j.at("system-con-info");
-        std::copy(arr.begin(), arr.end(), res.system_con_info);
-    }
+    if (key == "type") return number(i.type);
+    if (key == "option") return number(i.option);
+    if (key == "action") return number(i.action);
+    if (key == "trig-number") return number(i.trig_number);
+    if (key == "state-number") return number(i.state_number);
+    if (key == "counter-number") return number(i.counter_number);
+    if (key == "sw-breakpoints") return number(i.sw_breakpoints);
+    return skip();
 }
 
-static void to_json(nlohmann::json &j, const mcd_qry_devices_args &args)
+static Required required_members(const mcd_trig_info_st &)
 {
-    j = nlohmann::json{
-        {"system-con-info", *args.system_con_info},
-        {"start-index", args.start_index},
-        {"num-devices", args.num_devices},
+    static constexpr std::string_view keys[]{
+        "type", "option", "action", "trig-number", "state-number",
+        "counter-number", "sw-breakpoints",
     };
+    return keys;
 }
 
-static void from_json(const nlohmann::json &j, mcd_qry_devices_result &res)
+static Sink member_sink(mcd_trig_simple_core_st &t, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "num-devices", *res.num_devices);
-    if (j.contains("device-con-info")) {
-        const nlohmann::json &sj = j.at("device-con-info");
-        std::copy(sj.begin(), sj.end(), res.device_con_info);
-    }
+    t.struct_size = sizeof(mcd_trig_simple_core_st);
+    if (key == "type") return number(t.type);
+    if (key == "option") return number(t.option);
+    if (key == "action") return number(t.action);
+    if (key == "action-param") return number(t.action_param);
+    if (key == "modified") return number(t.modified);
+    if (key == "state-mask") return number(t.state_mask);
+    if (key == "addr-start") return object(t.addr_start);
+    if (key == "addr-range") return number(t.addr_range);
+    return skip();
+}
+
+static Required required_members(const mcd_trig_simple_core_st &)
+{
+    static constexpr std::string_view keys[]{
+        "type", "option", "action", "action-param", "modified", "state-mask",
+        "addr-start", "addr-range",
+    };
+    return keys;
 }
 
-static void to_json(nlohmann::json &j, const mcd_qry_cores_args &args)
+static Sink member_sink(mcd_trig_complex_core_st &t, std::string_view key)
 {
-    j = nlohmann::json{
-        {"connection-info", *args.connection_info},
-        {"start-index", args.start_index},
-        {"num-cores", args.num_cores},
+    t.struct_size = sizeof(mcd_trig_complex_core_st);
+    if (key == "type") return number(t.type);
+    if (key == "option") return number(t.option);
+    if (key == "action") return number(t.action);
+    if (key == "action-param") return number(t.action_param);
+    if (key == "modified") return number(t.modified);
+    if (key == "state-mask") return number(t.state_mask);
+    if (key == "addr-start") return object(t.addr_start);
+    if (key == "addr-range") return number(t.addr_range);
+    if (key == "data-start") return number(t.data_start);
+    if (key == "data-range") return number(t.data_range);
+    if (key == "data-mask") return number(t.data_mask);
+    if (key == "data-size") return number(t.data_size);
+    if (key == "hw-thread-id") return number(t.hw_thread_id);
+    if (key == "sw-thread-id") return number(t.sw_thread_id);
+    if (key == "core-mode-mask") return number(t.core_mode_mask);
+    return skip();
+}
+
+static Required required_members(const mcd_trig_complex_core_st &)
+{
+    static constexpr std::string_view keys[]{
+        "type", "option", "action", "action-param", "modified", "state-mask",
+        "addr-start", "addr-range", "data-start", "data-range", "data-mask",
+        "data-size", "hw-thread-id", "sw-thread-id", "core-mode-mask",
     };
+    return keys;
 }
 
-static void from_json(const nlohmann::json &j, mcd_qry_cores_result &res)
+/* the caller provides containers for the trigger types which fit */
+static Sink member_sink(mcd_rpc_trig_st &t, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "num-cores", *res.num_cores);
-    if (j.contains("core-con-info")) {
-        const nlohmann::json &sj = j.at("core-con-info");
-        std::copy(sj.begin(), sj.end(), res.core_con_info);
+    if (key == "trig-simple-core") {
+        if (!t.is_simple_core) {
+            return fail();
+        }
+        t.is_complex_core = false;
+        return object(*t.simple_core);
+    }
+    if (key == "trig-complex-core") {
+        if (!t.is_complex_core) {
+            return fail();
+        }
+        t.is_simple_core = false;
+        return object(*t.complex_core);
     }
+    return skip();
 }
 
-static void to_json(nlohmann::json &j, const mcd_open_core_args &args)
+/* either trigger type or none */
+static Required required_members(const mcd_rpc_trig_st &) { return {}; }
+
+static void end_object(mcd_rpc_trig_st &t, bool matched)
 {
-    j = nlohmann::json{
-        {"core-con-info", *args.core_con_info},
-    };
+    if (!matched) {
+        t.is_simple_core = false;
+        t.is_complex_core = false;
+    }
 }
 
-static void from_json(const nlohmann::json &j, mcd_open_core_result &res)
+static Sink member_sink(mcd_trig_state_st &s, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "core-uid", res.core.core_uid);
-    if (j.contains("core-con-info")) {
-        res.core.core_con_info = new mcd_core_con_info_st{};
-        j.at("core-con-info").get_to(*res.core.core_con_info);
-    }
+    if (key == "active") return number(s.active);
+    if (key == "captured") return number(s.captured);
+    if (key == "captured-valid") return number(s.captured_valid);
+    if (key == "count-value") return number(s.count_value);
+    if (key == "count-valid") return number(s.count_valid);
+    return skip();
 }
 
-static void to_json(nlohmann::json &j, const mcd_close_core_args &args)
+static Required required_members(const mcd_trig_state_st &)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
+    static constexpr std::string_view keys[]{
+        "active", "captured", "captured-valid", "count-value", "count-valid",
     };
+    return keys;
 }
 
-static void from_json(const nlohmann::json &j, mcd_close_core_result &res)
+static Sink member_sink(mcd_trig_set_state_st &s, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
+    if (key == "active") return number(s.active);
+    if (key == "state") return number(s.state);
+    if (key == "state-valid") return number(s.state_valid);
+    if (key == "trig-bus") return number(s.trig_bus);
+    if (key == "trig-bus-valid") return number(s.trig_bus_valid);
+    if (key == "trace") return number(s.trace);
+    if (key == "trace-valid") return number(s.trace_valid);
+    if (key == "analysis") return number(s.analysis);
+    if (key == "analysis-valid") return number(s.analysis_valid);
+    return skip();
 }
 
-static void to_json(nlohmann::json &j, const mcd_qry_error_info_args &args)
+static Required required_members(const mcd_trig_set_state_st &)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
+    static constexpr std::string_view keys[]{
+        "active", "state", "state-valid", "trig-bus", "trig-bus-valid", "trace",
+        "trace-valid", "analysis", "analysis-valid",
     };
+    return keys;
 }
 
-static void from_json(const nlohmann::json &j, mcd_qry_error_info_result &res)
+static Sink member_sink(mcd_core_state_st &s, std::string_view key)
 {
-    *res.error_info = j.template get<mcd_error_info_st>();
+    if (key == "state") return number(s.state);
+    if (key == "event") return number(s.event);
+    if (key == "hw-thread-id") return number(s.hw_thread_id);
+    if (key == "trig-id") return number(s.trig_id);
+    if (key == "stop-str") return string(s.stop_str);
+    if (key == "info-str") return string(s.info_str);
+    return skip();
 }
 
-static void to_json(nlohmann::json &j, const mcd_qry_mem_spaces_args &args)
+static Required required_members(const mcd_core_state_st &)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-        {"start-index", args.start_index},
-        {"num-mem-spaces", args.num_mem_spaces},
+    static constexpr std::string_view keys[]{
+        "state", "event", "hw-thread-id", "trig-id", "stop-str", "info-str",
     };
+    return keys;
 }
 
-static void from_json(const nlohmann::json &j, mcd_qry_mem_spaces_result &res)
+static Sink member_sink(mcd_rst_info_st &i, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "num-mem-spaces", *res.num_mem_spaces);
-    if (j.contains("mem-spaces")) {
-        const nlohmann::json &sj = j.at("mem-spaces");
-        std::copy(sj.begin(), sj.end(), res.mem_spaces);
-    }
+    if (key == "class-vector") return number(i.class_vector);
+    if (key == "info-str") return string(i.info_str);
+    return skip();
 }
 
-static void to_json(nlohmann::json &j, const mcd_qry_reg_groups_args &args)
+static Required required_members(const mcd_rst_info_st &)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-        {"start-index", args.start_index},
-        {"num-reg-groups", args.num_reg_groups},
+    static constexpr std::string_view keys[]{
+        "class-vector", "info-str",
     };
+    return keys;
 }
 
-static void from_json(const nlohmann::json &j, mcd_qry_reg_groups_result &res)
+static Sink member_sink(mcd_ctrig_info_st &i, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "num-reg-groups", *res.num_reg_groups);
-    if (j.contains("reg-groups")) {
-        const nlohmann::json &sj = j.at("reg-groups");
-        std::copy(sj.begin(), sj.end(), res.reg_groups);
-    }
+    if (key == "ctrig-id") return number(i.ctrig_id);
+    if (key == "info-str") return string(i.info_str);
+    return skip();
 }
 
-static void to_json(nlohmann::json &j, const mcd_qry_reg_map_args &args)
+static Required required_members(const mcd_ctrig_info_st &)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-        {"reg-group-id", args.reg_group_id},
-        {"start-index", args.start_index},
-        {"num-regs", args.num_regs},
+    static constexpr std::string_view keys[]{
+        "ctrig-id", "info-str",
     };
+    return keys;
 }
 
-static void from_json(const nlohmann::json &j, mcd_qry_reg_map_result &res)
+static Sink member_sink(mcd_open_server_result &res, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "num-regs", *res.num_regs);
-    if (j.contains("reg-info")) {
-        const nlohmann::json &sj = j.at("reg-info");
-        std::copy(sj.begin(), sj.end(), res.reg_info);
-    }
+    if (key == "return-status") return number(res.return_status);
+    if (key == "server-uid") return number(res.server.server_uid);
+    if (key == "config-string") return new_string(res.server.config_string);
+    if (key == "host") return new_string(res.server.host);
+    return skip();
 }
 
-static void to_json(nlohmann::json &j, const mcd_execute_txlist_args &args)
+/* the results which only consist of the return status */
+template <typename T>
+static Sink member_sink(T &res, std::string_view key)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-        {"txlist", *args.txlist},
-    };
+    if (key == "return-status") return number(res.return_status);
+    return skip();
 }
 
-static void from_json(const nlohmann::json &j, mcd_execute_txlist_result &res)
+static Sink member_sink(mcd_qry_systems_result &res, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "txlist", *res.txlist);
+    if (key == "num-systems") return number(*res.num_systems);
+    if (key == "system-con-info") return array(res.system_con_info);
+    return member_sink<>(res, key);
 }
 
-static void to_json(nlohmann::json &j, const mcd_qry_trig_info_args &args)
+static Sink member_sink(mcd_qry_devices_result &res, std::string_view key)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-    };
+    if (key == "num-devices") return number(*res.num_devices);
+    if (key == "device-con-info") return array(res.device_con_info);
+    return member_sink<>(res, key);
 }
 
-static void from_json(const nlohmann::json &j, mcd_qry_trig_info_result &res)
+static Sink member_sink(mcd_qry_cores_result &res, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "trig-info", *res.trig_info);
+    if (key == "num-cores") return number(*res.num_cores);
+    if (key == "core-con-info") return array(res.core_con_info);
+    return member_sink<>(res, key);
 }
 
-static void to_json(nlohmann::json &j, const mcd_qry_ctrigs_args &args)
+static Sink member_sink(mcd_open_core_result &res, std::string_view key)
 {
-    j = nlohmann::json{{"core-uid", args.core_uid},
-                       {"start-index", args.start_index},
-                       {"num-ctrigs", args.num_ctrigs}};
+    if (key == "core-uid") return number(res.core.core_uid);
+    if (key == "core-con-info") {
+        res.core.core_con_info = new mcd_core_con_info_st{};
+        return object(*res.core.core_con_info);
+    }
+    return member_sink<>(res, key);
 }
 
-static void from_json(const nlohmann::json &j, mcd_qry_ctrigs_result &res)
+static Sink member_sink(mcd_qry_mem_spaces_result &res, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "num-ctrigs", *res.num_ctrigs);
-    if (j.contains("ctrig-info")) {
-        const nlohmann::json &sj = j.at("ctrig-info");
-        std::copy(sj.begin(), sj.end(), res.ctrig_info);
-    }
+    if (key == "num-mem-spaces") return number(*res.num_mem_spaces);
+    if (key == "mem-spaces") return array(res.mem_spaces);
+    return member_sink<>(res, key);
 }
 
-static void to_json(nlohmann::json &j, const mcd_create_trig_args &args)
+static Sink member_sink(mcd_qry_reg_groups_result &res, std::string_view key)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-        {"trig", *args.trig},
-    };
+    if (key == "num-reg-groups") return number(*res.num_reg_groups);
+    if (key == "reg-groups") return array(res.reg_groups);
+    return member_sink<>(res, key);
 }
 
-static void from_json(const nlohmann::json &j, mcd_create_trig_result &res)
+static Sink member_sink(mcd_qry_reg_map_result &res, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "trig", *res.trig);
-    json_get_to_optional(j, "trig-id", *res.trig_id);
+    if (key == "num-regs") return number(*res.num_regs);
+    if (key == "reg-info") return array(res.reg_info);
+    return member_sink<>(res, key);
 }
 
-static void to_json(nlohmann::json &j, const mcd_qry_trig_args &args)
+static Sink member_sink(mcd_execute_txlist_result &res, std::string_view key)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-        {"trig-id", args.trig_id},
-    };
+    if (key == "txlist") return object(*res.txlist);
+    return member_sink<>(res, key);
 }
 
-static void from_json(const nlohmann::json &j, mcd_qry_trig_result &res)
+static Sink member_sink(mcd_qry_trig_info_result &res, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "trig", *res.trig);
+    if (key == "trig-info") return object(*res.trig_info);
+    return member_sink<>(res, key);
 }
 
-static void to_json(nlohmann::json &j, const mcd_remove_trig_args &args)
+static Sink member_sink(mcd_qry_ctrigs_result &res, std::string_view key)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-        {"trig-id", args.trig_id},
-    };
+    if (key == "num-ctrigs") return number(*res.num_ctrigs);
+    if (key == "ctrig-info") return array(res.ctrig_info);
+    return member_sink<>(res, key);
 }
 
-static void from_json(const nlohmann::json &j, mcd_remove_trig_result &res)
+static Sink member_sink(mcd_create_trig_result &res, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
+    if (key == "trig") return object(*res.trig);
+    if (key == "trig-id") return number(*res.trig_id);
+    return member_sink<>(res, key);
 }
 
-static void to_json(nlohmann::json &j, const mcd_qry_trig_state_args &args)
+static Sink member_sink(mcd_qry_trig_result &res, std::string_view key)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-        {"trig-id", args.trig_id},
-    };
+    if (key == "trig") return object(*res.trig);
+    return member_sink<>(res, key);
 }
 
-static void from_json(const nlohmann::json &j, mcd_qry_trig_state_result &res)
+static Sink member_sink(mcd_qry_trig_state_result &res, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "trig-state", *res.trig_state);
+    if (key == "trig-state") return object(*res.trig_state);
+    return member_sink<>(res, key);
 }
 
-static void to_json(nlohmann::json &j, const mcd_activate_trig_set_args &args)
+static Sink member_sink(mcd_qry_trig_set_result &res, std::string_view key)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-    };
+    if (key == "num-trigs") return number(*res.num_trigs);
+    if (key == "trig-ids") return array(res.trig_ids);
+    return member_sink<>(res, key);
 }
 
-static void from_json(const nlohmann::json &j,
-                      mcd_activate_trig_set_result &res)
+static Sink member_sink(mcd_qry_trig_set_state_result &res,
+                        std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
+    if (key == "trig-state") return object(*res.trig_state);
+    return member_sink<>(res, key);
 }
 
-static void to_json(nlohmann::json &j, const mcd_remove_trig_set_args &args)
+static Sink member_sink(mcd_qry_state_result &res, std::string_view key)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-    };
+    if (key == "state") return object(*res.state);
+    return member_sink<>(res, key);
 }
 
-static void from_json(const nlohmann::json &j, mcd_remove_trig_set_result &res)
+static Sink member_sink(mcd_qry_rst_classes_result &res, std::string_view key)
 {
-    j.at("return-status").get_to(res.return_status);
+    if (key == "rst-class-vector") return number(*res.rst_class_vector);
+    return member_sink<>(res, key);
 }
 
-static void to_json(nlohmann::json &j, const mcd_qry_trig_set_args &args)
+static Sink member_sink(mcd_qry_rst_class_info_result &res,
+                        std::string_view key)
 {
-    j = nlohmann::json{{"core-uid", args.core_uid},
-                       {"start-index", args.start_index},
-                       {"num-trigs", args.num_trigs}};
+    if (key == "rst-info") return object(*res.rst_info);
+    return member_sink<>(res, key);
 }
 
-static void from_json(const nlohmann::json &j, mcd_qry_trig_set_result &res)
+template <typename T>
+static Sink response_sink(T &res)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "num-trigs", *res.num_trigs);
-    if (j.contains("trig-ids")) {
-        const nlohmann::json &sj = j.at("trig-ids");
-        std::copy(sj.begin(), sj.end(), res.trig_ids);
-    }
+    return object(res);
 }
 
-static void to_json(nlohmann::json &j, const mcd_qry_trig_set_state_args &args)
+/* the error info is returned as a whole */
+static Sink response_sink(mcd_qry_error_info_result &res)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-    };
+    return object(*res.error_info);
 }
 
-static void from_json(const nlohmann::json &j,
-                      mcd_qry_trig_set_state_result &res)
-{
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "trig-state", *res.trig_state);
+class ResponseParser {
+public:
+    explicit ResponseParser(Sink response)
+        : response{response}, depth{0}, pending{skip()}, found{false}
+    {
+    }
+
+    bool has_return() const { return this->found; }
+
+    /* SAX interface */
+
+    bool null() { return this->next().kind != Sink::Kind::FAIL; }
+
+    bool boolean(bool val) { return this->store(val ? 1 : 0); }
+
+    bool number_integer(nlohmann::json::number_integer_t val)
+    {
+        return this->store((uint64_t)val);
+    }
+
+    bool number_unsigned(nlohmann::json::number_unsigned_t val)
+    {
+        return this->store(val);
+    }
+
+    bool number_float(nlohmann::json::number_float_t, const std::string &)
+    {
+        return this->next().kind != Sink::Kind::FAIL;
+    }
+
+    bool string(std::string &val)
+    {
+        Sink s{this->next()};
+        if (s.kind == Sink::Kind::STRING) {
+            size_t len{std::min(val.size(), s.size)};
+            memcpy(s.dst, val.data(), len);
+            if (len < s.size) {
+                ((mcd_char_t *)s.dst)[len] = '\0';
+            }
+        } else if (s.kind == Sink::Kind::NEW_STRING) {
+            mcd_char_t *copy{new mcd_char_t[val.size() + 1]};
+            memcpy(copy, val.data(), val.size());
+            copy[val.size()] = '\0';
+            *(const mcd_char_t **)s.dst = copy;
+        } else if (s.kind == Sink::Kind::BYTES &&
+                   data_encoding == DataEncoding::HEX) {
+            hex_decode(val.data(), val.size(), (uint8_t *)s.dst, s.size);
+        } else if (s.kind == Sink::Kind::BYTES &&
+                   data_encoding == DataEncoding::BASE64) {
+            base64_decode(val.data(), val.size(), (uint8_t *)s.dst, s.size);
+        }
+        return s.kind != Sink::Kind::FAIL;
+    }
+
+    bool binary(nlohmann::json::binary_t &val)
+    {
+        Sink s{this->next()};
+        if (s.kind == Sink::Kind::BYTES) {
+            memcpy(s.dst, val.data(), std::min(val.size(), s.size));
+        }
+        return s.kind != Sink::Kind::FAIL;
+    }
+
+    bool start_object(std::size_t)
+    {
+        Sink s{this->next()};
+        return this->push(s.kind == Sink::Kind::OBJECT ? s : skip());
+    }
+
+    bool key(std::string &key)
+    {
+        Level &level{this->stack[this->depth - 1]};
+        if (this->depth == 1) {
+            /* the envelope of the response */
+            this->found |= key == "return";
+            this->pending = key == "return" ? this->response : skip();
+        } else if (level.sink.kind == Sink::Kind::OBJECT) {
+            this->pending = level.sink.member(level.sink.dst, key);
+            level.matched |= this->pending.kind != Sink::Kind::SKIP;
+            const Required &required{level.sink.required};
+            auto it{std::find(required.begin(), required.end(), key)};
+            if (it != required.end()) {
+                level.seen |= 1u << (it - required.begin());
+            }
+        } else {
+            this->pending = skip();
+        }
+        return this->pending.kind != Sink::Kind::FAIL;
+    }
+
+    bool end_object()
+    {
+        Level &level{this->stack[--this->depth]};
+        if (level.sink.kind != Sink::Kind::OBJECT) {
+            return true;
+        }
+        if (level.sink.end) {
+            level.sink.end(level.sink.dst, level.matched);
+        }
+        /* a missing member would leave its field uninitialized */
+        size_t num_required{level.sink.required.size()};
+        return level.seen == (uint32_t)((1ull << num_required) - 1);
+    }
+
+    bool start_array(std::size_t)
+    {
+        Sink s{this->next()};
+        bool is_array{s.kind == Sink::Kind::ARRAY ||
+                      s.kind == Sink::Kind::BYTES};
+        return this->push(is_array ? s : skip());
+    }
+
+    bool end_array()
+    {
+        this->depth--;
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string &,
+                     const nlohmann::detail::exception &)
+    {
+        return false;
+    }
+
+private:
+    static constexpr int MAX_DEPTH{16};
+
+    struct Level {
+        Sink sink;
+        /* array: index of the next element, object: a key had a sink */
+        uint32_t index;
+        bool matched;
+        /* object: bit i is set once the required key i was seen */
+        uint32_t seen;
+    };
+
+    /* sink of the next value in the current object or array */
+    Sink next()
+    {
+        if (this->depth == 0) {
+            /* the envelope is only parsed for "return" */
+            return {.kind{Sink::Kind::OBJECT}};
+        }
+        Level &level{this->stack[this->depth - 1]};
+        if (level.sink.kind == Sink::Kind::ARRAY) {
+            return level.sink.element((char *)level.sink.dst +
+                                      level.sink.size * level.index++);
+        } else if (level.sink.kind == Sink::Kind::BYTES) {
+            /* surplus elements are dropped */
+            uint32_t i{level.index++};
+            return i < level.sink.size ? number(((uint8_t *)level.sink.dst)[i])
+                                       : skip();
+        }
+        Sink s{this->pending};
+        this->pending = skip();
+        return s;
+    }
+
+    bool push(const Sink &sink)
+    {
+        if (this->depth == MAX_DEPTH) {
+            return false;
+        }
+        this->stack[this->depth++] = {
+            .sink{sink}, .index{0}, .matched{false}, .seen{0}};
+        return true;
+    }
+
+    bool store(uint64_t val)
+    {
+        Sink s{this->next()};
+        if (s.kind == Sink::Kind::NUMBER) {
+            switch (s.size) {
+            case 1: *(uint8_t *)s.dst = (uint8_t)val; break;
+            case 2: *(uint16_t *)s.dst = (uint16_t)val; break;
+            case 4: *(uint32_t *)s.dst = (uint32_t)val; break;
+            default: *(uint64_t *)s.dst = val; break;
+            }
+        }
+        return s.kind != Sink::Kind::FAIL;
+    }
+
+    const Sink response;
+    Level stack[MAX_DEPTH];
+    int depth;
+    Sink pending;
+    bool found;
+};
+
+/*
+ * Parses the lines in buf until one of them carries the response. A binary
+ * frame holds a single message.
+ */
+template <typename T>
+static mcd_return_et unmarshal_response(const char *buf, T *res)
+{
+    uint8_t marker{(uint8_t)buf[0]};
+    if (qmp_frame_marker(marker)) {
+        const char *payload{buf + QMP_FRAME_HEADER_SIZE};
+        uint32_t length{qmp_frame_get_u32(buf + 1)};
+        auto format{(marker & QMP_FRAME_FORMAT_MASK) == QMP_FRAME_CBOR
+                        ? nlohmann::json::input_format_t::cbor
+                        : nlohmann::json::input_format_t::msgpack};
+        ResponseParser parser{response_sink(*res)};
+        if (nlohmann::json::sax_parse(payload, payload + length, &parser,
+                                      format) &&
+            parser.has_return()) {
+            return MCD_RET_ACT_NONE;
+        }
+        return MCD_RET_ACT_HANDLE_ERROR;
+    }
+
+    const char *json_line = buf;
+    while (*json_line != '\0') {
+        /* find next occurence of '\n' or '\0'; */
+        size_t len{1};
+        while (json_line[len] != '\n' && json_line[len] != '\0') {
+            len++;
+        }
+        ResponseParser parser{response_sink(*res)};
+        if (nlohmann::json::sax_parse(json_line, json_line + len, &parser) &&
+            parser.has_return()) {
+            return MCD_RET_ACT_NONE;
+        }
+        json_line += len;
+    }
+    /* not found */
+    return MCD_RET_ACT_HANDLE_ERROR;
 }
 
-static void to_json(nlohmann::json &j, const mcd_run_args &args)
-{
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-        {"global", args.global},
+/* the characters beyond the end of the buffer are counted, not stored */
+class MessageBuffer {
+public:
+    size_t size() const { return this->len; }
+    bool overflowed() const { return this->buf && this->len > this->buf_size; }
+
+protected:
+    MessageBuffer(char *buf, size_t buf_size)
+        : buf{buf}, buf_size{buf_size}, len{0}
+    {
+    }
+
+    void raw(const char *s, size_t n)
+    {
+        if (this->buf && n > 0 && this->len + n <= this->buf_size) {
+            memcpy(this->buf + this->len, s, n);
+        }
+        this->len += n;
+    }
+
+    void raw(char c) { this->raw(&c, 1); }
+
+    template <size_t N>
+    void raw(const char (&s)[N])
+    {
+        this->raw(s, N - 1);
+    }
+
+    char *const buf;
+    const size_t buf_size;
+    size_t len;
+};
+
+/*
+ * Requests are printed directly into the message buffer, in the format
+ * nlohmann::json would dump them: compact, with the keys of every object in
+ * lexicographic order. Without a buffer the writer only counts the characters.
+ */
+class JsonWriter : public MessageBuffer {
+public:
+    JsonWriter(char *buf, size_t buf_size)
+        : MessageBuffer{buf, buf_size}, separate{false}
+    {
+    }
+
+    void begin_object(uint32_t)
+    {
+        this->separator();
+        this->raw('{');
+        this->separate = false;
+    }
+
+    template <size_t N>
+    void key(const char (&k)[N])
+    {
+        this->separator();
+        this->raw('"');
+        this->raw(k);
+        this->raw("\":");
+        this->separate = false;
+    }
+
+    void end_object()
+    {
+        this->raw('}');
+        this->separate = true;
+    }
+
+    void begin_array(uint32_t)
+    {
+        this->separator();
+        this->raw('[');
+        this->separate = false;
+    }
+
+    void end_array()
+    {
+        this->raw(']');
+        this->separate = true;
+    }
+
+    void null()
+    {
+        this->separator();
+        this->raw("null");
+        this->separate = true;
+    }
+
+    template <typename T>
+    void number(T value)
+    {
+        static_assert(std::is_integral_v<T> || std::is_enum_v<T>,
+                      "numbers are printed from integers");
+        char digits[24];
+        std::to_chars_result r;
+        if constexpr (std::is_enum_v<T>) {
+            r = std::to_chars(digits, digits + sizeof(digits),
+                              (std::underlying_type_t<T>)value);
+        } else {
+            r = std::to_chars(digits, digits + sizeof(digits), value);
+        }
+        this->separator();
+        this->raw(digits, (size_t)(r.ptr - digits));
+        this->separate = true;
+    }
+
+    void boolean(bool value)
+    {
+        this->separator();
+        if (value) {
+            this->raw("true");
+        } else {
+            this->raw("false");
+        }
+        this->separate = true;
+    }
+
+    template <typename T>
+    void array(const T *values, uint32_t n)
+    {
+        this->begin_array(n);
+        for (uint32_t i{0}; i < n; i++) {
+            this->number(values[i]);
+        }
+        this->end_array();
+    }
+
+    /* memory data in the negotiated encoding */
+    void bytes(const uint8_t *data, uint32_t n)
+    {
+        if (data_encoding == DataEncoding::ARRAY) {
+            this->array(data, n);
+            return;
+        }
+
+        /* encoded in chunks of a multiple of three bytes */
+        char chunk[512];
+        bool hex{data_encoding == DataEncoding::HEX};
+        uint32_t step{hex ? 256u : 384u};
+        this->separator();
+        this->raw('"');
+        for (uint32_t i{0}; i < n; i += step) {
+            uint32_t len{std::min(step, n - i)};
+            this->raw(chunk, hex ? hex_encode(data + i, len, chunk)
+                                 : base64_encode(data + i, len, chunk));
+        }
+        this->raw('"');
+        this->separate = true;
+    }
+
+    template <size_t N>
+    void string(const mcd_char_t (&s)[N])
+    {
+        this->string(s, strnlen(s, N));
+    }
+
+    void string(const mcd_char_t *s) { this->string(s, s ? strlen(s) : 0); }
+
+    void string(const mcd_char_t *s, size_t n)
+    {
+        static const char hex[]{"0123456789abcdef"};
+        this->separator();
+        this->raw('"');
+        size_t plain{0};
+        for (size_t i{0}; i < n; i++) {
+            unsigned char c{(unsigned char)s[i]};
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                continue;
+            }
+            this->raw(s + plain, i - plain);
+            plain = i + 1;
+            switch (c) {
+            case '"':
+                this->raw("\\\"");
+                break;
+            case '\\':
+                this->raw("\\\\");
+                break;
+            case '\b':
+                this->raw("\\b");
+                break;
+            case '\f':
+                this->raw("\\f");
+                break;
+            case '\n':
+                this->raw("\\n");
+                break;
+            case '\r':
+                this->raw("\\r");
+                break;
+            case '\t':
+                this->raw("\\t");
+                break;
+            default: {
+                char u[]{'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+                this->raw(u, sizeof(u));
+                break;
+            }
+            }
+        }
+        this->raw(s + plain, n - plain);
+        this->raw('"');
+        this->separate = true;
+    }
+
+private:
+    /* a value has been completed, the next one needs a comma */
+    bool separate;
+
+    void separator()
+    {
+        if (this->separate) {
+            this->raw(',');
+        }
+    }
+};
+
+/*
+ * Prints the same structure as CBOR (RFC 8949) or MessagePack into a binary
+ * frame. Integers take the shortest form, as nlohmann::json would encode them.
+ */
+class BinaryWriter : public MessageBuffer {
+public:
+    BinaryWriter(WireFormat format, char *buf, size_t buf_size)
+        : MessageBuffer{buf, buf_size}, cbor{format == WireFormat::CBOR}
+    {
+        /* the header is completed by finish */
+        char header[QMP_FRAME_HEADER_SIZE]{};
+        this->raw(header, sizeof(header));
+    }
+
+    void finish(bool has_id, uint32_t request_id)
+    {
+        if (!this->buf || this->overflowed()) {
+            return;
+        }
+        int marker{this->cbor ? QMP_FRAME_CBOR : QMP_FRAME_MSGPACK};
+        this->buf[0] = (char)(has_id ? marker | QMP_FRAME_HAS_ID : marker);
+        qmp_frame_put_u32(this->buf + 1,
+                          (uint32_t)this->len - QMP_FRAME_HEADER_SIZE);
+        qmp_frame_put_u32(this->buf + 5, has_id ? request_id : 0);
+    }
+
+    void begin_object(uint32_t n) { this->head(Major::MAP, n); }
+
+    template <size_t N>
+    void key(const char (&k)[N])
+    {
+        this->string(k, N - 1);
+    }
+
+    void end_object() {}
+
+    void begin_array(uint32_t n) { this->head(Major::ARRAY, n); }
+
+    void end_array() {}
+
+    void null() { this->raw(this->cbor ? '\xf6' : '\xc0'); }
+
+    template <typename T>
+    void number(T value)
+    {
+        static_assert(std::is_integral_v<T> || std::is_enum_v<T>,
+                      "numbers are printed from integers");
+        if constexpr (std::is_enum_v<T>) {
+            this->number((std::underlying_type_t<T>)value);
+        } else if constexpr (std::is_signed_v<T>) {
+            if (value < 0) {
+                this->head(Major::NEGATIVE, (uint64_t)(-1 - (int64_t)value));
+            } else {
+                this->head(Major::UNSIGNED, (uint64_t)value);
+            }
+        } else {
+            this->head(Major::UNSIGNED, value);
+        }
+    }
+
+    void boolean(bool value)
+    {
+        if (this->cbor) {
+            this->raw(value ? '\xf5' : '\xf4');
+        } else {
+            this->raw(value ? '\xc3' : '\xc2');
+        }
+    }
+
+    template <typename T>
+    void array(const T *values, uint32_t n)
+    {
+        this->head(Major::ARRAY, n);
+        for (uint32_t i{0}; i < n; i++) {
+            this->number(values[i]);
+        }
+    }
+
+    /* memory data is sent unencoded */
+    void bytes(const uint8_t *data, uint32_t n)
+    {
+        this->head(Major::BYTES, n);
+        this->raw((const char *)data, n);
+    }
+
+    template <size_t N>
+    void string(const mcd_char_t (&s)[N])
+    {
+        this->string(s, strnlen(s, N));
+    }
+
+    void string(const mcd_char_t *s) { this->string(s, s ? strlen(s) : 0); }
+
+    void string(const mcd_char_t *s, size_t n)
+    {
+        this->head(Major::STRING, n);
+        this->raw(s, n);
+    }
+
+private:
+    /* the major types of CBOR, in their order */
+    enum class Major { UNSIGNED, NEGATIVE, BYTES, STRING, ARRAY, MAP };
+
+    /* type bytes of MessagePack: fixed form below fix_limit, then sized */
+    struct MsgPackType {
+        uint8_t fix;
+        uint64_t fix_limit;
+        /* for 1, 2, 4 and 8 bytes, 0 if there is no such form */
+        uint8_t sized[4];
     };
+
+    static constexpr MsgPackType MSGPACK_TYPES[]{
+        {.fix{0x00}, .fix_limit{0x80}, .sized{0xcc, 0xcd, 0xce, 0xcf}},
+        {.fix{0xe0}, .fix_limit{0x20}, .sized{0xd0, 0xd1, 0xd2, 0xd3}},
+        {.fix{0x00}, .fix_limit{0x00}, .sized{0xc4, 0xc5, 0xc6, 0x00}},
+        {.fix{0xa0}, .fix_limit{0x20}, .sized{0xd9, 0xda, 0xdb, 0x00}},
+        {.fix{0x90}, .fix_limit{0x10}, .sized{0x00, 0xdc, 0xdd, 0x00}},
+        {.fix{0x80}, .fix_limit{0x10}, .sized{0x00, 0xde, 0xdf, 0x00}},
+    };
+
+    const bool cbor;
+
+    void big_endian(uint64_t value, int width)
+    {
+        char bytes[8];
+        for (int i{0}; i < width; i++) {
+            bytes[i] = (char)(value >> (8 * (width - 1 - i)));
+        }
+        this->raw(bytes, (size_t)width);
+    }
+
+    /*
+     * The type and the argument of a value: the integer itself, or the length
+     * of a string or container. A negative integer v is passed as -1 - v.
+     */
+    void head(Major major, uint64_t n)
+    {
+        if (this->cbor) {
+            uint8_t type{(uint8_t)((int)major << 5)};
+            if (n < 24) {
+                this->raw((char)(type | n));
+                return;
+            }
+            int size{n <= 0xff ? 0 : n <= 0xffff ? 1 : n <= 0xffffffff ? 2 : 3};
+            this->raw((char)(type | (24 + size)));
+            this->big_endian(n, 1 << size);
+            return;
+        }
+
+        const MsgPackType &t{MSGPACK_TYPES[(int)major]};
+        if (n < t.fix_limit) {
+            /* a negative fixint is the two's complement of the value */
+            this->raw((char)(major == Major::NEGATIVE ? ~n : t.fix | n));
+            return;
+        }
+        /* a negative value needs room for the sign bit */
+        uint64_t magnitude{major == Major::NEGATIVE ? n << 1 : n};
+        int size{magnitude <= 0xff         ? 0
+                 : magnitude <= 0xffff     ? 1
+                 : magnitude <= 0xffffffff ? 2
+                                           : 3};
+        while (t.sized[size] == 0) {
+            size++;
+        }
+        this->raw((char)t.sized[size]);
+        this->big_endian(major == Major::NEGATIVE ? ~n : n, 1 << size);
+    }
+};
+
+/*
+ * Prints a message with emit(w) in the given wire format, a full buffer is
+ * reported as length 0. Without a buffer, the size of the message is returned.
+ */
+template <typename Emit>
+static uint32_t marshal(WireFormat format, Emit emit, bool has_id,
+                        uint32_t request_id, char *buf, size_t buf_size)
+{
+    if (format == WireFormat::JSON) {
+        JsonWriter w{buf, buf_size};
+        emit(w);
+        return w.overflowed() ? 0 : (uint32_t)w.size();
+    }
+    BinaryWriter w{format, buf, buf_size};
+    emit(w);
+    w.finish(has_id, request_id);
+    return w.overflowed() ? 0 : (uint32_t)w.size();
 }
 
-static void from_json(const nlohmann::json &j, mcd_run_result &res)
-{
-    j.at("return-status").get_to(res.return_status);
+/*
+ * The emitters of the arguments are generated from codegen/structs.py by
+ * codegen/qmp.py, do not edit them by hand.
+ */
+
+template <typename Writer>
+static void emit_mcd_open_server_args(Writer &w,
+                                      const mcd_open_server_args *obj)
+{
+    w.begin_object(2);
+    w.key("config-string");
+    w.string(obj->config_string);
+    w.key("system-key");
+    w.string(obj->system_key);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_close_server_args(Writer &w,
+                                       const mcd_close_server_args *obj)
+{
+    w.begin_object(1);
+    w.key("server-uid");
+    w.number(obj->server_uid);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_qry_systems_args(Writer &w,
+                                      const mcd_qry_systems_args *obj)
+{
+    w.begin_object(2);
+    w.key("num-systems");
+    w.number(obj->num_systems);
+    w.key("start-index");
+    w.number(obj->start_index);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_core_con_info_st(Writer &w,
+                                      const mcd_core_con_info_st *obj)
+{
+    w.begin_object(14);
+    w.key("acc-hw");
+    w.string(obj->acc_hw);
+    w.key("core");
+    w.string(obj->core);
+    w.key("core-id");
+    w.number(obj->core_id);
+    w.key("core-type");
+    w.number(obj->core_type);
+    w.key("device");
+    w.string(obj->device);
+    w.key("device-id");
+    w.number(obj->device_id);
+    w.key("device-key");
+    w.string(obj->device_key);
+    w.key("device-type");
+    w.number(obj->device_type);
+    w.key("host");
+    w.string(obj->host);
+    w.key("server-key");
+    w.string(obj->server_key);
+    w.key("server-port");
+    w.number(obj->server_port);
+    w.key("system");
+    w.string(obj->system);
+    w.key("system-instance");
+    w.string(obj->system_instance);
+    w.key("system-key");
+    w.string(obj->system_key);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_qry_devices_args(Writer &w,
+                                      const mcd_qry_devices_args *obj)
+{
+    w.begin_object(3);
+    w.key("num-devices");
+    w.number(obj->num_devices);
+    w.key("start-index");
+    w.number(obj->start_index);
+    w.key("system-con-info");
+    emit_mcd_core_con_info_st(w, obj->system_con_info);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_qry_cores_args(Writer &w, const mcd_qry_cores_args *obj)
+{
+    w.begin_object(3);
+    w.key("connection-info");
+    emit_mcd_core_con_info_st(w, obj->connection_info);
+    w.key("num-cores");
+    w.number(obj->num_cores);
+    w.key("start-index");
+    w.number(obj->start_index);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_open_core_args(Writer &w, const mcd_open_core_args *obj)
+{
+    w.begin_object(1);
+    w.key("core-con-info");
+    emit_mcd_core_con_info_st(w, obj->core_con_info);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_close_core_args(Writer &w, const mcd_close_core_args *obj)
+{
+    w.begin_object(1);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_qry_error_info_args(Writer &w,
+                                         const mcd_qry_error_info_args *obj)
+{
+    w.begin_object(1);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_qry_mem_spaces_args(Writer &w,
+                                         const mcd_qry_mem_spaces_args *obj)
+{
+    w.begin_object(3);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.key("num-mem-spaces");
+    w.number(obj->num_mem_spaces);
+    w.key("start-index");
+    w.number(obj->start_index);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_qry_reg_groups_args(Writer &w,
+                                         const mcd_qry_reg_groups_args *obj)
+{
+    w.begin_object(3);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.key("num-reg-groups");
+    w.number(obj->num_reg_groups);
+    w.key("start-index");
+    w.number(obj->start_index);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_qry_reg_map_args(Writer &w,
+                                      const mcd_qry_reg_map_args *obj)
+{
+    w.begin_object(4);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.key("num-regs");
+    w.number(obj->num_regs);
+    w.key("reg-group-id");
+    w.number(obj->reg_group_id);
+    w.key("start-index");
+    w.number(obj->start_index);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_addr_st(Writer &w, const mcd_addr_st *obj)
+{
+    w.begin_object(4);
+    w.key("addr-space-id");
+    w.number(obj->addr_space_id);
+    w.key("addr-space-type");
+    w.number(obj->addr_space_type);
+    w.key("address");
+    w.number(obj->address);
+    w.key("mem-space-id");
+    w.number(obj->mem_space_id);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_tx_st(Writer &w, const mcd_tx_st *obj)
+{
+    w.begin_object(8);
+    w.key("access-type");
+    w.number(obj->access_type);
+    w.key("access-width");
+    w.number(obj->access_width);
+    w.key("addr");
+    emit_mcd_addr_st(w, &obj->addr);
+    w.key("core-mode");
+    w.number(obj->core_mode);
+    w.key("data");
+    w.bytes(obj->data, obj->num_bytes);
+    w.key("num-bytes");
+    w.number(obj->num_bytes);
+    w.key("num-bytes-ok");
+    w.number(obj->num_bytes_ok);
+    w.key("options");
+    w.number(obj->options);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_txlist_st(Writer &w, const mcd_txlist_st *obj)
+{
+    w.begin_object(3);
+    w.key("num-tx");
+    w.number(obj->num_tx);
+    w.key("num-tx-ok");
+    w.number(obj->num_tx_ok);
+    w.key("tx");
+    w.begin_array(obj->num_tx);
+    for (uint32_t i{0}; i < obj->num_tx; i++) {
+        emit_mcd_tx_st(w, obj->tx + i);
+    }
+    w.end_array();
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_execute_txlist_args(Writer &w,
+                                         const mcd_execute_txlist_args *obj)
+{
+    w.begin_object(2);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.key("txlist");
+    emit_mcd_txlist_st(w, obj->txlist);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_qry_trig_info_args(Writer &w,
+                                        const mcd_qry_trig_info_args *obj)
+{
+    w.begin_object(1);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_qry_ctrigs_args(Writer &w, const mcd_qry_ctrigs_args *obj)
+{
+    w.begin_object(3);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.key("num-ctrigs");
+    w.number(obj->num_ctrigs);
+    w.key("start-index");
+    w.number(obj->start_index);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_trig_complex_core_st(Writer &w,
+                                          const mcd_trig_complex_core_st *obj)
+{
+    w.begin_object(15);
+    w.key("action");
+    w.number(obj->action);
+    w.key("action-param");
+    w.number(obj->action_param);
+    w.key("addr-range");
+    w.number(obj->addr_range);
+    w.key("addr-start");
+    emit_mcd_addr_st(w, &obj->addr_start);
+    w.key("core-mode-mask");
+    w.number(obj->core_mode_mask);
+    w.key("data-mask");
+    w.number(obj->data_mask);
+    w.key("data-range");
+    w.number(obj->data_range);
+    w.key("data-size");
+    w.number(obj->data_size);
+    w.key("data-start");
+    w.number(obj->data_start);
+    w.key("hw-thread-id");
+    w.number(obj->hw_thread_id);
+    w.key("modified");
+    w.boolean(obj->modified);
+    w.key("option");
+    w.number(obj->option);
+    w.key("state-mask");
+    w.number(obj->state_mask);
+    w.key("sw-thread-id");
+    w.number(obj->sw_thread_id);
+    w.key("type");
+    w.number(obj->type);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_trig_simple_core_st(Writer &w,
+                                         const mcd_trig_simple_core_st *obj)
+{
+    w.begin_object(8);
+    w.key("action");
+    w.number(obj->action);
+    w.key("action-param");
+    w.number(obj->action_param);
+    w.key("addr-range");
+    w.number(obj->addr_range);
+    w.key("addr-start");
+    emit_mcd_addr_st(w, &obj->addr_start);
+    w.key("modified");
+    w.boolean(obj->modified);
+    w.key("option");
+    w.number(obj->option);
+    w.key("state-mask");
+    w.number(obj->state_mask);
+    w.key("type");
+    w.number(obj->type);
+    w.end_object();
+}
+
+template <typename Writer>
+static void emit_mcd_rpc_trig_st(Writer &w, const mcd_rpc_trig_st *obj)
+{
+    /* a choice is an object with the present variant */
+    if (obj->is_simple_core) {
+        w.begin_object(1);
+        w.key("trig-simple-core");
+        emit_mcd_trig_simple_core_st(w, obj->simple_core);
+        w.end_object();
+    } else if (obj->is_complex_core) {
+        w.begin_object(1);
+        w.key("trig-complex-core");
+        emit_mcd_trig_complex_core_st(w, obj->complex_core);
+        w.end_object();
+    } else {
+        w.null();
+    }
 }
 
-static void to_json(nlohmann::json &j, const mcd_stop_args &args)
+template <typename Writer>
+static void emit_mcd_create_trig_args(Writer &w,
+                                      const mcd_create_trig_args *obj)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-        {"global", args.global},
-    };
+    w.begin_object(2);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.key("trig");
+    emit_mcd_rpc_trig_st(w, obj->trig);
+    w.end_object();
 }
 
-static void from_json(const nlohmann::json &j, mcd_stop_result &res)
+template <typename Writer>
+static void emit_mcd_qry_trig_args(Writer &w, const mcd_qry_trig_args *obj)
 {
-    j.at("return-status").get_to(res.return_status);
+    w.begin_object(2);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.key("trig-id");
+    w.number(obj->trig_id);
+    w.end_object();
 }
 
-static void to_json(nlohmann::json &j, const mcd_step_args &args)
+template <typename Writer>
+static void emit_mcd_remove_trig_args(Writer &w,
+                                      const mcd_remove_trig_args *obj)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-        {"global", args.global},
-        {"step-type", args.step_type},
-        {"n-steps", args.n_steps},
-    };
+    w.begin_object(2);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.key("trig-id");
+    w.number(obj->trig_id);
+    w.end_object();
 }
 
-static void from_json(const nlohmann::json &j, mcd_step_result &res)
+template <typename Writer>
+static void emit_mcd_qry_trig_state_args(Writer &w,
+                                         const mcd_qry_trig_state_args *obj)
 {
-    j.at("return-status").get_to(res.return_status);
+    w.begin_object(2);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.key("trig-id");
+    w.number(obj->trig_id);
+    w.end_object();
 }
 
-static void to_json(nlohmann::json &j, const mcd_set_global_args &args)
+template <typename Writer>
+static void emit_mcd_activate_trig_set_args(
+    Writer &w, const mcd_activate_trig_set_args *obj)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-        {"enable", args.enable},
-    };
+    w.begin_object(1);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.end_object();
 }
 
-static void from_json(const nlohmann::json &j, mcd_set_global_result &res)
+template <typename Writer>
+static void emit_mcd_remove_trig_set_args(Writer &w,
+                                          const mcd_remove_trig_set_args *obj)
 {
-    j.at("return-status").get_to(res.return_status);
+    w.begin_object(1);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.end_object();
 }
 
-static void to_json(nlohmann::json &j, const mcd_qry_state_args &args)
+template <typename Writer>
+static void emit_mcd_qry_trig_set_args(Writer &w,
+                                       const mcd_qry_trig_set_args *obj)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-    };
+    w.begin_object(3);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.key("num-trigs");
+    w.number(obj->num_trigs);
+    w.key("start-index");
+    w.number(obj->start_index);
+    w.end_object();
 }
 
-static void from_json(const nlohmann::json &j, mcd_qry_state_result &res)
+template <typename Writer>
+static void emit_mcd_qry_trig_set_state_args(
+    Writer &w, const mcd_qry_trig_set_state_args *obj)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "state", *res.state);
+    w.begin_object(1);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.end_object();
 }
 
-static void to_json(nlohmann::json &j, const mcd_qry_rst_classes_args &args)
+template <typename Writer>
+static void emit_mcd_run_args(Writer &w, const mcd_run_args *obj)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-    };
+    w.begin_object(2);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.key("global");
+    w.boolean(obj->global);
+    w.end_object();
 }
 
-static void from_json(const nlohmann::json &j, mcd_qry_rst_classes_result &res)
+template <typename Writer>
+static void emit_mcd_stop_args(Writer &w, const mcd_stop_args *obj)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "rst-class-vector", *res.rst_class_vector);
+    w.begin_object(2);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.key("global");
+    w.boolean(obj->global);
+    w.end_object();
 }
 
-static void to_json(nlohmann::json &j, const mcd_qry_rst_class_info_args &args)
+template <typename Writer>
+static void emit_mcd_step_args(Writer &w, const mcd_step_args *obj)
 {
-    j = nlohmann::json{
-        {"core-uid", args.core_uid},
-        {"rst-class", args.rst_class},
-    };
+    w.begin_object(4);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.key("global");
+    w.boolean(obj->global);
+    w.key("n-steps");
+    w.number(obj->n_steps);
+    w.key("step-type");
+    w.number(obj->step_type);
+    w.end_object();
 }
 
-static void from_json(const nlohmann::json &j,
-                      mcd_qry_rst_class_info_result &res)
+template <typename Writer>
+static void emit_mcd_set_global_args(Writer &w, const mcd_set_global_args *obj)
 {
-    j.at("return-status").get_to(res.return_status);
-    json_get_to_optional(j, "rst-info", *res.rst_info);
+    w.begin_object(2);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.key("enable");
+    w.boolean(obj->enable);
+    w.end_object();
 }
 
-static void to_json(nlohmann::json &j, const mcd_rst_args &args)
+template <typename Writer>
+static void emit_mcd_qry_state_args(Writer &w, const mcd_qry_state_args *obj)
 {
-    j = nlohmann::json{{"core-uid", args.core_uid},
-                       {"rst-class-vector", args.rst_class_vector},
-                       {"rst-and-halt", args.rst_and_halt}};
+    w.begin_object(1);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.end_object();
 }
 
-static void from_json(const nlohmann::json &j, mcd_rst_result &res)
+template <typename Writer>
+static void emit_mcd_qry_rst_classes_args(Writer &w,
+                                          const mcd_qry_rst_classes_args *obj)
 {
-    j.at("return-status").get_to(res.return_status);
+    w.begin_object(1);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.end_object();
 }
 
-struct ostreambuf : public std::streambuf {
-private:
-    char_type *const buffer;
+template <typename Writer>
+static void emit_mcd_qry_rst_class_info_args(
+    Writer &w, const mcd_qry_rst_class_info_args *obj)
+{
+    w.begin_object(2);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.key("rst-class");
+    w.number(obj->rst_class);
+    w.end_object();
+}
 
-public:
-    ostreambuf(char_type *buffer, std::streamsize bufferLength) : buffer(buffer)
-    {
-        std::streambuf::setp(buffer, buffer + bufferLength);
-    }
+template <typename Writer>
+static void emit_mcd_rst_args(Writer &w, const mcd_rst_args *obj)
+{
+    w.begin_object(3);
+    w.key("core-uid");
+    w.number(obj->core_uid);
+    w.key("rst-and-halt");
+    w.boolean(obj->rst_and_halt);
+    w.key("rst-class-vector");
+    w.number(obj->rst_class_vector);
+    w.end_object();
+}
 
-    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
-                             std::ios_base::openmode which) override
-    {
-        if (!(which == std::ios_base::out && dir == std::ios_base::cur))
-            throw std::runtime_error("seekoff parameters not supported");
+/* the emitter of a struct for either writer */
+#define EMITTER(type) [](auto &w, const type *obj) { emit_##type(w, obj); }
 
-        pbump(static_cast<int>(off));
-        return pptr() - pbase();
-    }
-};
+template <typename T, typename EmitArgs>
+static uint32_t marshal_request(WireFormat format, const char *execute,
+                                EmitArgs emit_args, const T *args,
+                                uint32_t request_id, char *buf,
+                                size_t buf_size)
+{
+    auto emit{[&](auto &w) {
+        w.begin_object(3);
+        w.key("arguments");
+        emit_args(w, args);
+        w.key("execute");
+        w.string(execute);
+        w.key("id");
+        w.number(request_id);
+        w.end_object();
+    }};
+    return marshal(format, emit, true, request_id, buf, buf_size);
+}
 
 uint32_t marshal_mcd_exit(char *buf, size_t buf_size)
 {
-    ostreambuf b{buf, (std::streamsize)buf_size};
-    std::ostream json_output{&b};
-    json_output << nlohmann::json{{"execute", "mcd-exit"}};
-    return (uint32_t)json_output.tellp();
+    auto emit{[](auto &w) {
+        w.begin_object(1);
+        w.key("execute");
+        w.string("mcd-exit");
+        w.end_object();
+    }};
+    return marshal(wire_format, emit, false, 0, buf, buf_size);
+}
+
+/* the server has not seen the config string yet, so it is always JSON */
+uint32_t serialized_size_mcd_open_server_args(mcd_open_server_args const *args,
+                                              uint32_t request_id)
+{
+    return marshal_request(WireFormat::JSON, "mcd-open-server",
+                           EMITTER(mcd_open_server_args), args, request_id,
+                           nullptr, 0);
 }
 
 uint32_t marshal_mcd_open_server_args(mcd_open_server_args const *args,
-                                      char *buf, size_t buf_size)
+                                      uint32_t request_id, char *buf,
+                                      size_t buf_size)
 {
-    ostreambuf b{buf, (std::streamsize)buf_size};
-    std::ostream json_output{&b};
-    json_output << nlohmann::json{{"execute", "mcd-open-server"},
-                                  {"arguments", *args}};
-    return (uint32_t)json_output.tellp();
+    /* every connection starts with JSON and the array encoding */
+    wire_format = WireFormat::JSON;
+    wire_format_requested = config_wire_format(args->config_string);
+    data_encoding = DataEncoding::ARRAY;
+    data_encoding_requested = config_data_encoding(args->config_string);
+    return marshal_request(WireFormat::JSON, "mcd-open-server",
+                           EMITTER(mcd_open_server_args), args, request_id,
+                           buf, buf_size);
 }
 
 mcd_return_et unmarshal_mcd_open_server_result(char const *buf,
                                                mcd_open_server_result *res,
-                                               mcd_error_info_st *error_info)
-{
-    const char *json_line = buf;
-    while (*json_line != '\0') {
-        /* find next occurence of '\n' or '\0'; */
-        size_t len{1};
-        while (json_line[len] != '\n' && json_line[len] != '\0') {
-            len++;
+                                               mcd_error_info_st *)
+{
+    mcd_return_et ret{unmarshal_response(buf, res)};
+    /* the server accepts the format and the encoding by echoing the keys */
+    if (ret == MCD_RET_ACT_NONE &&
+        res->return_status == MCD_RET_ACT_NONE) {
+        if (config_wire_format(res->server.config_string) ==
+            wire_format_requested) {
+            wire_format = wire_format_requested;
         }
-        std::string_view line{json_line, len};
-        try {
-            nlohmann::json response = nlohmann::json::parse(line);
-            response.at("return").get_to(*res);
-            return MCD_RET_ACT_NONE;
-        } catch (const std::exception &) {
-            /* skip line */
+        if (config_data_encoding(res->server.config_string) ==
+            data_encoding_requested) {
+            data_encoding = data_encoding_requested;
         }
-        json_line += len;
     }
-    /* not found */
-    return MCD_RET_ACT_HANDLE_ERROR;
+    return ret;
 }
 
 #define DEFINE_QMP(function, qmp)                                              \
+    uint32_t serialized_size_##function##_args(function##_args const *args,    \
+                                               uint32_t request_id)            \
+    {                                                                          \
+        return marshal_request(wire_format, qmp, EMITTER(function##_args),     \
+                               args, request_id, nullptr, 0);                  \
+    }                                                                          \
     uint32_t marshal_##function##_args(function##_args const *args,            \
-                                       char *buf, size_t buf_size)             \
+                                       uint32_t request_id, char *buf,         \
+                                       size_t buf_size)                        \
     {                                                                          \
-        ostreambuf b{buf, (std::streamsize)buf_size};                          \
-        std::ostream json_output{&b};                                          \
-        json_output << nlohmann::json{{"execute", qmp}, {"arguments", *args}}; \
-        return (uint32_t)json_output.tellp();                                  \
+        return marshal_request(wire_format, qmp, EMITTER(function##_args),     \
+                               args, request_id, buf, buf_size);               \
     }                                                                          \
     mcd_return_et unmarshal_##function##_result(char const *buf,               \
                                                 function##_result *res,        \
-                                                mcd_error_info_st *error_info) \
+                                                mcd_error_info_st *)           \
     {                                                                          \
-        const char *json_line = buf;                                           \
-        while (*json_line != '\0') {                                           \
-            /* find next occurence of '\n' or '\0'; */                         \
-            size_t len{1};                                                     \
-            while (json_line[len] != '\n' && json_line[len] != '\0') {         \
-                len++;                                                         \
-            }                                                                  \
-            std::string_view line{json_line, len};                             \
-            try {                                                              \
-                nlohmann::json response = nlohmann::json::parse(line);         \
-                response.at("return").get_to(*res);                            \
-                return MCD_RET_ACT_NONE;                                       \
-            } catch (const std::exception &) {                                 \
-                /* skip line */                                                \
-            }                                                                  \
-            json_line += len;                                                  \
-        }                                                                      \
-        /* not found */                                                        \
-        return MCD_RET_ACT_HANDLE_ERROR;                                       \
+        return unmarshal_response(buf, res);                                   \
     }
 
 DEFINE_QMP(mcd_close_server, "mcd-close-server")
@@ -928,3 +2157,35 @@ DEFINE_QMP(mcd_qry_state, "mcd-qry-state")
 DEFINE_QMP(mcd_qry_rst_classes, "mcd-qry-rst-classes")
 DEFINE_QMP(mcd_qry_rst_class_info, "mcd-qry-rst-class-info")
 DEFINE_QMP(mcd_rst, "mcd-rst")
+
+/*
+ * The bounds assume the longest decimal representation for every number.
+ * Events sent by the server might share the receive buffer with the response,
+ * so the list overhead leaves some headroom for them.
+ */
+uint32_t marshal_mcd_execute_txlist_bound(void) { return 1024; }
+
+uint32_t marshal_mcd_tx_st_bound(const mcd_tx_st *tx)
+{
+    if (wire_format != WireFormat::JSON) {
+        /* the data follows a byte string header of up to five bytes */
+        return 320 + tx->num_bytes;
+    }
+    switch (data_encoding) {
+    case DataEncoding::HEX:
+        return 320 + 2 * tx->num_bytes;
+    case DataEncoding::BASE64:
+        return 320 + 4 * ((tx->num_bytes + 2) / 3);
+    default:
+        /* every data byte is encoded as up to three digits plus separator */
+        return 320 + 4 * tx->num_bytes;
+    }
+}
+
+uint32_t unmarshal_mcd_qry_reg_map_bound(void) { return 1024; }
+
+uint32_t unmarshal_mcd_register_info_st_bound(void)
+{
+    /* every character of the name might be escaped as \u00XX */
+    return 384 + 6 * MCD_REG_NAME_LEN;
+}
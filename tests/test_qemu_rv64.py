@@ -446,6 +446,20 @@ def test_remove_trig_set(open_core, logical_memspace):
     assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
     assert(num_trigs.value == 0)
 
+def test_read_all_registers(open_core, queried_registers, pc, read_pc):
+    reg_p, num_regs = queried_registers
+    buffers = [(c_uint8*(reg_p[i].regsize // 8))() for i in range(num_regs)]
+    txs = (mcd_tx_st*num_regs)()
+    for i in range(num_regs):
+        size = reg_p[i].regsize // 8
+        txs[i] = mcd_tx_st(reg_p[i].addr, mcd_tx_access_type_et.MCD_TX_AT_R, 0, 0, 0, buffers[i], size, 0)
+    txlist = mcd_txlist_st(txs, num_regs, 0)
+    ret = mcd_execute_txlist_f(open_core, byref(txlist))
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    assert(txlist.num_tx_ok == num_regs)
+    pc_index = [i for i in range(num_regs) if reg_p[i].addr.address == pc.addr.address][0]
+    assert(int.from_bytes(list(buffers[pc_index]), byteorder='little') == read_pc())
+
 def test_close_server(connected_server):
     server_p = connected_server
     ret = mcd_close_server_f(server_p)
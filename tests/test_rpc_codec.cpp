@@ -0,0 +1,652 @@
+/*
+MIT License
+
+Copyright (c) 2025 Lauterbach GmbH
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * RPC codec test
+ *
+ * Round-trips requests and results through the marshal and unmarshal
+ * functions with the fixed and the compact (varint) integer encoding, with
+ * and without request IDs. The codec is included as a whole to reach its
+ * static functions. No server is involved.
+ *
+ * Usage: rpc_codec_test
+ */
+
+#include "../src/mcd_rpc.cpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <type_traits>
+#include <vector>
+
+#include "comm.hpp"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d (%s encoding, %s request IDs): %s\n",     \
+                    __FILE__, __LINE__,                                      \
+                    compact_encoding ? "compact" : "fixed",                  \
+                    request_ids ? "with" : "without", #cond);                \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+/* the compact size is the length of the varint, the fixed one the width */
+template <typename T>
+static void check_primitive(int (*marshal)(T, char *),
+                            int (*unmarshal)(const char *, T *),
+                            std::type_identity_t<T> value, int compact_size)
+{
+    char buf[16]{};
+    const int size{compact_encoding ? compact_size : (int)sizeof(T)};
+    CHECK(marshal(value, buf) == size);
+    CHECK(size <= (int)encoded_size(sizeof(T)));
+    T result{};
+    CHECK(unmarshal(buf, &result) == size);
+    CHECK(result == value);
+}
+
+static void test_primitives()
+{
+    check_primitive(marshal_uint8_t, unmarshal_uint8_t, (uint8_t)0, 1);
+    check_primitive(marshal_uint8_t, unmarshal_uint8_t, (uint8_t)UINT8_MAX, 1);
+
+    check_primitive(marshal_uint16_t, unmarshal_uint16_t, (uint16_t)127, 1);
+    check_primitive(marshal_uint16_t, unmarshal_uint16_t, (uint16_t)128, 2);
+    check_primitive(marshal_uint16_t, unmarshal_uint16_t, (uint16_t)UINT16_MAX,
+                    3);
+
+    check_primitive(marshal_uint32_t, unmarshal_uint32_t, (uint32_t)0, 1);
+    check_primitive(marshal_uint32_t, unmarshal_uint32_t, (uint32_t)127, 1);
+    check_primitive(marshal_uint32_t, unmarshal_uint32_t, (uint32_t)128, 2);
+    check_primitive(marshal_uint32_t, unmarshal_uint32_t, (uint32_t)16383, 2);
+    check_primitive(marshal_uint32_t, unmarshal_uint32_t, (uint32_t)16384, 3);
+    check_primitive(marshal_uint32_t, unmarshal_uint32_t, (uint32_t)UINT32_MAX,
+                    5);
+
+    check_primitive(marshal_uint64_t, unmarshal_uint64_t, (uint64_t)0, 1);
+    check_primitive(marshal_uint64_t, unmarshal_uint64_t, (uint64_t)127, 1);
+    check_primitive(marshal_uint64_t, unmarshal_uint64_t, (uint64_t)128, 2);
+    check_primitive(marshal_uint64_t, unmarshal_uint64_t,
+                    (uint64_t)UINT32_MAX, 5);
+    check_primitive(marshal_uint64_t, unmarshal_uint64_t,
+                    (uint64_t)UINT32_MAX + 1, 5);
+    check_primitive(marshal_uint64_t, unmarshal_uint64_t, (uint64_t)1 << 63,
+                    10);
+    check_primitive(marshal_uint64_t, unmarshal_uint64_t, UINT64_MAX, 10);
+
+    /* enums are encoded by their unsigned value */
+    check_primitive(marshal_mcd_return_et, unmarshal_mcd_return_et,
+                    MCD_RET_ACT_NONE, 1);
+    check_primitive(marshal_mcd_return_et, unmarshal_mcd_return_et,
+                    MCD_RET_ACT_HANDLE_ERROR, 1);
+    check_primitive(marshal_mcd_addr_space_type_et,
+                    unmarshal_mcd_addr_space_type_et, MCD_NOTUSED_ID, 1);
+    check_primitive(marshal_mcd_error_code_et, unmarshal_mcd_error_code_et,
+                    MCD_ERR_CONNECTION, 2);
+    check_primitive(marshal_mcd_error_code_et, unmarshal_mcd_error_code_et,
+                    MCD_ERR_CUSTOM_HI, 5);
+
+    /* the fixed encoding is little-endian on every host */
+    char buf[4];
+    marshal_fixed_uint32_t(0x12345678, buf);
+    CHECK(buf[0] == 0x78 && buf[1] == 0x56 && buf[2] == 0x34 &&
+          buf[3] == 0x12);
+}
+
+/*
+ * Arrays are copied in bulk with the fixed encoding. The buffer and the
+ * result have one more element, which must not be touched.
+ */
+template <typename T>
+static void check_array(const std::vector<T> &values)
+{
+    const char CANARY{0x5a};
+    const T SENTINEL{(T)0x5a};
+    const uint32_t len{(uint32_t)values.size()};
+    const uint32_t max_size{len * encoded_size(sizeof(T))};
+    std::vector<char> buf(max_size + 1, CANARY);
+    const uint32_t size{marshal_array(values.data(), len, buf.data())};
+    CHECK(size <= max_size);
+    CHECK(compact_encoding || size == len * sizeof(T));
+    CHECK(buf[max_size] == CANARY);
+    std::vector<T> result(len + 1, SENTINEL);
+    CHECK(unmarshal_array(buf.data(), result.data(), len) == size);
+    CHECK(std::equal(values.begin(), values.end(), result.begin()));
+    CHECK(result[len] == SENTINEL);
+}
+
+/* values with a varint of every length, or only of the maximum length */
+template <typename T>
+static std::vector<T> array_values(uint32_t len, bool widest)
+{
+    std::vector<T> values(len);
+    for (uint32_t i{0}; i < len; i++) {
+        values[i] = widest ? (T)~(T)0 : (T)((T)1 << (i % (8 * sizeof(T))));
+    }
+    return values;
+}
+
+template <typename T>
+static void check_arrays()
+{
+    check_array(std::vector<T>{});
+    check_array(array_values<T>(1, true));
+    check_array(array_values<T>(100, false));
+    /* as many elements as fit into a packet */
+    const uint32_t capacity{MCD_MAX_PACKET_LENGTH / encoded_size(sizeof(T))};
+    check_array(array_values<T>(capacity, false));
+    check_array(array_values<T>(capacity, true));
+}
+
+static void test_arrays()
+{
+    check_arrays<uint8_t>();
+    check_arrays<mcd_char_t>();
+    check_arrays<uint16_t>();
+    check_arrays<uint32_t>();
+    check_arrays<uint64_t>();
+}
+
+static void check_addr(const mcd_addr_st &a, const mcd_addr_st &b)
+{
+    CHECK(a.address == b.address);
+    CHECK(a.mem_space_id == b.mem_space_id);
+    CHECK(a.addr_space_id == b.addr_space_id);
+    CHECK(a.addr_space_type == b.addr_space_type);
+}
+
+static void check_tx(const mcd_tx_st &a, const mcd_tx_st &b)
+{
+    check_addr(a.addr, b.addr);
+    CHECK(a.access_type == b.access_type);
+    CHECK(a.options == b.options);
+    CHECK(a.access_width == b.access_width);
+    CHECK(a.core_mode == b.core_mode);
+    CHECK(a.num_bytes == b.num_bytes);
+    CHECK(a.num_bytes_ok == b.num_bytes_ok);
+    CHECK(a.num_bytes == 0 || memcmp(a.data, b.data, a.num_bytes) == 0);
+}
+
+static void test_structs()
+{
+    std::vector<char> buf(MCD_MAX_PACKET_LENGTH);
+
+    const mcd_addr_st addrs[] = {
+        {},
+        {
+            .address = UINT64_MAX,
+            .mem_space_id = UINT32_MAX,
+            .addr_space_id = 128,
+            .addr_space_type = MCD_OVERLAY_ID,
+        },
+    };
+    for (const mcd_addr_st &addr : addrs) {
+        uint32_t size{marshal_mcd_addr_st(&addr, buf.data())};
+        CHECK(size <= serialized_size_mcd_addr_st(&addr));
+        CHECK(compact_encoding || size == serialized_size_mcd_addr_st(&addr));
+        mcd_addr_st result{};
+        CHECK(unmarshal_mcd_addr_st(buf.data(), &result) == size);
+        check_addr(addr, result);
+    }
+
+    mcd_core_con_info_st info{
+        .host = "localhost",
+        .server_port = 1235,
+        .server_key = "",
+        .system_key = "",
+        .device_key = "",
+        .system = "system",
+        .system_instance = "",
+        .acc_hw = "",
+        .device_type = UINT32_MAX,
+        .device = "device",
+        .device_id = 128,
+        .core = "core0",
+        .core_type = 127,
+        .core_id = 0,
+    };
+    uint32_t size{marshal_mcd_core_con_info_st(&info, buf.data())};
+    CHECK(size <= serialized_size_mcd_core_con_info_st(&info));
+    mcd_core_con_info_st info_result{};
+    CHECK(unmarshal_mcd_core_con_info_st(buf.data(), &info_result) == size);
+    CHECK(memcmp(&info, &info_result, sizeof(info)) == 0);
+}
+
+/*
+ * Structs with a wire layout are copied as a whole with the fixed encoding on
+ * little-endian hosts. The copy has to produce the same bytes as the
+ * field-wise marshal function.
+ */
+template <typename T, typename F>
+static void check_wire_layout(const T &obj, F marshal_fields)
+{
+    char packed[64]{};
+    char fields[64]{};
+    const uint32_t packed_size{marshal_packed(&obj, packed)};
+    const uint32_t fields_size{marshal_fields(&obj, fields)};
+    if (compact_encoding || HOST_BIG_ENDIAN) {
+        CHECK(packed_size == 0);
+        return;
+    }
+    CHECK(WireLayout<T>::PACKED);
+    CHECK(WireLayout<T>::SIZE == fields_size);
+    CHECK(packed_size == fields_size);
+    CHECK(memcmp(packed, fields, fields_size) == 0);
+    T result;
+    memset(&result, 0xff, sizeof(result));
+    CHECK(unmarshal_packed(fields, &result) == fields_size);
+    CHECK(memcmp(&obj, &result, WireLayout<T>::SIZE) == 0);
+}
+
+static void test_wire_layouts()
+{
+    const mcd_addr_st addr{
+        .address = 0x0102030405060708,
+        .mem_space_id = 0x090a0b0c,
+        .addr_space_id = 0x0d0e0f10,
+        .addr_space_type = MCD_OVERLAY_ID,
+    };
+    check_wire_layout(addr, [](const mcd_addr_st *obj, char *buf) {
+        char *tail{buf};
+        tail += marshal_uint64_t(obj->address, tail);
+        tail += marshal_uint32_t(obj->mem_space_id, tail);
+        tail += marshal_uint32_t(obj->addr_space_id, tail);
+        tail += marshal_mcd_addr_space_type_et(obj->addr_space_type, tail);
+        return (uint32_t)(tail - buf);
+    });
+
+    check_wire_layout(mcd_qry_systems_args{0x01020304, 0x05060708},
+                      rpc_marshal_mcd_qry_systems_args);
+    check_wire_layout(mcd_qry_mem_spaces_args{1, 128, UINT32_MAX},
+                      rpc_marshal_mcd_qry_mem_spaces_args);
+    check_wire_layout(mcd_qry_reg_groups_args{1, 128, UINT32_MAX},
+                      rpc_marshal_mcd_qry_reg_groups_args);
+    check_wire_layout(mcd_qry_reg_map_args{1, 2, 128, UINT32_MAX},
+                      rpc_marshal_mcd_qry_reg_map_args);
+    check_wire_layout(mcd_qry_ctrigs_args{1, 128, UINT32_MAX},
+                      rpc_marshal_mcd_qry_ctrigs_args);
+    check_wire_layout(mcd_qry_trig_args{1, 0x01020304},
+                      rpc_marshal_mcd_qry_trig_args);
+    check_wire_layout(mcd_remove_trig_args{1, 0x01020304},
+                      rpc_marshal_mcd_remove_trig_args);
+    check_wire_layout(mcd_qry_trig_state_args{1, 0x01020304},
+                      rpc_marshal_mcd_qry_trig_state_args);
+    check_wire_layout(mcd_qry_trig_set_args{1, 128, UINT32_MAX},
+                      rpc_marshal_mcd_qry_trig_set_args);
+    check_wire_layout(mcd_qry_rst_class_info_args{0x01020304, 0xab},
+                      rpc_marshal_mcd_qry_rst_class_info_args);
+}
+
+/* a read and a write transaction, the data of the results is separate */
+struct TxList {
+    uint8_t data[2][300];
+    mcd_tx_st tx[2];
+    mcd_txlist_st txlist;
+
+    TxList()
+    {
+        for (int i{0}; i < 300; i++) {
+            data[0][i] = 0;
+            data[1][i] = (uint8_t)i;
+        }
+        tx[0] = {
+            .addr = {.address = 0x80000000,
+                     .mem_space_id = 0,
+                     .addr_space_id = 0,
+                     .addr_space_type = MCD_NOTUSED_ID},
+            .access_type = MCD_TX_AT_R,
+            .options = MCD_TX_OPT_DEFAULT,
+            .access_width = 4,
+            .core_mode = 0,
+            .data = data[0],
+            .num_bytes = 128,
+            .num_bytes_ok = 0,
+        };
+        tx[1] = {
+            .addr = {.address = UINT64_MAX - 299,
+                     .mem_space_id = 1,
+                     .addr_space_id = 0,
+                     .addr_space_type = MCD_NOTUSED_ID},
+            .access_type = MCD_TX_AT_W,
+            .options = MCD_TX_OPT_SIDE_EFFECTS,
+            .access_width = 1,
+            .core_mode = UINT8_MAX,
+            .data = data[1],
+            .num_bytes = 300,
+            .num_bytes_ok = 300,
+        };
+        txlist = {.tx = tx, .num_tx = 2, .num_tx_ok = 1};
+    }
+
+    void clear()
+    {
+        memset(data, 0, sizeof(data));
+        for (mcd_tx_st &t : tx) {
+            uint8_t *d{t.data};
+            t = {};
+            t.data = d;
+        }
+        txlist.num_tx = 0;
+        txlist.num_tx_ok = 0;
+    }
+};
+
+static void check_txlist(const mcd_txlist_st &a, const mcd_txlist_st &b)
+{
+    CHECK(a.num_tx == b.num_tx);
+    CHECK(a.num_tx_ok == b.num_tx_ok);
+    for (uint32_t i{0}; i < a.num_tx && i < b.num_tx; i++) {
+        check_tx(a.tx[i], b.tx[i]);
+    }
+}
+
+/* frame header of a request, return the size of the header */
+static uint32_t check_request_header(const char *buf, uint32_t size,
+                                     uint32_t request_id, uint8_t uid)
+{
+    const char *head{buf};
+    uint32_t length;
+    head += unmarshal_fixed_uint32_t(head, &length);
+    CHECK(length + sizeof(uint32_t) == size);
+    if (request_ids) {
+        uint32_t id;
+        head += unmarshal_fixed_uint32_t(head, &id);
+        CHECK(id == request_id);
+    }
+    uint8_t function;
+    head += unmarshal_uint8_t(head, &function);
+    CHECK(function == uid);
+    return (uint32_t)(head - buf);
+}
+
+static void test_requests()
+{
+    std::vector<char> buf(MCD_MAX_PACKET_LENGTH);
+
+    TxList in;
+    const mcd_execute_txlist_args txlist_args{
+        .core_uid = 128,
+        .txlist = &in.txlist,
+    };
+    uint32_t size{marshal_mcd_execute_txlist_args(&txlist_args, 0x01020304,
+                                                  buf.data(), buf.size())};
+    CHECK(size > 0);
+    CHECK(size <= serialized_size_mcd_execute_txlist_args(&txlist_args, 0));
+    const char *head{buf.data()};
+    head += check_request_header(head, size, 0x01020304,
+                                 UID_MCD_EXECUTE_TXLIST);
+    uint32_t core_uid;
+    head += unmarshal_uint32_t(head, &core_uid);
+    CHECK(core_uid == txlist_args.core_uid);
+    TxList out;
+    out.clear();
+    head += unmarshal_mcd_txlist_st(head, &out.txlist);
+    CHECK(head == buf.data() + size);
+    check_txlist(in.txlist, out.txlist);
+
+    const mcd_qry_reg_map_args reg_map_args{
+        .core_uid = 0,
+        .reg_group_id = 127,
+        .start_index = 128,
+        .num_regs = UINT32_MAX,
+    };
+    size = marshal_mcd_qry_reg_map_args(&reg_map_args, UINT32_MAX, buf.data(),
+                                        buf.size());
+    CHECK(size > 0);
+    CHECK(size <= serialized_size_mcd_qry_reg_map_args(&reg_map_args, 0));
+    head = buf.data();
+    head +=
+        check_request_header(head, size, UINT32_MAX, UID_MCD_QRY_REG_MAP);
+    mcd_qry_reg_map_args reg_map_result{};
+    head += unmarshal_uint32_t(head, &reg_map_result.core_uid);
+    head += unmarshal_uint32_t(head, &reg_map_result.reg_group_id);
+    head += unmarshal_uint32_t(head, &reg_map_result.start_index);
+    head += unmarshal_uint32_t(head, &reg_map_result.num_regs);
+    CHECK(head == buf.data() + size);
+    CHECK(memcmp(&reg_map_args, &reg_map_result, sizeof(reg_map_args)) == 0);
+}
+
+/*
+ * A write transaction with as much data as fits into a packet according to
+ * the bounds which the stub uses to split transaction lists
+ */
+struct FullTx {
+    std::vector<uint8_t> data;
+    mcd_tx_st tx;
+    mcd_txlist_st txlist;
+
+    FullTx()
+        : tx{
+              .addr = {.address = 0x1000,
+                       .mem_space_id = 1,
+                       .addr_space_id = 0,
+                       .addr_space_type = MCD_NOTUSED_ID},
+              .access_type = MCD_TX_AT_W,
+              .options = MCD_TX_OPT_DEFAULT,
+              .access_width = 0,
+              .core_mode = 0,
+              .data = nullptr,
+              .num_bytes = 0,
+              .num_bytes_ok = 0,
+          },
+          txlist{.tx = &tx, .num_tx = 1, .num_tx_ok = 0}
+    {
+        tx.num_bytes = MCD_MAX_PACKET_LENGTH -
+                       marshal_mcd_execute_txlist_bound() -
+                       marshal_mcd_tx_st_bound(&tx);
+        resize(tx.num_bytes);
+    }
+
+    void resize(uint32_t num_bytes)
+    {
+        data.resize(num_bytes);
+        for (uint32_t i{0}; i < num_bytes; i++) {
+            data[i] = (uint8_t)(i * 7);
+        }
+        tx.data = data.data();
+        tx.num_bytes = num_bytes;
+    }
+};
+
+static void test_packet_capacity()
+{
+    std::vector<char> buf(MCD_MAX_PACKET_LENGTH);
+
+    FullTx in;
+    const mcd_execute_txlist_args args{.core_uid = 0, .txlist = &in.txlist};
+    const uint32_t size{marshal_mcd_execute_txlist_args(&args, 1, buf.data(),
+                                                        buf.size())};
+    CHECK(size > 0);
+    CHECK(size <= buf.size());
+    const char *head{buf.data()};
+    head += check_request_header(head, size, 1, UID_MCD_EXECUTE_TXLIST);
+    uint32_t core_uid;
+    head += unmarshal_uint32_t(head, &core_uid);
+    std::vector<uint8_t> data(in.tx.num_bytes);
+    mcd_tx_st tx{};
+    tx.data = data.data();
+    mcd_txlist_st txlist{.tx = &tx, .num_tx = 0, .num_tx_ok = 0};
+    head += unmarshal_mcd_txlist_st(head, &txlist);
+    CHECK(head == buf.data() + size);
+    check_txlist(in.txlist, txlist);
+}
+
+/*
+ * A request which is one byte larger than the buffer is rejected before
+ * anything is written. The buffer is followed by a guard region.
+ */
+static void test_over_capacity()
+{
+    const char CANARY{0x5a};
+    const size_t GUARD{4096};
+    std::vector<char> buf(MCD_MAX_PACKET_LENGTH + GUARD, CANARY);
+
+    FullTx in;
+    const mcd_execute_txlist_args args{.core_uid = 0, .txlist = &in.txlist};
+    in.resize(in.tx.num_bytes + MCD_MAX_PACKET_LENGTH -
+              serialized_size_mcd_execute_txlist_args(&args, 1));
+    CHECK(serialized_size_mcd_execute_txlist_args(&args, 1) ==
+          MCD_MAX_PACKET_LENGTH);
+    uint32_t size{marshal_mcd_execute_txlist_args(&args, 1, buf.data(),
+                                                  MCD_MAX_PACKET_LENGTH)};
+    CHECK(size > 0);
+    CHECK(size <= MCD_MAX_PACKET_LENGTH);
+    CHECK(std::all_of(buf.begin() + MCD_MAX_PACKET_LENGTH, buf.end(),
+                      [&](char c) { return c == CANARY; }));
+
+    std::fill(buf.begin(), buf.end(), CANARY);
+    in.resize(in.tx.num_bytes + 1);
+    CHECK(serialized_size_mcd_execute_txlist_args(&args, 1) ==
+          MCD_MAX_PACKET_LENGTH + 1);
+    size = marshal_mcd_execute_txlist_args(&args, 1, buf.data(),
+                                           MCD_MAX_PACKET_LENGTH);
+    CHECK(size == 0);
+    CHECK(std::all_of(buf.begin(), buf.end(),
+                      [&](char c) { return c == CANARY; }));
+}
+
+/* frame a result the way the server does, return the size of the frame */
+template <typename F>
+static uint32_t frame_result(char *buf, uint32_t request_id, F marshal)
+{
+    char *marsh{buf + sizeof(uint32_t)};
+    char *tail{marsh};
+    if (request_ids) {
+        tail += marshal_fixed_uint32_t(request_id, tail);
+    }
+    tail += marshal(tail);
+    marshal_fixed_uint32_t((uint32_t)(tail - marsh), buf);
+    return (uint32_t)(tail - buf);
+}
+
+static void set_frame_length(char *buf, uint32_t length)
+{
+    marshal_fixed_uint32_t(length, buf);
+}
+
+static void test_results()
+{
+    /* zeroed, so that reading past a truncated frame is deterministic */
+    std::vector<char> buf(MCD_MAX_PACKET_LENGTH);
+
+    TxList in;
+    uint32_t size{frame_result(buf.data(), 7, [&](char *tail) {
+        char *start{tail};
+        tail += marshal_mcd_return_et(MCD_RET_ACT_NONE, tail);
+        tail += marshal_uint8_t(1, tail);
+        tail += marshal_mcd_txlist_st(&in.txlist, tail);
+        return (uint32_t)(tail - start);
+    })};
+    TxList out;
+    out.clear();
+    mcd_execute_txlist_result txlist_result{
+        .return_status = MCD_RET_ACT_HANDLE_ERROR,
+        .txlist = &out.txlist,
+    };
+    mcd_error_info_st error{};
+    CHECK(unmarshal_mcd_execute_txlist_result(buf.data(), &txlist_result,
+                                              &error) == MCD_RET_ACT_NONE);
+    CHECK(txlist_result.return_status == MCD_RET_ACT_NONE);
+    check_txlist(in.txlist, out.txlist);
+
+    /*
+     * A frame which ends before its last field: the result is read past the
+     * frame length, which has to be reported instead of being accepted.
+     */
+    char counter[16];
+    const uint32_t last_field{
+        (uint32_t)marshal_uint32_t(in.txlist.num_tx_ok, counter)};
+    set_frame_length(buf.data(),
+                     size - (uint32_t)sizeof(uint32_t) - last_field);
+    memset(buf.data() + size - last_field, 0, last_field);
+    out.clear();
+    error = {};
+    CHECK(unmarshal_mcd_execute_txlist_result(buf.data(), &txlist_result,
+                                              &error) ==
+          MCD_RET_ACT_HANDLE_ERROR);
+    CHECK(error.error_code == MCD_ERR_CONNECTION);
+
+    /* a frame length beyond the result */
+    set_frame_length(buf.data(), size);
+    error = {};
+    CHECK(unmarshal_mcd_execute_txlist_result(buf.data(), &txlist_result,
+                                              &error) ==
+          MCD_RET_ACT_HANDLE_ERROR);
+
+    const mcd_error_info_st info_in{
+        .return_status = MCD_RET_ACT_HANDLE_ERROR,
+        .error_code = MCD_ERR_TXLIST_TX,
+        .error_events = MCD_ERR_EVT_PWRDN,
+        .error_str = "transaction failed",
+    };
+    std::fill(buf.begin(), buf.end(), 0);
+    size = frame_result(buf.data(), 8, [&](char *tail) {
+        char *start{tail};
+        tail += marshal_mcd_return_et(info_in.return_status, tail);
+        tail += marshal_mcd_error_code_et(info_in.error_code, tail);
+        tail += marshal_mcd_error_event_et(info_in.error_events, tail);
+        tail += marshal_uint32_t(MCD_INFO_STR_LEN, tail);
+        tail += marshal_array(info_in.error_str, MCD_INFO_STR_LEN, tail);
+        return (uint32_t)(tail - start);
+    });
+    mcd_error_info_st info_out{};
+    mcd_qry_error_info_result info_result{.error_info = &info_out};
+    CHECK(unmarshal_mcd_qry_error_info_result(buf.data(), &info_result,
+                                              &error) == MCD_RET_ACT_NONE);
+    CHECK(memcmp(&info_in, &info_out, sizeof(info_in)) == 0);
+
+    set_frame_length(buf.data(), size - (uint32_t)sizeof(uint32_t) - 1);
+    CHECK(unmarshal_mcd_qry_error_info_result(buf.data(), &info_result,
+                                              &error) ==
+          MCD_RET_ACT_HANDLE_ERROR);
+}
+
+int main()
+{
+    for (bool compact : {false, true}) {
+        for (bool ids : {false, true}) {
+            select_compact_encoding(compact);
+            request_ids = ids;
+            test_primitives();
+            test_arrays();
+            test_structs();
+            test_wire_layouts();
+            test_requests();
+            test_packet_capacity();
+            test_over_capacity();
+            test_results();
+        }
+    }
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("all checks passed\n");
+    return EXIT_SUCCESS;
+}
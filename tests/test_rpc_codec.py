@@ -0,0 +1,14 @@
+import pytest
+import os
+import subprocess
+
+RELATIVE_PATH_TO_CODEC_TEST = '../build/rpc_codec_test'
+
+# The RPC codec is tested without a server, see tests/test_rpc_codec.cpp
+pytestmark = pytest.mark.skipif(not os.path.exists(os.path.join(os.path.dirname(__file__), RELATIVE_PATH_TO_CODEC_TEST)),
+                                reason="RPC codec test not built")
+
+def test_rpc_codec():
+    path_to_codec_test = os.path.join(os.path.dirname(__file__), RELATIVE_PATH_TO_CODEC_TEST)
+    result = subprocess.run([path_to_codec_test], capture_output=True, text=True)
+    assert(result.returncode == 0), result.stderr
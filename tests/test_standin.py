@@ -0,0 +1,520 @@
+from mcd_api import *
+import pytest
+import os
+import re
+import logging
+import subprocess
+import tempfile
+import threading
+import time
+
+LOGGER = logging.getLogger("mcd")
+
+ACTIVE_CORE_ID = 0
+NUM_CORES = 2
+# the RAM of the stand-in server, its memory space continues unmapped
+RAM_SIZE = (16 << 20) - 512
+RELATIVE_PATH_TO_STANDIN = '../build/standin_server'
+
+# The stand-in server simulates a core without QEMU, see tools/standin_server.cpp
+pytestmark = pytest.mark.skipif(not os.path.exists(os.path.join(os.path.dirname(__file__), RELATIVE_PATH_TO_STANDIN)),
+                                reason="stand-in server not built")
+
+@pytest.fixture(scope="module")
+def socket_path(request):
+    return os.path.join(tempfile.mkdtemp(), "mcd.sock")
+
+@pytest.fixture(scope="module")
+def spawned_target(request, socket_path):
+    path_to_standin = os.path.join(os.path.dirname(__file__), RELATIVE_PATH_TO_STANDIN)
+    LOGGER.info("Spawning stand-in server")
+    standin_process = subprocess.Popen([path_to_standin, "--unix", socket_path, "--cores", str(NUM_CORES)], stdout=subprocess.PIPE)
+    assert(standin_process.stdout.readline().decode().strip() == "ready")
+    def close_standin():
+        LOGGER.info("Closing stand-in server")
+        standin_process.terminate()
+        standin_process.wait()
+    request.addfinalizer(close_standin)
+
+# every test runs with the socket and with the shared memory transport, with
+# the memory data encoded as string, and with the binary wire formats
+@pytest.fixture(scope="module", params=["transport=socket", "transport=shm",
+                                        "transport=shm data=hex", "transport=socket data=base64",
+                                        "transport=socket format=cbor", "transport=shm format=msgpack data=hex",
+                                        "transport=socket cache=16 cache_fill=1", "transport=shm write_buffer=4096",
+                                        "transport=socket window=4"])
+def connected_server(request, spawned_target, api_compatible, socket_path):
+    server_p = pointer(mcd_server_st())
+    config_string = f"unix:{socket_path} {request.param}"
+    LOGGER.info(f"Opening server ({config_string})")
+    ret = mcd_open_server_f(b"", config_string.encode(), byref(server_p))
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    def close_server():
+        LOGGER.info("Closing server")
+        mcd_close_server_f(server_p)
+    request.addfinalizer(close_server)
+    return server_p
+
+@pytest.fixture(scope="module")
+def open_core(request, open_core_with_id):
+    return open_core_with_id(request, ACTIVE_CORE_ID)
+
+@pytest.fixture(scope="module")
+def physical_memspace(request, queried_memory_spaces):
+    physical_memspaces = [m for m in queried_memory_spaces[0] if m.mem_type & mcd_mem_type_et.MCD_MEM_SPACE_IS_PHYSICAL]
+    assert(len(physical_memspaces) == 1)
+    return physical_memspaces[0]
+
+@pytest.fixture(scope="module")
+def read_pc(request, open_core, queried_registers):
+    pc_addr_candidates = [r.addr for r in queried_registers[0] if r.regname.decode() == "pc"]
+    assert(len(pc_addr_candidates) == 1)
+    pc_addr = pc_addr_candidates[0]
+    def _method():
+        data = (c_uint8*8)()
+        tx = mcd_tx_st(pc_addr, mcd_tx_access_type_et.MCD_TX_AT_R, 0, 0, 0, data, 8, 0)
+        txlist = mcd_txlist_st(pointer(tx), 1, 0)
+        ret = mcd_execute_txlist_f(open_core, byref(txlist))
+        assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+        return int.from_bytes(list(data), byteorder='little')
+    return _method
+
+def test_open_core(open_core):
+    assert(open_core is not None)
+
+def test_query_registers(queried_registers):
+    reg_p, num_regs = queried_registers
+    assert(num_regs == 33)
+    assert(reg_p[num_regs - 1].regname.decode() == "pc")
+
+def test_step(open_core, read_pc):
+    pc = read_pc()
+    ret = mcd_step_f(open_core, False, mcd_core_step_type_et.MCD_CORE_STEP_TYPE_INSTR, 1)
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    assert(read_pc() == pc + 4)
+
+def test_memory_write_read(open_core, physical_memspace):
+    size = 100000
+    written = (c_uint8*size)(*[(i * 7) & 0xff for i in range(size)])
+    tx = mcd_tx_st(mcd_addr_st(0x1000, physical_memspace.mem_space_id, 0, 0),
+                   mcd_tx_access_type_et.MCD_TX_AT_W, 0, 4, 0, written, size, 0)
+    txlist = mcd_txlist_st(pointer(tx), 1, 0)
+    ret = mcd_execute_txlist_f(open_core, byref(txlist))
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+
+    read = (c_uint8*size)()
+    tx = mcd_tx_st(mcd_addr_st(0x1000, physical_memspace.mem_space_id, 0, 0),
+                   mcd_tx_access_type_et.MCD_TX_AT_R, 0, 4, 0, read, size, 0)
+    txlist = mcd_txlist_st(pointer(tx), 1, 0)
+    ret = mcd_execute_txlist_f(open_core, byref(txlist))
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    assert(tx.num_bytes_ok == size)
+    assert(list(read) == list(written))
+
+def test_step_while_running(open_core):
+    ret = mcd_run_f(open_core, False)
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    ret = mcd_step_f(open_core, False, mcd_core_step_type_et.MCD_CORE_STEP_TYPE_INSTR, 1)
+    assert(ret != mcd_return_et.MCD_RET_ACT_NONE)
+    ret = mcd_stop_f(open_core, False)
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+
+def test_register_cache(open_core, read_pc, queried_registers):
+    state = mcd_core_state_st()
+    ret = mcd_qry_state_f(open_core, byref(state))
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    assert(state.state == mcd_core_state_et.MCD_CORE_STATE_DEBUG)
+    pc = read_pc()
+    assert(read_pc() == pc)
+
+    # reads following a write in the same list see the written value
+    pc_addr = [r.addr for r in queried_registers[0] if r.regname.decode() == "pc"][0]
+    data = [(c_uint8*8)(), (c_uint8*8)(*(pc + 8).to_bytes(8, byteorder='little')), (c_uint8*8)()]
+    access = [mcd_tx_access_type_et.MCD_TX_AT_R, mcd_tx_access_type_et.MCD_TX_AT_W, mcd_tx_access_type_et.MCD_TX_AT_R]
+    tx = (mcd_tx_st*3)(*[mcd_tx_st(pc_addr, a, 0, 0, 0, d, 8, 0) for a, d in zip(access, data)])
+    txlist = mcd_txlist_st(tx, 3, 0)
+    ret = mcd_execute_txlist_f(open_core, byref(txlist))
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    assert(txlist.num_tx_ok == 3)
+    assert(int.from_bytes(list(data[0]), byteorder='little') == pc)
+    assert(int.from_bytes(list(data[2]), byteorder='little') == pc + 8)
+    assert(read_pc() == pc + 8)
+
+    # stepping invalidates the cached values
+    ret = mcd_step_f(open_core, False, mcd_core_step_type_et.MCD_CORE_STEP_TYPE_INSTR, 1)
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    assert(read_pc() == pc + 12)
+    ret = mcd_qry_state_f(open_core, byref(state))
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    assert(read_pc() == pc + 12)
+    assert(read_pc() == pc + 12)
+
+def test_memory_cache(open_core, physical_memspace):
+    def cache_stats():
+        result = create_string_buffer(256)
+        ret = mcd_execute_command_f(open_core, b"cache-stats", len(result), result)
+        assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+        memory = result.value.decode().splitlines()[1]
+        hits, misses, pages = re.match(r"memory: (\d+) hits, (\d+) misses, (\d+)/(\d+) pages", memory).groups()[:3]
+        return int(hits), int(misses), int(pages)
+
+    def access(access_type, addr, data):
+        tx = mcd_tx_st(mcd_addr_st(addr, physical_memspace.mem_space_id, 0, 0),
+                       access_type, 0, 4, 0, data, len(data), 0)
+        txlist = mcd_txlist_st(pointer(tx), 1, 0)
+        ret = mcd_execute_txlist_f(open_core, byref(txlist))
+        assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+        assert(tx.num_bytes_ok == len(data))
+        return list(data)
+
+    state = mcd_core_state_st()
+    ret = mcd_qry_state_f(open_core, byref(state))
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    hits, misses, _ = cache_stats()
+
+    written = (c_uint8*64)(*range(64))
+    access(mcd_tx_access_type_et.MCD_TX_AT_W, 0x2010, written)
+    assert(access(mcd_tx_access_type_et.MCD_TX_AT_R, 0x2010, (c_uint8*64)()) == list(written))
+    assert(access(mcd_tx_access_type_et.MCD_TX_AT_R, 0x2020, (c_uint8*16)()) == list(written)[16:32])
+
+    # a partial overwrite of a cached page is read back from the server
+    access(mcd_tx_access_type_et.MCD_TX_AT_W, 0x2018, (c_uint8*4)(0xaa, 0xbb, 0xcc, 0xdd))
+    expected = list(written)
+    expected[8:12] = [0xaa, 0xbb, 0xcc, 0xdd]
+    assert(access(mcd_tx_access_type_et.MCD_TX_AT_R, 0x2010, (c_uint8*64)()) == expected)
+    assert(access(mcd_tx_access_type_et.MCD_TX_AT_R, 0x2010, (c_uint8*64)()) == expected)
+
+    new_hits, new_misses, pages = cache_stats()
+    if pages > 0:
+        assert(new_hits - hits == 2)
+        assert(new_misses - misses == 2)
+    else:
+        assert(new_hits == hits)
+
+    # stepping invalidates the cached pages
+    ret = mcd_step_f(open_core, False, mcd_core_step_type_et.MCD_CORE_STEP_TYPE_INSTR, 1)
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    assert(access(mcd_tx_access_type_et.MCD_TX_AT_R, 0x2010, (c_uint8*64)()) == expected)
+    assert(cache_stats()[0] == new_hits)
+
+def test_memory_read_ahead(open_core, physical_memspace):
+    def cache_stats():
+        result = create_string_buffer(256)
+        ret = mcd_execute_command_f(open_core, b"cache-stats", len(result), result)
+        assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+        memory = result.value.decode().splitlines()[1]
+        match = re.match(r"memory: (\d+) hits, (\d+) misses, (\d+)/(\d+) pages, read ahead (\d+) pages", memory)
+        return [int(g) for g in match.groups()]
+
+    def access(access_type, addr, data):
+        tx = mcd_tx_st(mcd_addr_st(addr, physical_memspace.mem_space_id, 0, 0),
+                       access_type, 0, 4, 0, data, len(data), 0)
+        txlist = mcd_txlist_st(pointer(tx), 1, 0)
+        ret = mcd_execute_txlist_f(open_core, byref(txlist))
+        assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+        assert(tx.num_bytes_ok == len(data))
+        return list(data)
+
+    size = 16 * 1024
+    base = 0x10000
+    written = [(i * 13) & 0xff for i in range(size)]
+    access(mcd_tx_access_type_et.MCD_TX_AT_W, base, (c_uint8*size)(*written))
+    state = mcd_core_state_st()
+    ret = mcd_qry_state_f(open_core, byref(state))
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    _, misses, _, capacity, _ = cache_stats()
+
+    # memory which has been read ahead is still written through
+    for offset in range(0, size, 256):
+        if offset == size // 2:
+            access(mcd_tx_access_type_et.MCD_TX_AT_W, base + offset + 1024, (c_uint8*4)(1, 2, 3, 4))
+            written[offset + 1024:offset + 1028] = [1, 2, 3, 4]
+        chunk = access(mcd_tx_access_type_et.MCD_TX_AT_R, base + offset, (c_uint8*256)())
+        assert(chunk == written[offset:offset + 256])
+
+    _, new_misses, _, _, read_ahead = cache_stats()
+    if capacity > 0:
+        assert(read_ahead > 0)
+        assert(new_misses - misses < size // 1024)
+
+    # stepping drops the pages read ahead
+    ret = mcd_step_f(open_core, False, mcd_core_step_type_et.MCD_CORE_STEP_TYPE_INSTR, 1)
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    access(mcd_tx_access_type_et.MCD_TX_AT_W, base, (c_uint8*4)(5, 6, 7, 8))
+    assert(access(mcd_tx_access_type_et.MCD_TX_AT_R, base, (c_uint8*4)()) == [5, 6, 7, 8])
+
+def test_memory_cache_end_of_ram(open_core, physical_memspace):
+    def read(addr, num_bytes):
+        data = (c_uint8*num_bytes)()
+        tx = mcd_tx_st(mcd_addr_st(addr, physical_memspace.mem_space_id, 0, 0),
+                       mcd_tx_access_type_et.MCD_TX_AT_R, 0, 4, 0, data, num_bytes, 0)
+        txlist = mcd_txlist_st(pointer(tx), 1, 0)
+        ret = mcd_execute_txlist_f(open_core, byref(txlist))
+        return ret, tx.num_bytes_ok, list(data)
+
+    # the page of the last bytes of RAM reaches into the unmapped memory
+    assert(physical_memspace.max_addr + 1 > RAM_SIZE)
+    assert(RAM_SIZE % 1024 != 0)
+    written = (c_uint8*8)(*range(1, 9))
+    tx = mcd_tx_st(mcd_addr_st(RAM_SIZE - 8, physical_memspace.mem_space_id, 0, 0),
+                   mcd_tx_access_type_et.MCD_TX_AT_W, 0, 4, 0, written, 8, 0)
+    txlist = mcd_txlist_st(pointer(tx), 1, 0)
+    ret = mcd_execute_txlist_f(open_core, byref(txlist))
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+
+    state = mcd_core_state_st()
+    ret = mcd_qry_state_f(open_core, byref(state))
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+
+    for _ in range(2):
+        assert(read(RAM_SIZE - 8, 8) == (mcd_return_et.MCD_RET_ACT_NONE, 8, list(written)))
+    ret, num_bytes_ok, _ = read(RAM_SIZE, 8)
+    assert(ret != mcd_return_et.MCD_RET_ACT_NONE)
+    assert(num_bytes_ok == 0)
+
+def test_memory_read_ahead_end_of_ram(open_core, physical_memspace):
+    def access(access_type, addr, data):
+        tx = mcd_tx_st(mcd_addr_st(addr, physical_memspace.mem_space_id, 0, 0),
+                       access_type, 0, 4, 0, data, len(data), 0)
+        txlist = mcd_txlist_st(pointer(tx), 1, 0)
+        ret = mcd_execute_txlist_f(open_core, byref(txlist))
+        assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+        assert(tx.num_bytes_ok == len(data))
+        return list(data)
+
+    # sequential reads up to the end of RAM, the read ahead runs into unmapped memory
+    ret = mcd_step_f(open_core, False, mcd_core_step_type_et.MCD_CORE_STEP_TYPE_INSTR, 1)
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    size = 8 * 1024
+    base = RAM_SIZE - size
+    written = [(i * 7) & 0xff for i in range(size)]
+    access(mcd_tx_access_type_et.MCD_TX_AT_W, base, (c_uint8*size)(*written))
+    state = mcd_core_state_st()
+    ret = mcd_qry_state_f(open_core, byref(state))
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+
+    for _ in range(2):
+        for offset in range(0, size, 256):
+            chunk = access(mcd_tx_access_type_et.MCD_TX_AT_R, base + offset, (c_uint8*256)())
+            assert(chunk == written[offset:offset + 256])
+
+def test_read_coalescing(open_core, physical_memspace):
+    written = (c_uint8*256)(*[(i * 5 + 3) & 0xff for i in range(256)])
+    tx = mcd_tx_st(mcd_addr_st(0x3000, physical_memspace.mem_space_id, 0, 0),
+                   mcd_tx_access_type_et.MCD_TX_AT_W, 0, 1, 0, written, 256, 0)
+    txlist = mcd_txlist_st(pointer(tx), 1, 0)
+    ret = mcd_execute_txlist_f(open_core, byref(txlist))
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+
+    # adjacent, overlapping and nearby reads, one with side effects and one
+    # with a different access width in between
+    reads = [(0x3000, 8, 0, 1), (0x3008, 4, 0, 1), (0x3010, 16, 0, 1), (0x300c, 8, 0, 1),
+             (0x3020, 8, mcd_tx_access_opt_et.MCD_TX_OPT_SIDE_EFFECTS, 1),
+             (0x3028, 8, 0, 1), (0x3030, 8, 0, 4), (0x3038, 8, 0, 4)]
+    data = [(c_uint8*n)() for _, n, _, _ in reads]
+    tx = (mcd_tx_st*len(reads))(*[
+        mcd_tx_st(mcd_addr_st(addr, physical_memspace.mem_space_id, 0, 0),
+                  mcd_tx_access_type_et.MCD_TX_AT_R, options, width, 0, d, n, 0)
+        for (addr, n, options, width), d in zip(reads, data)])
+    txlist = mcd_txlist_st(tx, len(reads), 0)
+    ret = mcd_execute_txlist_f(open_core, byref(txlist))
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    assert(txlist.num_tx_ok == len(reads))
+    for i, (addr, n, _, _) in enumerate(reads):
+        assert(tx[i].num_bytes_ok == n)
+        assert(list(data[i]) == list(written)[addr - 0x3000:addr - 0x3000 + n])
+
+    # if the merged read fails, the reads are retried one by one, so those
+    # before the failing one still succeed
+    assert(physical_memspace.max_addr + 1 > RAM_SIZE)
+    reads = [RAM_SIZE - 16, RAM_SIZE - 8, RAM_SIZE]
+    data = [(c_uint8*8)() for _ in reads]
+    tx = (mcd_tx_st*len(reads))(*[
+        mcd_tx_st(mcd_addr_st(addr, physical_memspace.mem_space_id, 0, 0),
+                  mcd_tx_access_type_et.MCD_TX_AT_R, 0, 1, 0, d, 8, 0)
+        for addr, d in zip(reads, data)])
+    txlist = mcd_txlist_st(tx, len(reads), 0)
+    ret = mcd_execute_txlist_f(open_core, byref(txlist))
+    assert(ret != mcd_return_et.MCD_RET_ACT_NONE)
+    assert(txlist.num_tx_ok == 2)
+    assert([t.num_bytes_ok for t in tx] == [8, 8, 0])
+
+def test_failed_write_stops_list(request, open_core, physical_memspace):
+    deferred = "write_buffer" in request.node.callspec.params["connected_server"]
+
+    def execute(tx):
+        txlist = mcd_txlist_st(tx, len(tx), 0)
+        ret = mcd_execute_txlist_f(open_core, byref(txlist))
+        return ret, txlist.num_tx_ok
+
+    # the second write spans several packets, which are not pipelined after the failing one
+    size = 3 * 65536
+    base = 0x40000
+    W = mcd_tx_access_type_et.MCD_TX_AT_W
+    old = (c_uint8*size)(*[(i * 5) & 0xff for i in range(size)])
+    new = (c_uint8*size)(*[0xa5] * size)
+    assert(execute((mcd_tx_st*1)(mcd_tx_st(mcd_addr_st(base, physical_memspace.mem_space_id, 0, 0),
+                                           W, 0, 1, 0, old, size, 0))) == (mcd_return_et.MCD_RET_ACT_NONE, 1))
+
+    data = (c_uint8*8)()
+    ret, num_tx_ok = execute((mcd_tx_st*2)(
+        mcd_tx_st(mcd_addr_st(RAM_SIZE, physical_memspace.mem_space_id, 0, 0), W, 0, 1, 0, data, 8, 0),
+        mcd_tx_st(mcd_addr_st(base, physical_memspace.mem_space_id, 0, 0), W, 0, 1, 0, new, size, 0)))
+    assert(ret != mcd_return_et.MCD_RET_ACT_NONE)
+    # a deferred write is counted before it fails
+    assert(num_tx_ok == (1 if deferred else 0))
+
+    result = (c_uint8*size)()
+    assert(execute((mcd_tx_st*1)(mcd_tx_st(mcd_addr_st(base, physical_memspace.mem_space_id, 0, 0),
+                                           mcd_tx_access_type_et.MCD_TX_AT_R, 0, 1, 0, result, size, 0))) ==
+           (mcd_return_et.MCD_RET_ACT_NONE, 1))
+    assert(bytes(result) == bytes(old))
+
+def test_write_buffer(request, open_core, physical_memspace):
+    enabled = "write_buffer" in request.node.callspec.params["connected_server"]
+
+    def write_stats():
+        result = create_string_buffer(256)
+        ret = mcd_execute_command_f(open_core, b"cache-stats", len(result), result)
+        assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+        writes = result.value.decode().splitlines()[2]
+        match = re.match(r"writes: (\d+) deferred, (\d+) combined, (\d+) flushes", writes)
+        return [int(g) for g in match.groups()]
+
+    def execute(tx):
+        txlist = mcd_txlist_st(tx, len(tx), 0)
+        ret = mcd_execute_txlist_f(open_core, byref(txlist))
+        assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+        assert(txlist.num_tx_ok == len(tx))
+        for t in tx:
+            assert(t.num_bytes_ok == t.num_bytes)
+
+    def access(access_type, addr, data, options=0):
+        tx = (mcd_tx_st*1)(mcd_tx_st(mcd_addr_st(addr, physical_memspace.mem_space_id, 0, 0),
+                                     access_type, options, 1, 0, data, len(data), 0))
+        execute(tx)
+        return list(data)
+
+    W = mcd_tx_access_type_et.MCD_TX_AT_W
+    R = mcd_tx_access_type_et.MCD_TX_AT_R
+    deferred, combined, flushes = write_stats()
+
+    # small adjacent writes and an overwrite are combined into one write
+    expected = []
+    for i in range(16):
+        expected += [i, i, i, i]
+        access(W, 0x4000 + 4 * i, (c_uint8*4)(i, i, i, i))
+    access(W, 0x4008, (c_uint8*2)(0xee, 0xff))
+    expected[8:10] = [0xee, 0xff]
+    assert(access(R, 0x4000, (c_uint8*64)()) == expected)
+    if enabled:
+        assert(write_stats() == [deferred + 17, combined + 16, flushes + 1])
+
+    # reads of other ranges do not flush, the core executing does
+    access(W, 0x4100, (c_uint8*4)(1, 2, 3, 4))
+    assert(access(R, 0x4000, (c_uint8*64)()) == expected)
+    ret = mcd_step_f(open_core, False, mcd_core_step_type_et.MCD_CORE_STEP_TYPE_INSTR, 1)
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    if enabled:
+        assert(write_stats()[2] == flushes + 2)
+    assert(access(R, 0x4100, (c_uint8*4)()) == [1, 2, 3, 4])
+
+    # writes with side effects and atomic chains are sent at once
+    deferred = write_stats()[0]
+    access(W, 0x4200, (c_uint8*4)(5, 6, 7, 8), mcd_tx_access_opt_et.MCD_TX_OPT_SIDE_EFFECTS)
+    data = [(c_uint8*4)(9, 10, 11, 12), (c_uint8*4)(13, 14, 15, 16)]
+    execute((mcd_tx_st*2)(
+        mcd_tx_st(mcd_addr_st(0x4204, physical_memspace.mem_space_id, 0, 0), W,
+                  mcd_tx_access_opt_et.MCD_TX_OPT_ATOMIC_WITH_NEXT, 1, 0, data[0], 4, 0),
+        mcd_tx_st(mcd_addr_st(0x4208, physical_memspace.mem_space_id, 0, 0), W, 0, 1, 0, data[1], 4, 0)))
+    assert(write_stats()[0] == deferred)
+    assert(access(R, 0x4200, (c_uint8*12)()) == list(range(5, 17)))
+
+    # explicit flush
+    access(W, 0x4300, (c_uint8*4)(1, 1, 1, 1))
+    result = create_string_buffer(16)
+    ret = mcd_execute_command_f(open_core, b"flush-writes", len(result), result)
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+    if enabled:
+        assert(write_stats()[0:3:2] == [deferred + 1, flushes + 3])
+
+    # a deferred write to unmapped memory fails when it is sent
+    assert(physical_memspace.max_addr + 1 > RAM_SIZE)
+    data = (c_uint8*4)(1, 2, 3, 4)
+    txlist = mcd_txlist_st((mcd_tx_st*1)(mcd_tx_st(mcd_addr_st(RAM_SIZE, physical_memspace.mem_space_id, 0, 0),
+                                                   W, 0, 1, 0, data, 4, 0)), 1, 0)
+    ret = mcd_execute_txlist_f(open_core, byref(txlist))
+    if enabled:
+        assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+        assert(txlist.num_tx_ok == 1)
+        ret = mcd_execute_command_f(open_core, b"flush-writes", len(result), result)
+    assert(ret != mcd_return_et.MCD_RET_ACT_NONE)
+    error = mcd_error_info_st()
+    mcd_qry_error_info_f(open_core, byref(error))
+    assert(error.return_status == ret)
+    if enabled:
+        assert(f"deferred write of 4 bytes at {RAM_SIZE:#x}" in error.error_str.decode())
+    ret = mcd_execute_command_f(open_core, b"flush-writes", len(result), result)
+    assert(ret == mcd_return_et.MCD_RET_ACT_NONE)
+
+def test_parallel_cores(request, open_core_with_id, queried_registers, physical_memspace):
+    cores = [open_core_with_id(request, i) for i in range(NUM_CORES)]
+    reg = queried_registers[0][1]
+    failures = []
+
+    def access(core, seed):
+        for i in range(200):
+            value = (seed << 32) | i
+            data = (c_uint8*8)(*value.to_bytes(8, byteorder='little'))
+            tx = mcd_tx_st(reg.addr, mcd_tx_access_type_et.MCD_TX_AT_W, 0, 0, 0, data, 8, 0)
+            txlist = mcd_txlist_st(pointer(tx), 1, 0)
+            if mcd_execute_txlist_f(core, byref(txlist)) != mcd_return_et.MCD_RET_ACT_NONE:
+                failures.append(f"core {seed}: write failed")
+                return
+            data = (c_uint8*8)()
+            tx = mcd_tx_st(reg.addr, mcd_tx_access_type_et.MCD_TX_AT_R, 0, 0, 0, data, 8, 0)
+            txlist = mcd_txlist_st(pointer(tx), 1, 0)
+            if mcd_execute_txlist_f(core, byref(txlist)) != mcd_return_et.MCD_RET_ACT_NONE:
+                failures.append(f"core {seed}: read failed")
+                return
+            if int.from_bytes(list(data), byteorder='little') != value:
+                failures.append(f"core {seed}: read back wrong value")
+                return
+            # the error state of one thread must not leak into the others
+            error_info = mcd_error_info_st()
+            mcd_qry_error_info_f(core, byref(error_info))
+            if error_info.return_status != mcd_return_et.MCD_RET_ACT_NONE:
+                failures.append(f"core {seed}: unexpected error {error_info.error_str.decode()}")
+                return
+
+    def fail(core):
+        for i in range(200):
+            ret = mcd_step_f(None, False, mcd_core_step_type_et.MCD_CORE_STEP_TYPE_INSTR, 1)
+            error_info = mcd_error_info_st()
+            mcd_qry_error_info_f(core, byref(error_info))
+            if ret == mcd_return_et.MCD_RET_ACT_NONE or error_info.error_code != mcd_error_code_et.MCD_ERR_PARAM:
+                failures.append("failing thread: error not reported")
+                return
+
+    # the error details fetched from the server belong to the failing thread
+    def fail_on_server(core):
+        for i in range(200):
+            data = (c_uint8*4)()
+            tx = mcd_tx_st(mcd_addr_st(physical_memspace.max_addr + 1, physical_memspace.mem_space_id, 0, 0),
+                           mcd_tx_access_type_et.MCD_TX_AT_R, 0, 4, 0, data, 4, 0)
+            txlist = mcd_txlist_st(pointer(tx), 1, 0)
+            ret = mcd_execute_txlist_f(core, byref(txlist))
+            error_info = mcd_error_info_st()
+            mcd_qry_error_info_f(core, byref(error_info))
+            if ret == mcd_return_et.MCD_RET_ACT_NONE or error_info.error_code != mcd_error_code_et.MCD_ERR_TXLIST_TX:
+                failures.append("failing server call: error not reported")
+                return
+
+    threads = [threading.Thread(target=access, args=(core, i)) for i, core in enumerate(cores)]
+    threads.append(threading.Thread(target=fail, args=(cores[0],)))
+    threads.append(threading.Thread(target=fail_on_server, args=(cores[1],)))
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    assert(failures == [])
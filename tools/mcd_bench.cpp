@@ -0,0 +1,184 @@
+/*
+MIT License
+
+Copyright (c) 2025 Lauterbach GmbH
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Round trip benchmark
+ *
+ * Measures the latency of typical debugger requests on the first core of a
+ * MCD server, e.g. the stand-in server.
+ *
+ * Usage: mcd_bench <config_string> [<iterations>]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+#include "mcd_api.h"
+
+static mcd_core_st *core{nullptr};
+
+static bool check(mcd_return_et ret, const char *what)
+{
+    if (ret == MCD_RET_ACT_NONE) {
+        return true;
+    }
+    mcd_error_info_st error{};
+    mcd_qry_error_info_f(core, &error);
+    fprintf(stderr, "%s failed: %s\n", what, error.error_str);
+    return false;
+}
+
+static bool measure(const char *name, int iterations,
+                    const std::function<mcd_return_et()> &request)
+{
+    auto start{std::chrono::steady_clock::now()};
+    for (int i{0}; i < iterations; i++) {
+        if (!check(request(), name)) {
+            return false;
+        }
+    }
+    auto end{std::chrono::steady_clock::now()};
+    printf("%-16s %8.2f us\n", name,
+           std::chrono::duration<double, std::micro>(end - start).count() /
+               iterations);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <config_string> [<iterations>]\n",
+                argv[0]);
+        return 2;
+    }
+    int iterations{argc > 2 ? atoi(argv[2]) : 10000};
+    if (iterations <= 0) {
+        iterations = 1;
+    }
+
+    mcd_api_version_st version{
+        .v_api_major{MCD_API_VER_MAJOR},
+        .v_api_minor{MCD_API_VER_MINOR},
+        .author{MCD_API_VER_AUTHOR},
+    };
+    mcd_impl_version_info_st impl_info;
+    mcd_server_st *server;
+    if (!check(mcd_initialize_f(&version, &impl_info), "initialization") ||
+        !check(mcd_open_server_f("", argv[1], &server), "mcd_open_server_f")) {
+        return 1;
+    }
+
+    uint32_t num{1};
+    mcd_core_con_info_st system, device, core_info;
+    if (!check(mcd_qry_systems_f(0, &num, &system), "mcd_qry_systems_f") ||
+        !check(mcd_qry_devices_f(&system, 0, &num, &device),
+               "mcd_qry_devices_f") ||
+        !check(mcd_qry_cores_f(&device, 0, &num, &core_info),
+               "mcd_qry_cores_f") ||
+        !check(mcd_open_core_f(&core_info, &core), "mcd_open_core_f")) {
+        return 1;
+    }
+
+    uint32_t num_regs{0};
+    if (!check(mcd_qry_reg_map_f(core, 0, 0, &num_regs, nullptr),
+               "mcd_qry_reg_map_f")) {
+        return 1;
+    }
+    std::vector<mcd_register_info_st> regs(num_regs);
+    if (num_regs == 0 ||
+        !check(mcd_qry_reg_map_f(core, 0, 0, &num_regs, regs.data()),
+               "mcd_qry_reg_map_f")) {
+        return 1;
+    }
+
+    uint64_t value;
+    mcd_tx_st tx{
+        .addr{regs[0].addr},
+        .access_type{MCD_TX_AT_R},
+        .options{MCD_TX_OPT_DEFAULT},
+        .access_width{0},
+        .core_mode{0},
+        .data{(uint8_t *)&value},
+        .num_bytes{regs[0].regsize / 8},
+        .num_bytes_ok{0},
+    };
+    mcd_txlist_st txlist{.tx{&tx}, .num_tx{1}, .num_tx_ok{0}};
+    mcd_core_state_st state;
+
+    /* a memory window of a typical debugger view */
+    uint32_t num_mem_spaces{1};
+    mcd_memspace_st mem_space;
+    if (!check(mcd_qry_mem_spaces_f(core, 0, &num_mem_spaces, &mem_space),
+               "mcd_qry_mem_spaces_f")) {
+        return 1;
+    }
+    std::vector<uint8_t> memory(32 * 1024);
+    mcd_tx_st mem_tx{
+        .addr{.address{0},
+              .mem_space_id{mem_space.mem_space_id},
+              .addr_space_id{0},
+              .addr_space_type{MCD_NOTUSED_ID}},
+        .access_type{MCD_TX_AT_R},
+        .options{MCD_TX_OPT_DEFAULT},
+        .access_width{0},
+        .core_mode{0},
+        .data{memory.data()},
+        .num_bytes{(uint32_t)memory.size()},
+        .num_bytes_ok{0},
+    };
+    mcd_txlist_st mem_txlist{.tx{&mem_tx}, .num_tx{1}, .num_tx_ok{0}};
+
+    /* small reads walking through memory, e.g. a scrolled memory view */
+    mcd_tx_st seq_tx{mem_tx};
+    seq_tx.num_bytes = 64;
+    mcd_txlist_st seq_txlist{.tx{&seq_tx}, .num_tx{1}, .num_tx_ok{0}};
+
+    bool ok{measure("qry_state", iterations,
+                    [&] { return mcd_qry_state_f(core, &state); }) &&
+            measure("read_register", iterations,
+                    [&] { return mcd_execute_txlist_f(core, &txlist); }) &&
+            measure("step", iterations,
+                    [&] {
+                        return mcd_step_f(core, FALSE, MCD_CORE_STEP_TYPE_INSTR,
+                                          1);
+                    }) &&
+            measure("read_memory_32k", iterations / 10 + 1,
+                    [&] { return mcd_execute_txlist_f(core, &mem_txlist); }) &&
+            check(mcd_qry_state_f(core, &state), "mcd_qry_state_f") &&
+            measure("read_memory_seq", iterations,
+                    [&] {
+                        seq_tx.addr.address =
+                            (seq_tx.addr.address + seq_tx.num_bytes) %
+                            (1024 * 1024);
+                        return mcd_execute_txlist_f(core, &seq_txlist);
+                    })};
+
+    mcd_close_core_f(core);
+    mcd_close_server_f(server);
+    mcd_exit_f();
+    return ok ? 0 : 1;
+}
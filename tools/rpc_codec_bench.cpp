@@ -0,0 +1,155 @@
+/*
+MIT License
+
+Copyright (c) 2025 Lauterbach GmbH
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * RPC codec benchmark
+ *
+ * Compares the packet size and the marshalling time of common requests with
+ * the fixed and the compact (varint) integer encoding. No server is involved.
+ *
+ * Usage: rpc_codec_bench [<iterations>]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+#include "comm.hpp"
+#include "mcd_rpc.h"
+
+struct Request {
+    const char *name;
+    std::function<uint32_t(char *buf, size_t buf_size)> marshal;
+};
+
+static double measure(const Request &request, int iterations,
+                      std::vector<char> &buf, uint32_t &size)
+{
+    size = request.marshal(buf.data(), buf.size());
+    auto start{std::chrono::steady_clock::now()};
+    for (int i{0}; i < iterations; i++) {
+        request.marshal(buf.data(), buf.size());
+    }
+    auto end{std::chrono::steady_clock::now()};
+    return std::chrono::duration<double, std::nano>(end - start).count() /
+           iterations;
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations{argc > 1 ? atoi(argv[1]) : 1000000};
+    if (iterations <= 0) {
+        iterations = 1;
+    }
+
+    /* a register and a memory block at a kernel address */
+    uint64_t value{0};
+    mcd_tx_st read_register{
+        .addr{.address{0x21}, .mem_space_id{2}, .addr_space_id{0},
+              .addr_space_type{MCD_NOTUSED_ID}},
+        .access_type{MCD_TX_AT_R},
+        .options{MCD_TX_OPT_DEFAULT},
+        .access_width{0},
+        .core_mode{0},
+        .data{(uint8_t *)&value},
+        .num_bytes{sizeof(value)},
+        .num_bytes_ok{0},
+    };
+    uint8_t block[64]{};
+    mcd_tx_st write_memory{
+        .addr{.address{0xffff800000001000}, .mem_space_id{1},
+              .addr_space_id{0}, .addr_space_type{MCD_NOTUSED_ID}},
+        .access_type{MCD_TX_AT_W},
+        .options{MCD_TX_OPT_DEFAULT},
+        .access_width{4},
+        .core_mode{0},
+        .data{block},
+        .num_bytes{sizeof(block)},
+        .num_bytes_ok{0},
+    };
+    mcd_txlist_st read_txlist{.tx{&read_register}, .num_tx{1}, .num_tx_ok{0}};
+    mcd_txlist_st write_txlist{.tx{&write_memory}, .num_tx{1}, .num_tx_ok{0}};
+
+    const uint32_t core_uid{1}, request_id{42};
+    const std::vector<Request> requests{
+        {"qry_state",
+         [&](char *buf, size_t buf_size) {
+             mcd_qry_state_args args{.core_uid{core_uid}};
+             return marshal_mcd_qry_state_args(&args, request_id, buf,
+                                               buf_size);
+         }},
+        {"read_register",
+         [&](char *buf, size_t buf_size) {
+             mcd_execute_txlist_args args{.core_uid{core_uid},
+                                          .txlist{&read_txlist}};
+             return marshal_mcd_execute_txlist_args(&args, request_id, buf,
+                                                    buf_size);
+         }},
+        {"write_memory",
+         [&](char *buf, size_t buf_size) {
+             mcd_execute_txlist_args args{.core_uid{core_uid},
+                                          .txlist{&write_txlist}};
+             return marshal_mcd_execute_txlist_args(&args, request_id, buf,
+                                                    buf_size);
+         }},
+        {"step",
+         [&](char *buf, size_t buf_size) {
+             mcd_step_args args{
+                 .core_uid{core_uid},
+                 .global{false},
+                 .step_type{MCD_CORE_STEP_TYPE_INSTR},
+                 .n_steps{1},
+             };
+             return marshal_mcd_step_args(&args, request_id, buf, buf_size);
+         }},
+        {"qry_reg_map",
+         [&](char *buf, size_t buf_size) {
+             mcd_qry_reg_map_args args{
+                 .core_uid{core_uid},
+                 .reg_group_id{0},
+                 .start_index{0},
+                 .num_regs{100},
+             };
+             return marshal_mcd_qry_reg_map_args(&args, request_id, buf,
+                                                 buf_size);
+         }},
+    };
+
+    std::vector<char> buf(MCD_MAX_PACKET_LENGTH);
+    printf("%-16s %12s %12s %12s %12s\n", "request", "fixed [B]", "varint [B]",
+           "fixed [ns]", "varint [ns]");
+    for (const Request &request : requests) {
+        uint32_t fixed_size, compact_size;
+        select_compact_encoding(false);
+        double fixed_ns{measure(request, iterations, buf, fixed_size)};
+        select_compact_encoding(true);
+        double compact_ns{measure(request, iterations, buf, compact_size)};
+        printf("%-16s %12u %12u %12.1f %12.1f\n", request.name, fixed_size,
+               compact_size, fixed_ns, compact_ns);
+    }
+    select_compact_encoding(false);
+    return 0;
+}
@@ -0,0 +1,834 @@
+/*
+MIT License
+
+Copyright (c) 2025 Lauterbach GmbH
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Stand-in MCD server
+ *
+ * Speaks the QMP flavour of the protocol for a simulated 64-bit core with 32
+ * general purpose registers, a program counter and some RAM. It allows to
+ * test and benchmark the client stub and its transports without a QEMU build
+ * that includes the MCD server.
+ *
+ * The RAM only backs the lower half of its memory space, accesses to the upper
+ * half fail like those to unmapped memory.
+ *
+ * Usage: standin_server (--port <port> | --unix <path>) [--cores <n>]
+ *
+ * Clients are served one after another. A client which starts with a
+ * shared memory handshake (see shm_ring.hpp) exchanges its messages through
+ * the rings, otherwise they are exchanged over the socket. Requests sent as
+ * CBOR or MessagePack frames (see mcd_rpc.h) are answered in the same format.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "json.hpp"
+#include "mcd_api.h"
+#include "mcd_rpc.h"
+#include "shm_ring.hpp"
+
+#define STANDIN_NUM_GPRS 32
+#define STANDIN_NUM_REGS (STANDIN_NUM_GPRS + 1)
+#define STANDIN_PC_INDEX STANDIN_NUM_GPRS
+#define STANDIN_REG_SIZE 8
+/* the RAM ends within a page of the client's memory cache */
+#define STANDIN_RAM_SIZE ((16u << 20) - 512)
+#define STANDIN_RAM_SPACE_SIZE (32u << 20)
+#define STANDIN_RAM_MEMSPACE 1
+#define STANDIN_REG_MEMSPACE 2
+#define STANDIN_REG_GROUP 1
+
+using nlohmann::json;
+
+static const char BASE64_DIGITS[]{
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"};
+
+/*
+ * memory data as array of numbers, as string or as binary value if the client
+ * asked for it
+ */
+static json encode_data(const std::string &encoding, const uint8_t *data,
+                        size_t n)
+{
+    if (encoding == "binary") {
+        return json::binary(std::vector<uint8_t>{data, data + n});
+    } else if (encoding == "hex") {
+        std::string s;
+        for (size_t i{0}; i < n; i++) {
+            s.push_back("0123456789abcdef"[data[i] >> 4]);
+            s.push_back("0123456789abcdef"[data[i] & 0xf]);
+        }
+        return s;
+    } else if (encoding == "base64") {
+        std::string s;
+        for (size_t i{0}; i < n; i += 3) {
+            uint32_t bits{(uint32_t)data[i] << 16};
+            if (i + 1 < n) {
+                bits |= (uint32_t)data[i + 1] << 8;
+            }
+            if (i + 2 < n) {
+                bits |= data[i + 2];
+            }
+            s.push_back(BASE64_DIGITS[bits >> 18]);
+            s.push_back(BASE64_DIGITS[(bits >> 12) & 0x3f]);
+            s.push_back(i + 1 < n ? BASE64_DIGITS[(bits >> 6) & 0x3f] : '=');
+            s.push_back(i + 2 < n ? BASE64_DIGITS[bits & 0x3f] : '=');
+        }
+        return s;
+    }
+    return std::vector<uint8_t>{data, data + n};
+}
+
+static std::vector<uint8_t> decode_data(const std::string &encoding,
+                                        const json &data)
+{
+    if (data.is_binary()) {
+        return data.get_binary();
+    } else if (!data.is_string()) {
+        return data.get<std::vector<uint8_t>>();
+    }
+
+    const std::string &s{data.get_ref<const std::string &>()};
+    std::vector<uint8_t> bytes;
+    if (encoding == "hex") {
+        for (size_t i{0}; i + 1 < s.size(); i += 2) {
+            bytes.push_back((uint8_t)std::stoul(s.substr(i, 2), nullptr, 16));
+        }
+        return bytes;
+    }
+
+    uint32_t bits{0};
+    int num_bits{0};
+    for (char c : s) {
+        const char *digit{strchr(BASE64_DIGITS, c)};
+        if (c == '\0' || !digit) {
+            break;
+        }
+        bits = (bits << 6 | (uint32_t)(digit - BASE64_DIGITS)) & 0xffffff;
+        num_bits += 6;
+        if (num_bits >= 8) {
+            num_bits -= 8;
+            bytes.push_back((uint8_t)(bits >> num_bits));
+        }
+    }
+    return bytes;
+}
+
+/* simulated state of one core */
+struct Core {
+    uint32_t state{MCD_CORE_STATE_DEBUG};
+    std::vector<uint8_t> regs =
+        std::vector<uint8_t>(STANDIN_NUM_REGS * STANDIN_REG_SIZE);
+};
+
+class Target
+{
+    uint32_t num_cores;
+    std::vector<Core> cores;
+    std::vector<uint8_t> ram;
+    /* data encoding accepted in mcd-open-server, "binary" with CBOR/msgpack */
+    std::string data_encoding{"array"};
+    /* events raised by the last command, sent before its reply */
+    std::vector<json> events;
+
+    /* an event like QEMU's STOP and RESUME, for the core of the command */
+    void raise(const char *name, const json &args)
+    {
+        auto now{std::chrono::system_clock::now().time_since_epoch()};
+        auto us{std::chrono::duration_cast<std::chrono::microseconds>(now)};
+        this->events.push_back({
+            {"event", name},
+            {"data", {{"core-uid", args.at("core-uid")}}},
+            {"timestamp",
+             {{"seconds", us.count() / 1000000},
+              {"microseconds", us.count() % 1000000}}},
+        });
+    }
+
+    json con_info(uint32_t core_id) const
+    {
+        return {
+            {"host", "standin"},
+            {"server-port", 0},
+            {"server-key", ""},
+            {"system-key", ""},
+            {"device-key", ""},
+            {"system", "standin"},
+            {"system-instance", ""},
+            {"acc-hw", ""},
+            {"device-type", 0},
+            {"device", "standin"},
+            {"device-id", 0},
+            {"core", "core" + std::to_string(core_id)},
+            {"core-type", 0},
+            {"core-id", core_id},
+        };
+    }
+
+    json mem_spaces() const
+    {
+        return json::array({
+            {
+                {"mem-space-id", STANDIN_RAM_MEMSPACE},
+                {"mem-space-name", "RAM"},
+                {"mem-type", MCD_MEM_SPACE_IS_PHYSICAL},
+                {"bits-per-mau", 8},
+                {"invariance", 1},
+                {"endian", MCD_ENDIAN_LITTLE},
+                {"min-addr", 0},
+                {"max-addr", STANDIN_RAM_SPACE_SIZE - 1},
+                {"num-mem-blocks", 0},
+                {"supported-access-options", 0},
+                {"core-mode-mask-read", 0},
+                {"core-mode-mask-write", 0},
+            },
+            {
+                {"mem-space-id", STANDIN_REG_MEMSPACE},
+                {"mem-space-name", "GPR Registers"},
+                {"mem-type", MCD_MEM_SPACE_IS_REGISTERS},
+                {"bits-per-mau", 8},
+                {"invariance", 1},
+                {"endian", MCD_ENDIAN_LITTLE},
+                {"min-addr", 0},
+                {"max-addr", 0},
+                {"num-mem-blocks", 0},
+                {"supported-access-options", 0},
+                {"core-mode-mask-read", 0},
+                {"core-mode-mask-write", 0},
+            },
+        });
+    }
+
+    json reg_info(uint32_t i) const
+    {
+        return {
+            {"addr",
+             {
+                 {"address", i * STANDIN_REG_SIZE},
+                 {"mem-space-id", STANDIN_REG_MEMSPACE},
+                 {"addr-space-id", 0},
+                 {"addr-space-type", 0},
+             }},
+            {"reg-group-id", STANDIN_REG_GROUP},
+            {"regname",
+             i == STANDIN_PC_INDEX ? "pc" : "x" + std::to_string(i)},
+            {"regsize", STANDIN_REG_SIZE * 8},
+            {"core-mode-mask-read", 0},
+            {"core-mode-mask-write", 0},
+            {"side-effects-read", false},
+            {"side-effects-write", false},
+            {"reg-type", MCD_REG_TYPE_SIMPLE},
+            {"hw-thread-id", 0},
+        };
+    }
+
+    Core *core(const json &args)
+    {
+        uint32_t core_uid{args.at("core-uid").get<uint32_t>()};
+        return core_uid < this->num_cores ? &this->cores[core_uid] : nullptr;
+    }
+
+    /* executes a transaction in place, returns false if it fails */
+    bool execute_tx(Core &c, json &tx)
+    {
+        uint64_t address{tx.at("addr").at("address").get<uint64_t>()};
+        uint32_t mem_space_id{
+            tx.at("addr").at("mem-space-id").get<uint32_t>()};
+        uint32_t num_bytes{tx.at("num-bytes").get<uint32_t>()};
+
+        std::vector<uint8_t> *mem;
+        if (mem_space_id == STANDIN_RAM_MEMSPACE) {
+            mem = &this->ram;
+        } else if (mem_space_id == STANDIN_REG_MEMSPACE) {
+            mem = &c.regs;
+        } else {
+            return false;
+        }
+
+        if (address > mem->size() || num_bytes > mem->size() - address) {
+            return false;
+        }
+
+        if (tx.at("access-type").get<uint32_t>() & MCD_TX_AT_W) {
+            std::vector<uint8_t> data{
+                decode_data(this->data_encoding, tx.at("data"))};
+            if (data.size() < num_bytes) {
+                return false;
+            }
+            std::copy(data.begin(), data.begin() + num_bytes,
+                      mem->begin() + address);
+        } else {
+            tx["data"] = encode_data(this->data_encoding,
+                                     mem->data() + address, num_bytes);
+        }
+
+        tx["num-bytes-ok"] = num_bytes;
+        return true;
+    }
+
+public:
+    Target(uint32_t num_cores)
+        : num_cores{num_cores}, cores(num_cores), ram(STANDIN_RAM_SIZE)
+    {
+    }
+
+    /* hands out the events raised since the last call */
+    std::vector<json> take_events() { return std::exchange(this->events, {}); }
+
+    /* returns the result of a command */
+    json execute(const std::string &command, json args)
+    {
+        const json ok = {{"return-status", MCD_RET_ACT_NONE}};
+        const json failed = {
+            {"return-status", MCD_RET_ACT_HANDLE_ERROR}};
+
+        if (command == "mcd-open-server") {
+            /*
+             * The config string is echoed, which accepts a data encoding and
+             * a wire format. Binary formats carry the data unencoded.
+             */
+            std::string config{args.value("config-string", "")};
+            std::istringstream tokens{config};
+            std::string token;
+            bool binary{false};
+            this->data_encoding = "array";
+            while (tokens >> token) {
+                if (token == "data=hex" || token == "data=base64") {
+                    this->data_encoding = token.substr(5);
+                } else if (token == "format=cbor" ||
+                           token == "format=msgpack") {
+                    binary = true;
+                } else if (token == "format=json") {
+                    binary = false;
+                }
+            }
+            if (binary) {
+                this->data_encoding = "binary";
+            }
+            return {
+                {"return-status", MCD_RET_ACT_NONE},
+                {"server-uid", 1},
+                {"host", "standin"},
+                {"config-string", args.value("config-string", "")},
+            };
+        } else if (command == "mcd-close-server" ||
+                   command == "mcd-close-core" || command == "mcd-exit" ||
+                   command == "mcd-set-global") {
+            return ok;
+        } else if (command == "mcd-qry-systems") {
+            json info = json::array();
+            if (args.at("num-systems").get<uint32_t>() > 0) {
+                info.push_back(this->con_info(0));
+            }
+            return {{"return-status", MCD_RET_ACT_NONE},
+                    {"num-systems", 1},
+                    {"system-con-info", info}};
+        } else if (command == "mcd-qry-devices") {
+            json info = json::array();
+            if (args.at("num-devices").get<uint32_t>() > 0) {
+                info.push_back(this->con_info(0));
+            }
+            return {{"return-status", MCD_RET_ACT_NONE},
+                    {"num-devices", 1},
+                    {"device-con-info", info}};
+        } else if (command == "mcd-qry-cores") {
+            uint32_t start{args.value("start-index", 0u)};
+            uint32_t num{args.at("num-cores").get<uint32_t>()};
+            if (num == 0) {
+                return {{"return-status", MCD_RET_ACT_NONE},
+                        {"num-cores", this->num_cores}};
+            }
+            json info = json::array();
+            for (uint32_t i{start}; i < this->num_cores && i < start + num;
+                 i++) {
+                info.push_back(this->con_info(i));
+            }
+            return {{"return-status", MCD_RET_ACT_NONE},
+                    {"num-cores", info.size()},
+                    {"core-con-info", info}};
+        } else if (command == "mcd-open-core") {
+            uint32_t core_id{
+                args.at("core-con-info").at("core-id").get<uint32_t>()};
+            if (core_id >= this->num_cores) {
+                return failed;
+            }
+            return {{"return-status", MCD_RET_ACT_NONE},
+                    {"core-uid", core_id},
+                    {"core-con-info", args.at("core-con-info")}};
+        } else if (command == "mcd-qry-mem-spaces") {
+            json all = this->mem_spaces();
+            uint32_t start{args.at("start-index").get<uint32_t>()};
+            uint32_t num{args.at("num-mem-spaces").get<uint32_t>()};
+            if (num == 0) {
+                return {{"return-status", MCD_RET_ACT_NONE},
+                        {"num-mem-spaces", all.size()}};
+            }
+            json mem_spaces = json::array();
+            for (uint32_t i{start}; i < all.size() && i < start + num; i++) {
+                mem_spaces.push_back(all[i]);
+            }
+            return {{"return-status", MCD_RET_ACT_NONE},
+                    {"num-mem-spaces", mem_spaces.size()},
+                    {"mem-spaces", mem_spaces}};
+        } else if (command == "mcd-qry-reg-groups") {
+            if (args.at("num-reg-groups").get<uint32_t>() == 0) {
+                return {{"return-status", MCD_RET_ACT_NONE},
+                        {"num-reg-groups", 1}};
+            }
+            return {{"return-status", MCD_RET_ACT_NONE},
+                    {"num-reg-groups", 1},
+                    {"reg-groups", json::array({json{
+                                       {"reg-group-id", STANDIN_REG_GROUP},
+                                       {"reg-group-name", "GPR"},
+                                       {"n-registers", STANDIN_NUM_REGS},
+                                   }})}};
+        } else if (command == "mcd-qry-reg-map") {
+            uint32_t start{args.at("start-index").get<uint32_t>()};
+            uint32_t num{args.at("num-regs").get<uint32_t>()};
+            if (num == 0) {
+                return {{"return-status", MCD_RET_ACT_NONE},
+                        {"num-regs", STANDIN_NUM_REGS}};
+            }
+            json regs = json::array();
+            for (uint32_t i{start}; i < STANDIN_NUM_REGS && i < start + num;
+                 i++) {
+                regs.push_back(this->reg_info(i));
+            }
+            return {{"return-status", MCD_RET_ACT_NONE},
+                    {"num-regs", regs.size()},
+                    {"reg-info", regs}};
+        }
+
+        Core *c{this->core(args)};
+        if (!c) {
+            return failed;
+        }
+
+        if (command == "mcd-qry-state") {
+            return {{"return-status", MCD_RET_ACT_NONE},
+                    {"state",
+                     {
+                         {"state", c->state},
+                         {"event", 0},
+                         {"hw-thread-id", 0},
+                         {"trig-id", 0},
+                         {"stop-str", ""},
+                         {"info-str", ""},
+                     }}};
+        } else if (command == "mcd-run") {
+            c->state = MCD_CORE_STATE_RUNNING;
+            this->raise("RESUME", args);
+            return ok;
+        } else if (command == "mcd-stop") {
+            c->state = MCD_CORE_STATE_DEBUG;
+            this->raise("STOP", args);
+            return ok;
+        } else if (command == "mcd-step") {
+            if (c->state == MCD_CORE_STATE_RUNNING) {
+                return failed;
+            }
+            uint64_t pc;
+            uint8_t *reg{&c->regs[STANDIN_PC_INDEX * STANDIN_REG_SIZE]};
+            memcpy(&pc, reg, sizeof(pc));
+            pc += 4 * (uint64_t)args.at("n-steps").get<uint32_t>();
+            memcpy(reg, &pc, sizeof(pc));
+            c->state = MCD_CORE_STATE_DEBUG;
+            this->raise("RESUME", args);
+            this->raise("STOP", args);
+            return ok;
+        } else if (command == "mcd-execute-txlist") {
+            json &txlist{args.at("txlist")};
+            uint32_t num_tx_ok{0};
+            for (json &tx : txlist.at("tx")) {
+                if (!this->execute_tx(*c, tx)) {
+                    break;
+                }
+                num_tx_ok++;
+            }
+            txlist["num-tx-ok"] = num_tx_ok;
+            return {{"return-status",
+                     num_tx_ok == txlist.at("num-tx").get<uint32_t>()
+                         ? MCD_RET_ACT_NONE
+                         : MCD_RET_ACT_HANDLE_ERROR},
+                    {"txlist", txlist}};
+        } else if (command == "mcd-qry-error-info") {
+            return {{"return-status", MCD_RET_ACT_HANDLE_ERROR},
+                    {"error-code", MCD_ERR_TXLIST_TX},
+                    {"error-events", MCD_ERR_EVT_NONE},
+                    {"error-str", "transaction out of range"}};
+        }
+
+        return failed;
+    }
+};
+
+/* byte stream to a client, either over the socket or through the rings */
+class Connection
+{
+    int fd;
+    ShmChannel *channel{nullptr};
+    int request_event_fd{-1};
+    int response_event_fd{-1};
+
+public:
+    Connection(int fd) : fd{fd} {}
+
+    ~Connection()
+    {
+        if (this->channel) {
+            munmap(this->channel, sizeof(ShmChannel));
+            close(this->request_event_fd);
+            close(this->response_event_fd);
+        }
+        close(this->fd);
+    }
+
+    /* accepts the shared memory of a client if it offers it */
+    bool setup()
+    {
+        char first;
+        if (recv(this->fd, &first, 1, MSG_PEEK) != 1) {
+            return false;
+        }
+        if (first != MCD_SHM_MAGIC[0]) {
+            return true;
+        }
+
+        mcd_shm_handshake_st hs;
+        int fds[3];
+        char control_buf[CMSG_SPACE(sizeof(fds))]{};
+        struct iovec iov{
+            .iov_base{&hs},
+            .iov_len{sizeof(hs)},
+        };
+        struct msghdr msg{
+            .msg_name{nullptr},
+            .msg_namelen{0},
+            .msg_iov{&iov},
+            .msg_iovlen{1},
+            .msg_control{control_buf},
+            .msg_controllen{sizeof(control_buf)},
+            .msg_flags{0},
+        };
+        if (recvmsg(this->fd, &msg, MSG_WAITALL) != (ssize_t)sizeof(hs)) {
+            return false;
+        }
+        struct cmsghdr *cmsg{CMSG_FIRSTHDR(&msg)};
+        if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS ||
+            cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+            return false;
+        }
+        memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+        uint32_t status{1};
+        void *addr{MAP_FAILED};
+        if (memcmp(hs.magic, MCD_SHM_MAGIC, sizeof(hs.magic)) == 0 &&
+            hs.size == sizeof(ShmChannel) &&
+            hs.ring_capacity == MCD_SHM_RING_CAPACITY) {
+            addr = mmap(nullptr, sizeof(ShmChannel), PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fds[0], 0);
+        }
+        close(fds[0]);
+        if (addr != MAP_FAILED) {
+            this->channel = (ShmChannel *)addr;
+            this->request_event_fd = fds[1];
+            this->response_event_fd = fds[2];
+            status = 0;
+        } else {
+            close(fds[1]);
+            close(fds[2]);
+        }
+
+        return send(this->fd, &status, sizeof(status), MSG_NOSIGNAL) ==
+                   (ssize_t)sizeof(status) &&
+               status == 0;
+    }
+
+    /* blocks until bytes are available, returns 0 if the client is gone */
+    size_t read(char *data, size_t capacity)
+    {
+        if (!this->channel) {
+            ssize_t ret{recv(this->fd, data, capacity, 0)};
+            return ret > 0 ? (size_t)ret : 0;
+        }
+
+        ShmRing &ring{this->channel->requests};
+        if (ring.wait(this->request_event_fd, this->fd, -1) <= 0) {
+            return 0;
+        }
+        return ring.read(data, (uint32_t)capacity);
+    }
+
+    bool write(const char *data, size_t len)
+    {
+        if (!this->channel) {
+            return send(this->fd, data, len, MSG_NOSIGNAL) == (ssize_t)len;
+        }
+
+        ShmRing &ring{this->channel->responses};
+        while (len > 0) {
+            uint32_t num_bytes{ring.write(data, (uint32_t)len)};
+            ring.notify(this->response_event_fd);
+            data += num_bytes;
+            len -= num_bytes;
+        }
+        return true;
+    }
+};
+
+/*
+ * JSON requests are not delimited, so the end of a JSON object is found by
+ * counting braces outside of strings. Binary frames tell their length.
+ */
+class RequestScanner
+{
+    std::string buf;
+    size_t scanned{0};
+    int depth{0};
+    bool in_string{false};
+    bool escaped{false};
+
+public:
+    void append(const char *data, size_t len) { this->buf.append(data, len); }
+
+    /* extracts the next complete request, returns false if there is none */
+    bool next(std::string &request)
+    {
+        if (this->scanned == 0 && !this->buf.empty() &&
+            qmp_frame_marker((uint8_t)this->buf[0])) {
+            if (this->buf.size() < QMP_FRAME_HEADER_SIZE) {
+                return false;
+            }
+            size_t length{QMP_FRAME_HEADER_SIZE +
+                          qmp_frame_get_u32(this->buf.data() + 1)};
+            if (this->buf.size() < length) {
+                return false;
+            }
+            request = this->buf.substr(0, length);
+            this->buf.erase(0, length);
+            return true;
+        }
+
+        for (; this->scanned < this->buf.size(); this->scanned++) {
+            char c{this->buf[this->scanned]};
+            if (this->in_string) {
+                if (this->escaped) {
+                    this->escaped = false;
+                } else if (c == '\\') {
+                    this->escaped = true;
+                } else if (c == '"') {
+                    this->in_string = false;
+                }
+            } else if (c == '"') {
+                this->in_string = true;
+            } else if (c == '{') {
+                this->depth++;
+            } else if (c == '}' && --this->depth == 0) {
+                request = this->buf.substr(0, this->scanned + 1);
+                this->buf.erase(0, this->scanned + 1);
+                this->scanned = 0;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/* a message in the format of the request, marker 0 for a JSON line */
+static std::string encode_message(uint8_t marker, const json &message,
+                                  const json &id)
+{
+    if (marker == 0) {
+        std::string line{message.dump()};
+        line.push_back('\n');
+        return line;
+    }
+
+    std::vector<uint8_t> payload{marker == QMP_FRAME_CBOR
+                                     ? json::to_cbor(message)
+                                     : json::to_msgpack(message)};
+    std::string frame(QMP_FRAME_HEADER_SIZE, '\0');
+    frame[0] = (char)(id.is_number_unsigned() ? marker | QMP_FRAME_HAS_ID
+                                              : marker);
+    qmp_frame_put_u32(frame.data() + 1, (uint32_t)payload.size());
+    qmp_frame_put_u32(frame.data() + 5,
+                      id.is_number_unsigned() ? id.get<uint32_t>() : 0);
+    frame.append(payload.begin(), payload.end());
+    return frame;
+}
+
+static void serve(Connection &connection, Target &target)
+{
+    RequestScanner scanner;
+    std::vector<char> chunk(1 << 16);
+    std::string request;
+
+    for (;;) {
+        size_t len{connection.read(chunk.data(), chunk.size())};
+        if (len == 0) {
+            return;
+        }
+        scanner.append(chunk.data(), len);
+
+        while (scanner.next(request)) {
+            /* the marker of a binary request, 0 for JSON */
+            uint8_t marker{qmp_frame_marker((uint8_t)request[0])
+                               ? (uint8_t)(request[0] & QMP_FRAME_FORMAT_MASK)
+                               : (uint8_t)0};
+            json reply;
+            json id;
+            try {
+                json j;
+                if (marker == QMP_FRAME_CBOR) {
+                    j = json::from_cbor(request.begin() + QMP_FRAME_HEADER_SIZE,
+                                        request.end());
+                } else if (marker == QMP_FRAME_MSGPACK) {
+                    j = json::from_msgpack(
+                        request.begin() + QMP_FRAME_HEADER_SIZE, request.end());
+                } else {
+                    j = json::parse(request);
+                }
+                id = j.value("id", json{});
+                reply = {{"return", target.execute(
+                                        j.at("execute").get<std::string>(),
+                                        j.value("arguments", json::object()))}};
+            } catch (const std::exception &e) {
+                /* malformed requests are rejected like QEMU does */
+                reply = {{"error", {{"class", "GenericError"},
+                                    {"desc", e.what()}}}};
+            }
+
+            /* events precede the reply, the ID is echoed like QEMU does */
+            std::string response;
+            for (const json &event : target.take_events()) {
+                response += encode_message(marker, event, json{});
+            }
+            if (!id.is_null()) {
+                reply["id"] = id;
+            }
+            response += encode_message(marker, reply, id);
+            if (!connection.write(response.data(), response.size())) {
+                return;
+            }
+        }
+    }
+}
+
+static int usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s (--port <port> | --unix <path>) [--cores <n>]\n",
+            name);
+    return 2;
+}
+
+int main(int argc, char *argv[])
+{
+    int port{-1};
+    std::string socket_path;
+    uint32_t num_cores{1};
+
+    for (int i{1}; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--port") == 0) {
+            port = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--unix") == 0) {
+            socket_path = argv[i + 1];
+        } else if (strcmp(argv[i], "--cores") == 0) {
+            num_cores = (uint32_t)atoi(argv[i + 1]);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if ((port < 0) == socket_path.empty() || num_cores == 0 || argc % 2 == 0) {
+        return usage(argv[0]);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    int listen_fd;
+    if (socket_path.empty()) {
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse{1};
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        struct sockaddr_in addr{
+            .sin_family{AF_INET},
+            .sin_port{htons((uint16_t)port)},
+            .sin_addr{htonl(INADDR_LOOPBACK)},
+            .sin_zero{},
+        };
+        if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            perror("bind");
+            return 1;
+        }
+    } else {
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(addr.sun_path)) {
+            fprintf(stderr, "socket path too long\n");
+            return 1;
+        }
+        socket_path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+        unlink(socket_path.c_str());
+        if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            perror("bind");
+            return 1;
+        }
+    }
+
+    if (listen(listen_fd, 1) != 0) {
+        perror("listen");
+        return 1;
+    }
+    printf("ready\n");
+    fflush(stdout);
+
+    Target target{num_cores};
+    for (;;) {
+        int fd{accept(listen_fd, nullptr, nullptr)};
+        if (fd < 0) {
+            continue;
+        }
+        Connection connection{fd};
+        if (connection.setup()) {
+            serve(connection, target);
+        }
+    }
+}